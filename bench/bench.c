@@ -0,0 +1,704 @@
+#include <clonk.h>
+#include <jc.h>
+#include <string_builder.h>
+
+#ifndef BENCH_SCALE
+#    define BENCH_SCALE 1
+#endif
+
+typedef enum {
+    CORPUS_TWITTER,
+    CORPUS_CANADA,
+    CORPUS_CITM,
+    CORPUS_NDJSON,
+    CORPUS_FLAT,
+    CORPUS_COUNT
+} CorpusKind;
+
+/*
+ * A corpus is a set of documents, one for the regular corpora and one per line for NDJSON.
+ */
+typedef struct {
+    const char* name;
+    size_t count;
+    size_t bytes;
+    char** texts;
+    JsonDocument_t** docs;
+} Corpus_t;
+
+static Corpus_t s_corpora[CORPUS_COUNT];
+static uint64_t s_rng = 0x9e3779b97f4a7c15ull;
+
+static uint32_t rng_next(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)(s_rng >> 32);
+}
+
+static double rng_double(double min, double max)
+{
+    return min + (max - min) * ((double)rng_next() / (double)UINT32_MAX);
+}
+
+/*
+ * Corpus generators
+ */
+
+static void gen_word(StringBuilder_t* builder)
+{
+    static const char* const words[] = { "lorem", "ipsum", "dolor", "sit", "amet", "json", "parser",
+        "quick", "brown", "fox", "\\u00e9t\\u00e9", "caf\\u00e9", "\\\"quoted\\\"", "line\\nbreak", "#hashtag", "@mention" };
+    builder_append(builder, "%s", words[rng_next() % (sizeof(words) / sizeof(words[0]))]);
+}
+
+static void gen_sentence(StringBuilder_t* builder, size_t words)
+{
+    builder_append_ch(builder, '"');
+    for (size_t i = 0; i < words; i++) {
+        if (i)
+            builder_append_ch(builder, ' ');
+        gen_word(builder);
+    }
+    builder_append_ch(builder, '"');
+}
+
+static void gen_twitter(StringBuilder_t* builder)
+{
+    size_t statuses = 2000 * BENCH_SCALE;
+    builder_append(builder, "{\"statuses\":[");
+    for (size_t i = 0; i < statuses; i++) {
+        if (i)
+            builder_append_ch(builder, ',');
+        builder_append(builder, "{\"id\":%lu,\"id_str\":\"%lu\",\"text\":", 500000000000000000ul + i, 500000000000000000ul + i);
+        gen_sentence(builder, 8 + rng_next() % 16);
+        builder_append(builder, ",\"truncated\":false,\"retweet_count\":%u,\"favorited\":%s,\"lang\":\"en\",\"user\":{"
+                                "\"id\":%u,\"name\":",
+            rng_next() % 1000, rng_next() % 2 ? "true" : "false", rng_next());
+        gen_sentence(builder, 2);
+        builder_append(builder, ",\"screen_name\":\"user_%u\",\"description\":", rng_next() % 100000);
+        gen_sentence(builder, 12);
+        builder_append(builder, ",\"followers_count\":%u,\"verified\":false,\"profile_image_url\":\"https:\\/\\/example.com\\/img\\/%u.png\"},"
+                                "\"entities\":{\"hashtags\":[\"jc\",\"json\"],\"urls\":[],\"user_mentions\":[{\"id\":%u,\"indices\":[3,15]}]},"
+                                "\"in_reply_to_status_id\":null,\"source\":\"<a href=\\\"https:\\/\\/example.com\\\">web<\\/a>\"}",
+            rng_next() % 1000000, rng_next(), rng_next());
+    }
+    builder_append(builder, "],\"search_metadata\":{\"count\":%zu,\"query\":\"jc\"}}", statuses);
+}
+
+static void gen_canada(StringBuilder_t* builder)
+{
+    size_t polygons = 40 * BENCH_SCALE;
+    builder_append(builder, "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},"
+                            "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[");
+    for (size_t p = 0; p < polygons; p++) {
+        if (p)
+            builder_append_ch(builder, ',');
+        builder_append_ch(builder, '[');
+        for (size_t i = 0; i < 2500; i++) {
+            if (i)
+                builder_append_ch(builder, ',');
+            builder_append(builder, "[%.15g,%.15g]", rng_double(-141.0, -52.0), rng_double(41.0, 83.0));
+        }
+        builder_append_ch(builder, ']');
+    }
+    builder_append(builder, "]}}]}");
+}
+
+static void gen_citm(StringBuilder_t* builder)
+{
+    size_t events = 2000 * BENCH_SCALE;
+    builder_append(builder, "{\"areaNames\":{\"205705993\":\"Arri\\u00e8re-sc\\u00e8ne central\",\"205705994\":\"1er balcon central\"},"
+                            "\"events\":{");
+    for (size_t i = 0; i < events; i++) {
+        if (i)
+            builder_append_ch(builder, ',');
+        builder_append(builder, "\"%zu\":{\"description\":null,\"id\":%zu,\"logo\":\"\\/images\\/UE0AAAAACEKo6QAAAAZDSVRN\",\"name\":",
+            138586341 + i, 138586341 + i);
+        gen_sentence(builder, 3);
+        builder_append(builder, ",\"subTopicIds\":[337184269,337184283],\"topicIds\":[324846099,107888604],"
+                                "\"performances\":[{\"id\":%u,\"prices\":[{\"amount\":%u,\"audienceSubCategoryId\":337100890,"
+                                "\"seatCategoryId\":338937295}],\"seatCategories\":[{\"areas\":[{\"areaId\":205705999,\"blockIds\":[]},"
+                                "{\"areaId\":205705998,\"blockIds\":[]}],\"seatCategoryId\":338937295}],\"start\":%lu,"
+                                "\"venueCode\":\"PLEYEL_PLEYEL\"}]}",
+            rng_next(), 1000 + rng_next() % 90000, 1372701600000ul + rng_next());
+    }
+    builder_append(builder, "},\"venueNames\":{\"PLEYEL_PLEYEL\":\"Salle Pleyel\"}}");
+}
+
+static void gen_log_line(StringBuilder_t* builder, size_t i)
+{
+    static const char* const levels[] = { "debug", "info", "warn", "error" };
+    builder_append(builder, "{\"ts\":%lu,\"level\":\"%s\",\"service\":\"api-%u\",\"latency_ms\":%.3f,\"status\":%u,\"msg\":",
+        1700000000000ul + i, levels[rng_next() % 4], rng_next() % 8, rng_double(0.1, 900.0), 200 + (rng_next() % 4) * 100);
+    gen_sentence(builder, 6);
+    builder_append(builder, ",\"tags\":[\"prod\",\"eu-west\"],\"req\":{\"method\":\"GET\",\"path\":\"\\/v1\\/items\\/%u\"}}", rng_next());
+}
+
+static void gen_flat(StringBuilder_t* builder)
+{
+    size_t keys = 1000000 * BENCH_SCALE;
+    builder_append_ch(builder, '{');
+    for (size_t i = 0; i < keys; i++)
+        builder_append(builder, "%s\"key%zu\":%zu", i ? "," : "", i, i);
+    builder_append_ch(builder, '}');
+}
+
+static bool corpus_add(Corpus_t* corpus, StringBuilder_t* builder)
+{
+    char** texts = realloc(corpus->texts, (corpus->count + 1) * sizeof(char*));
+    JsonDocument_t** docs = realloc(corpus->docs, (corpus->count + 1) * sizeof(JsonDocument_t*));
+    if (texts)
+        corpus->texts = texts;
+    if (docs)
+        corpus->docs = docs;
+    if (!texts || !docs)
+        return false;
+    JsonDocument_t* doc = jc_doc_from_string(builder->buffer);
+    if (!doc)
+        return false;
+    corpus->texts[corpus->count] = builder->buffer;
+    corpus->docs[corpus->count] = doc;
+    corpus->bytes += builder->pos;
+    corpus->count++;
+    *builder = (StringBuilder_t) { 0 };
+    return true;
+}
+
+static const Corpus_t* corpus_get(CorpusKind kind)
+{
+    static const char* const names[CORPUS_COUNT] = { "twitter", "canada", "citm", "ndjson", "flat" };
+    Corpus_t* corpus = &s_corpora[kind];
+    if (corpus->count)
+        return corpus;
+
+    corpus->name = names[kind];
+    StringBuilder_t builder = { 0 };
+    bool ok = true;
+    switch (kind) {
+    case CORPUS_TWITTER:
+        gen_twitter(&builder);
+        break;
+    case CORPUS_CANADA:
+        gen_canada(&builder);
+        break;
+    case CORPUS_CITM:
+        gen_citm(&builder);
+        break;
+    case CORPUS_FLAT:
+        gen_flat(&builder);
+        break;
+    case CORPUS_NDJSON:
+        for (size_t i = 0; ok && i < 20000 * BENCH_SCALE; i++) {
+            gen_log_line(&builder, i);
+            ok = corpus_add(corpus, &builder);
+        }
+        break;
+    case CORPUS_COUNT:
+        break;
+    }
+    if (kind != CORPUS_NDJSON)
+        ok = corpus_add(corpus, &builder);
+    if (!ok) {
+        fprintf(stderr, "Could not generate corpus '%s'\n", corpus->name);
+        exit(1);
+    }
+    return corpus;
+}
+
+static void corpus_free_all(void)
+{
+    for (size_t k = 0; k < CORPUS_COUNT; k++) {
+        Corpus_t* corpus = &s_corpora[k];
+        for (size_t i = 0; i < corpus->count; i++) {
+            free(corpus->texts[i]);
+            jc_free_doc(corpus->docs[i]);
+        }
+        free(corpus->texts);
+        free(corpus->docs);
+    }
+}
+
+/*
+ * Benchmarks
+ */
+
+static void bench_serialize(size_t spaces_per_indent, const char* prefix)
+{
+    char name[64];
+    for (CorpusKind k = 0; k < CORPUS_COUNT; k++) {
+        const Corpus_t* corpus = corpus_get(k);
+        size_t out_bytes = 0;
+        for (size_t i = 0; i < corpus->count; i++)
+            out_bytes += jc_doc_serialized_size(corpus->docs[i], spaces_per_indent);
+        snprintf(name, sizeof(name), "%s/%s", prefix, corpus->name);
+        MEASURE(name, out_bytes, {
+            for (size_t i = 0; i < corpus->count; i++)
+                free(jc_doc_to_string(corpus->docs[i], spaces_per_indent));
+        });
+    }
+}
+
+BENCHMARK_GROUP(parse, {
+    char name[64];
+    for (CorpusKind k = 0; k < CORPUS_COUNT; k++) {
+        const Corpus_t* corpus = corpus_get(k);
+        snprintf(name, sizeof(name), "parse/%s", corpus->name);
+        MEASURE(name, corpus->bytes, {
+            for (size_t i = 0; i < corpus->count; i++)
+                jc_free_doc(jc_doc_from_string(corpus->texts[i]));
+        });
+    }
+})
+
+BENCHMARK_GROUP(parse_presized, {
+    char name[64];
+    JsonParseOptions_t options = { .presize_containers = true };
+    for (CorpusKind k = 0; k < CORPUS_COUNT; k++) {
+        const Corpus_t* corpus = corpus_get(k);
+        snprintf(name, sizeof(name), "parse_presized/%s", corpus->name);
+        MEASURE(name, corpus->bytes, {
+            for (size_t i = 0; i < corpus->count; i++)
+                jc_free_doc(jc_doc_from_string_with_options(corpus->texts[i], &options, NULL));
+        });
+    }
+})
+
+BENCHMARK_GROUP(parse_raw, {
+    char name[64];
+    JsonParseOptions_t options = { .raw_numbers = true };
+    for (CorpusKind k = 0; k < CORPUS_COUNT; k++) {
+        const Corpus_t* corpus = corpus_get(k);
+        snprintf(name, sizeof(name), "parse_raw/%s", corpus->name);
+        MEASURE(name, corpus->bytes, {
+            for (size_t i = 0; i < corpus->count; i++)
+                jc_free_doc(jc_doc_from_string_with_options(corpus->texts[i], &options, NULL));
+        });
+    }
+})
+
+BENCHMARK_GROUP(parse_raw_strings, {
+    char name[64];
+    JsonParseOptions_t options = { .raw_strings = true };
+    for (CorpusKind k = 0; k < CORPUS_COUNT; k++) {
+        const Corpus_t* corpus = corpus_get(k);
+        snprintf(name, sizeof(name), "parse_raw_strings/%s", corpus->name);
+        MEASURE(name, corpus->bytes, {
+            for (size_t i = 0; i < corpus->count; i++)
+                jc_free_doc(jc_doc_from_string_with_options(corpus->texts[i], &options, NULL));
+        });
+    }
+})
+
+BENCHMARK_GROUP(serialize_compact, {
+    bench_serialize(0, "serialize_compact");
+})
+
+BENCHMARK_GROUP(serialize_indented, {
+    bench_serialize(4, "serialize_indented");
+})
+
+static char** make_keys(const char* format, size_t count)
+{
+    char** keys = calloc(count, sizeof(char*));
+    char key[32];
+    for (size_t i = 0; keys && i < count; i++) {
+        snprintf(key, sizeof(key), format, i);
+        keys[i] = strdup(key);
+    }
+    return keys;
+}
+
+static void free_keys(char** keys, size_t count)
+{
+    for (size_t i = 0; keys && i < count; i++)
+        free(keys[i]);
+    free(keys);
+}
+
+static void bench_lookup(const char* name, const char* format)
+{
+    const Corpus_t* corpus = corpus_get(CORPUS_FLAT);
+    JsonObject_t* obj = jc_doc_get_obj(corpus->docs[0]);
+    size_t count = jc_obj_size(obj);
+    char** keys = make_keys(format, count);
+    size_t next = 0;
+
+    volatile size_t found = 0;
+    MEASURE(name, 0, {
+        found += jc_obj_get(obj, keys[next]) != NULL;
+        next = (next + 7919) % count;
+    });
+    free_keys(keys, count);
+}
+
+BENCHMARK_GROUP(obj_get_hit, {
+    bench_lookup("obj_get_hit/flat", "key%zu");
+})
+
+BENCHMARK_GROUP(obj_get_miss, {
+    bench_lookup("obj_get_miss/flat", "miss%zu");
+})
+
+BENCHMARK_GROUP(obj_get_prehashed, {
+    const Corpus_t* corpus = corpus_get(CORPUS_FLAT);
+    JsonObject_t* obj = jc_doc_get_obj(corpus->docs[0]);
+    size_t count = jc_obj_size(obj);
+    char** keys = make_keys("key%zu", count);
+    JsonKey_t* handles = calloc(count, sizeof(JsonKey_t));
+    for (size_t i = 0; handles && i < count; i++)
+        handles[i] = jc_key(keys[i]);
+    size_t next = 0;
+
+    volatile size_t found = 0;
+    MEASURE("obj_get_prehashed/flat", 0, {
+        found += jc_obj_get_k(obj, handles[next]) != NULL;
+        next = (next + 7919) % count;
+    });
+    free(handles);
+    free_keys(keys, count);
+})
+
+BENCHMARK_GROUP(obj_remove_churn, {
+    size_t count = 100000 * BENCH_SCALE;
+    char** keys = make_keys("key%zu", count);
+    JsonObject_t* obj = jc_new_obj();
+    for (size_t i = 0; i < count; i++)
+        jc_obj_set(obj, keys[i], jc_new_int64_value((int64_t)i));
+
+    MEASURE("obj_remove_churn", 0, {
+        size_t victim = rng_next() % count;
+        jc_obj_remove(obj, keys[victim]);
+        jc_obj_set(obj, keys[victim], jc_new_int64_value((int64_t)victim));
+    });
+    jc_free_obj(obj);
+    free_keys(keys, count);
+})
+
+typedef struct {
+    int64_t id;
+    char* screen_name;
+    int64_t followers_count;
+} BenchUser_t;
+
+typedef struct {
+    int64_t id;
+    char* text;
+    int64_t retweet_count;
+    bool favorited;
+    BenchUser_t user;
+} BenchStatus_t;
+
+typedef struct {
+    BenchStatus_t* statuses;
+    size_t status_count;
+} BenchTimeline_t;
+
+static const JsonField_t bench_user_fields[] = {
+    JC_FIELD(BenchUser_t, id, JC_FIELD_INT64),
+    JC_FIELD(BenchUser_t, screen_name, JC_FIELD_STRING),
+    JC_FIELD(BenchUser_t, followers_count, JC_FIELD_INT64),
+};
+static const JsonSchema_t bench_user_schema = JC_SCHEMA(BenchUser_t, bench_user_fields);
+
+static const JsonField_t bench_status_fields[] = {
+    JC_FIELD(BenchStatus_t, id, JC_FIELD_INT64),
+    JC_FIELD(BenchStatus_t, text, JC_FIELD_STRING),
+    JC_FIELD(BenchStatus_t, retweet_count, JC_FIELD_INT64),
+    JC_FIELD(BenchStatus_t, favorited, JC_FIELD_BOOL),
+    JC_FIELD_OBJ(BenchStatus_t, user, &bench_user_schema),
+};
+static const JsonSchema_t bench_status_schema = JC_SCHEMA(BenchStatus_t, bench_status_fields);
+
+static const JsonField_t bench_timeline_fields[] = {
+    JC_FIELD_ARR(BenchTimeline_t, statuses, status_count, JC_FIELD_OBJECT, &bench_status_schema),
+};
+static const JsonSchema_t bench_timeline_schema = JC_SCHEMA(BenchTimeline_t, bench_timeline_fields);
+
+// Same extraction as the timeline schema, through a document
+static bool bench_extract_timeline(const char* text, BenchTimeline_t* timeline)
+{
+    JsonDocument_t* doc = jc_doc_from_string(text);
+    JsonArray_t* statuses = jc_obj_get_arr(jc_doc_get_obj(doc), "statuses");
+    if (!statuses) {
+        jc_free_doc(doc);
+        return false;
+    }
+    timeline->status_count = jc_arr_size(statuses);
+    timeline->statuses = calloc(timeline->status_count, sizeof(BenchStatus_t));
+    for (size_t i = 0; timeline->statuses && i < timeline->status_count; i++) {
+        JsonObject_t* obj = jc_arr_at(statuses, i)->object;
+        BenchStatus_t* status = &timeline->statuses[i];
+        jc_obj_get_int64(obj, "id", &status->id);
+        status->text = strdup(jc_obj_get_string(obj, "text"));
+        jc_obj_get_int64(obj, "retweet_count", &status->retweet_count);
+        status->favorited = *jc_obj_get_bool(obj, "favorited");
+        JsonObject_t* user = jc_obj_get_obj(obj, "user");
+        jc_obj_get_int64(user, "id", &status->user.id);
+        status->user.screen_name = strdup(jc_obj_get_string(user, "screen_name"));
+        jc_obj_get_int64(user, "followers_count", &status->user.followers_count);
+    }
+    jc_free_doc(doc);
+    return timeline->statuses != NULL;
+}
+
+BENCHMARK_GROUP(bind, {
+    const Corpus_t* corpus = corpus_get(CORPUS_TWITTER);
+    BenchTimeline_t timeline;
+    MEASURE("bind/dom_extract", corpus->bytes, {
+        memset(&timeline, 0, sizeof(timeline));
+        bench_extract_timeline(corpus->texts[0], &timeline);
+        jc_bind_free(&bench_timeline_schema, &timeline);
+    });
+    MEASURE("bind/schema", corpus->bytes, {
+        jc_bind_from_string(&bench_timeline_schema, corpus->texts[0], &timeline, NULL);
+        jc_bind_free(&bench_timeline_schema, &timeline);
+    });
+})
+
+static JsonKeySet_t bench_status_keys;
+static JsonKeySet_t bench_user_keys;
+static const JsonSchema_t bench_user_indexed_schema = JC_SCHEMA_INDEXED(BenchUser_t, bench_user_fields, &bench_user_keys);
+
+static const JsonField_t bench_status_indexed_fields[] = {
+    JC_FIELD(BenchStatus_t, id, JC_FIELD_INT64),
+    JC_FIELD(BenchStatus_t, text, JC_FIELD_STRING),
+    JC_FIELD(BenchStatus_t, retweet_count, JC_FIELD_INT64),
+    JC_FIELD(BenchStatus_t, favorited, JC_FIELD_BOOL),
+    JC_FIELD_OBJ(BenchStatus_t, user, &bench_user_indexed_schema),
+};
+static const JsonSchema_t bench_status_indexed_schema = JC_SCHEMA_INDEXED(BenchStatus_t, bench_status_indexed_fields, &bench_status_keys);
+
+static const JsonField_t bench_timeline_indexed_fields[] = {
+    JC_FIELD_ARR(BenchTimeline_t, statuses, status_count, JC_FIELD_OBJECT, &bench_status_indexed_schema),
+};
+static const JsonSchema_t bench_timeline_indexed_schema = JC_SCHEMA(BenchTimeline_t, bench_timeline_indexed_fields);
+
+static const char* const bench_status_names[] = { "id", "id_str", "text", "truncated", "retweet_count", "favorited",
+    "lang", "user", "entities", "in_reply_to_status_id", "source" };
+#define BENCH_STATUS_NAME_COUNT (sizeof(bench_status_names) / sizeof(bench_status_names[0]))
+
+BENCHMARK_GROUP(keyset, {
+    const Corpus_t* corpus = corpus_get(CORPUS_TWITTER);
+    JsonArray_t* statuses = jc_obj_get_arr(jc_doc_get_obj(corpus->docs[0]), "statuses");
+    size_t count = jc_arr_size(statuses);
+    JsonKeySet_t set;
+    if (!jc_keyset_init(&set, bench_status_names, BENCH_STATUS_NAME_COUNT) || !jc_bind_prepare(&bench_timeline_indexed_schema))
+        return RESULT_FAIL;
+
+    volatile size_t found = 0;
+    MEASURE("keyset/obj_get", 0, {
+        for (size_t i = 0; i < count; i++)
+            for (size_t k = 0; k < BENCH_STATUS_NAME_COUNT; k++)
+                found += jc_obj_get(jc_arr_at(statuses, i)->object, bench_status_names[k]) != NULL;
+    });
+    JsonValue_t* values[BENCH_STATUS_NAME_COUNT];
+    MEASURE("keyset/obj_get_keyset", 0, {
+        for (size_t i = 0; i < count; i++)
+            found += jc_obj_get_keyset(jc_arr_at(statuses, i)->object, &set, values);
+    });
+
+    BenchTimeline_t timeline;
+    MEASURE("keyset/bind_indexed", corpus->bytes, {
+        jc_bind_from_string(&bench_timeline_indexed_schema, corpus->texts[0], &timeline, NULL);
+        jc_bind_free(&bench_timeline_indexed_schema, &timeline);
+    });
+})
+
+static const char* const bench_project_paths[] = { "/statuses/*/user/screen_name", "/search_metadata/count" };
+
+BENCHMARK_GROUP(project, {
+    const Corpus_t* corpus = corpus_get(CORPUS_TWITTER);
+    size_t len = strlen(corpus->texts[0]);
+    MEASURE("project/twitter", corpus->bytes, {
+        jc_free_doc(jc_doc_from_buffer_project(corpus->texts[0], len, bench_project_paths, 2));
+    });
+})
+
+static bool bench_count_match(JsonValue_t* value, void* ctx)
+{
+    *(size_t*)ctx += value->ty == JC_STRING;
+    return true;
+}
+
+BENCHMARK_GROUP(query, {
+    const Corpus_t* corpus = corpus_get(CORPUS_TWITTER);
+    const JsonDocument_t* doc = corpus->docs[0];
+    volatile size_t found = 0;
+    MEASURE("query/manual", 0, {
+        JsonArray_t* statuses = jc_obj_get_arr(jc_doc_get_obj(doc), "statuses");
+        size_t count = jc_arr_size(statuses);
+        for (size_t i = 0; i < count; i++) {
+            JsonValue_t* status = jc_arr_at(statuses, i);
+            JsonObject_t* user = status->ty == JC_OBJECT ? jc_obj_get_obj(status->object, "user") : NULL;
+            found += user && jc_obj_get_string(user, "screen_name") != NULL;
+        }
+    });
+
+    JsonQuery_t* query = jc_query_compile("$.statuses[*].user.screen_name");
+    if (!query)
+        return RESULT_FAIL;
+    size_t matches = 0;
+    MEASURE("query/compiled", 0, {
+        jc_query_run(query, doc, bench_count_match, &matches);
+    });
+    found += matches;
+    jc_query_free(query);
+})
+
+static bool bench_count_span(const char* value, size_t len, void* ctx)
+{
+    (void)value;
+    *(size_t*)ctx += len;
+    return true;
+}
+
+BENCHMARK_GROUP(stream, {
+    const Corpus_t* corpus = corpus_get(CORPUS_TWITTER);
+    size_t len = strlen(corpus->texts[0]);
+    JsonQuery_t* query = jc_query_compile("$.statuses[*].user.screen_name");
+    if (!query)
+        return RESULT_FAIL;
+    volatile size_t found = 0;
+    size_t bytes = 0;
+    MEASURE("stream/twitter", corpus->bytes, {
+        found += jc_query_stream(query, corpus->texts[0], len, bench_count_span, &bytes, NULL);
+    });
+    jc_query_free(query);
+})
+
+// Copies every corpus document, either through its text or with jc_doc_clone
+static JsonDocument_t* copy_doc(const JsonDocument_t* doc, int mode)
+{
+    if (mode == 2)
+        return jc_doc_clone(doc, true);
+    if (mode == 1)
+        return jc_doc_clone(doc, false);
+    char* text = jc_doc_to_string(doc, 0);
+    JsonDocument_t* copy = jc_doc_from_string(text);
+    free(text);
+    return copy;
+}
+
+static const char* s_clone_modes[] = { "clone/reparse", "clone/tree", "clone/contiguous" };
+
+BENCHMARK_GROUP(clone, {
+    char name[64];
+    for (CorpusKind k = 0; k < CORPUS_COUNT; k++) {
+        const Corpus_t* corpus = corpus_get(k);
+        for (int mode = 0; mode < 3; mode++) {
+            snprintf(name, sizeof(name), "%s/%s", s_clone_modes[mode], corpus->name);
+            MEASURE(name, corpus->bytes, {
+                for (size_t i = 0; i < corpus->count; i++)
+                    jc_free_doc(copy_doc(corpus->docs[i], mode));
+            });
+        }
+    }
+})
+
+// Per request document derived from a template: either a private clone or the shared template with the
+// modified root copied on write
+static void derive_doc(const JsonDocument_t* doc, void* shared)
+{
+    JsonDocument_t* derived;
+    if (!shared) {
+        derived = jc_doc_clone(doc, false);
+    } else {
+        derived = jc_new_doc();
+        if (jc_doc_is_obj(doc))
+            jc_doc_set_obj(derived, jc_obj_retain((JsonObject_t*)shared));
+        else
+            jc_doc_set_arr(derived, jc_arr_retain((JsonArray_t*)shared));
+    }
+    if (jc_doc_is_obj(derived))
+        jc_obj_insert(jc_doc_get_obj_mut(derived), "request", JC_INT64, &(int64_t) { 1 });
+    else
+        jc_arr_insert(jc_doc_get_arr_mut(derived), JC_INT64, &(int64_t) { 1 });
+    jc_free_doc(derived);
+}
+
+static void* share_doc(const JsonDocument_t* doc)
+{
+    if (jc_doc_is_obj(doc))
+        return jc_obj_share(jc_doc_get_obj(doc));
+    return jc_arr_share(jc_doc_get_arr(doc));
+}
+
+static void free_shared(const JsonDocument_t* doc, void* shared)
+{
+    if (jc_doc_is_obj(doc))
+        jc_free_obj((JsonObject_t*)shared);
+    else
+        jc_free_arr((JsonArray_t*)shared);
+}
+
+BENCHMARK_GROUP(derive, {
+    char name[64];
+    for (CorpusKind k = 0; k < CORPUS_COUNT; k++) {
+        const Corpus_t* corpus = corpus_get(k);
+        void** shared = calloc(corpus->count, sizeof(void*));
+        if (!shared)
+            return RESULT_FAIL;
+        for (size_t i = 0; i < corpus->count; i++)
+            shared[i] = share_doc(corpus->docs[i]);
+        snprintf(name, sizeof(name), "derive/clone/%s", corpus->name);
+        MEASURE(name, corpus->bytes, {
+            for (size_t i = 0; i < corpus->count; i++)
+                derive_doc(corpus->docs[i], NULL);
+        });
+        snprintf(name, sizeof(name), "derive/shared/%s", corpus->name);
+        MEASURE(name, corpus->bytes, {
+            for (size_t i = 0; i < corpus->count; i++)
+                derive_doc(corpus->docs[i], shared[i]);
+        });
+        for (size_t i = 0; i < corpus->count; i++)
+            free_shared(corpus->docs[i], shared[i]);
+        free(shared);
+    }
+})
+
+BENCHMARK_GROUP(free_doc, {
+    char name[64];
+    for (CorpusKind k = 0; k < CORPUS_COUNT; k++) {
+        const Corpus_t* corpus = corpus_get(k);
+        JsonDocument_t** docs = calloc(corpus->count, sizeof(JsonDocument_t*));
+        if (!docs)
+            return RESULT_FAIL;
+        snprintf(name, sizeof(name), "free_doc/%s", corpus->name);
+        MEASURE_WITH_SETUP(name, corpus->bytes, {
+            for (size_t i = 0; i < corpus->count; i++)
+                docs[i] = jc_doc_from_string(corpus->texts[i]);
+        }, {
+            for (size_t i = 0; i < corpus->count; i++)
+                jc_free_doc(docs[i]);
+        });
+        free(docs);
+    }
+})
+
+int main(int argc, char** argv)
+{
+    REGISTER_BENCHMARK(parse);
+    REGISTER_BENCHMARK(parse_presized);
+    REGISTER_BENCHMARK(parse_raw);
+    REGISTER_BENCHMARK(parse_raw_strings);
+    REGISTER_BENCHMARK(serialize_compact);
+    REGISTER_BENCHMARK(serialize_indented);
+    REGISTER_BENCHMARK(obj_get_hit);
+    REGISTER_BENCHMARK(obj_get_miss);
+    REGISTER_BENCHMARK(obj_get_prehashed);
+    REGISTER_BENCHMARK(obj_remove_churn);
+    REGISTER_BENCHMARK(bind);
+    REGISTER_BENCHMARK(keyset);
+    REGISTER_BENCHMARK(project);
+    REGISTER_BENCHMARK(query);
+    REGISTER_BENCHMARK(stream);
+    REGISTER_BENCHMARK(clone);
+    REGISTER_BENCHMARK(derive);
+    REGISTER_BENCHMARK(free_doc);
+    int result = clonk_run_test_suite(argc, argv);
+
+    corpus_free_all();
+    return result;
+}
@@ -0,0 +1,5 @@
+#!/bin/bash
+set -euo pipefail
+
+gcc bench.c ../src/jc.c ../src/jc_tape.c ../src/jc_alloc.c ../src/jc_stats.c ../src/jc_bind.c ../src/jc_query.c ../src/cbor.c ../src/msgpack.c ../src/string_builder.c ../src/olh_map.c -I. -I../test -I../src -Wextra -Wall -Werror -Wconversion -ggdb -O2 -o benchsuite
+./benchsuite -b -o ../bench_output.txt "$@"
@@ -1,4 +1,4 @@
 #!/bin/bash
 set -euo pipefail
 
-gcc main.c ../src/jc.c ../src/string_builder.c ../src/olh_map.c -I. -I../src -Wextra -Wall -Werror -Wconversion -ggdb -O2 -o jpp
+gcc main.c ../src/jc.c ../src/jc_tape.c ../src/jc_alloc.c ../src/jc_stats.c ../src/jc_bind.c ../src/jc_query.c ../src/cbor.c ../src/msgpack.c ../src/string_builder.c ../src/olh_map.c -I. -I../src -Wextra -Wall -Werror -Wconversion -ggdb -O2 -o jpp
@@ -33,9 +33,12 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    JsonDocument_t* doc = jc_doc_from_string(builder.buffer);
+    // Numbers are printed exactly as they were written
+    JsonParseOptions_t options = { .raw_numbers = true, .raw_strings = true };
+    JsonParseError_t error;
+    JsonDocument_t* doc = jc_doc_from_string_with_options(builder.buffer, &options, &error);
     if (!doc) {
-        printf("Error parsing document\n");
+        printf("Error parsing document: %s at offset %zu\n", jc_parse_error_string(error.code), error.offset);
         return 1;
     }
 
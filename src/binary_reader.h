@@ -0,0 +1,63 @@
+#ifndef JC_BINARY_READER__
+#define JC_BINARY_READER__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string_builder.h>
+
+// Nesting the CBOR and MessagePack decoders accept, each level recurses once
+#ifndef JC_BINARY_MAX_DEPTH
+#    define JC_BINARY_MAX_DEPTH 256
+#endif
+
+// Input cursor shared by the binary decoders, scratch holds the last NUL terminated string
+typedef struct {
+    const uint8_t* data;
+    size_t pos;
+    size_t len;
+    size_t depth;
+    StringBuilder_t scratch;
+} BinaryReader_t;
+
+// Strings are used in place, embedded NULs are rejected as they can't be represented
+static inline const char* reader_read_text(BinaryReader_t* reader, uint64_t len, size_t* offset)
+{
+    if (len > reader->len - reader->pos)
+        return NULL;
+    const char* text = (const char*)&reader->data[reader->pos];
+    if (memchr(text, '\0', (size_t)len))
+        return NULL;
+    *offset = reader->pos;
+    reader->pos += (size_t)len;
+    return text;
+}
+
+static inline const char* reader_terminate(BinaryReader_t* reader, const char* text, size_t len)
+{
+    builder_reset(&reader->scratch);
+    if (!builder_append_str(&reader->scratch, text, len) || !builder_append_ch(&reader->scratch, '\0'))
+        return NULL;
+    return reader->scratch.buffer;
+}
+
+// Every member takes at least one byte, so counts larger than the remaining input are bogus
+static inline size_t reader_presize_count(const BinaryReader_t* reader, uint64_t count)
+{
+    size_t remaining = reader->len - reader->pos;
+    return count < remaining ? (size_t)count : remaining;
+}
+
+// Call before decoding the members of a container, reader_leave after
+static inline bool reader_enter(BinaryReader_t* reader)
+{
+    return ++reader->depth <= JC_BINARY_MAX_DEPTH;
+}
+
+static inline void reader_leave(BinaryReader_t* reader)
+{
+    reader->depth--;
+}
+
+#endif
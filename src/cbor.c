@@ -0,0 +1,392 @@
+#include <assert.h>
+#include <binary_reader.h>
+#include <jc_alloc.h>
+#include <cbor.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * RFC 8949 subset: integers, text strings, arrays, maps with text keys, simple values and
+ * floats. Tags are skipped, byte strings and indefinite lengths are rejected.
+ */
+typedef enum {
+    CBOR_UINT = 0,
+    CBOR_NEGINT = 1,
+    CBOR_BYTES = 2,
+    CBOR_TEXT = 3,
+    CBOR_ARRAY = 4,
+    CBOR_MAP = 5,
+    CBOR_TAG = 6,
+    CBOR_SIMPLE = 7,
+} CborMajorType;
+
+typedef BinaryReader_t CborReader_t;
+
+static bool cbor_write_head(StringBuilder_t* builder, CborMajorType major, uint64_t arg)
+{
+    char head[9];
+    size_t bytes = 0;
+    uint8_t info = (uint8_t)arg;
+    if (arg > UINT32_MAX) {
+        info = 27, bytes = 8;
+    } else if (arg > UINT16_MAX) {
+        info = 26, bytes = 4;
+    } else if (arg > UINT8_MAX) {
+        info = 25, bytes = 2;
+    } else if (arg >= 24) {
+        info = 24, bytes = 1;
+    }
+    head[0] = (char)(((uint8_t)major << 5) | info);
+    for (size_t i = 0; i < bytes; i++)
+        head[1 + i] = (char)(arg >> (8 * (bytes - 1 - i)));
+    return builder_append_str(builder, head, 1 + bytes);
+}
+
+bool cbor_write_int64(StringBuilder_t* builder, int64_t i64)
+{
+    if (i64 >= 0)
+        return cbor_write_head(builder, CBOR_UINT, (uint64_t)i64);
+    return cbor_write_head(builder, CBOR_NEGINT, (uint64_t)(-1 - i64));
+}
+
+bool cbor_write_double(StringBuilder_t* builder, double dbl)
+{
+    char buf[9];
+    float flt = (float)dbl;
+    if ((double)flt == dbl) {
+        uint32_t bits;
+        memcpy(&bits, &flt, sizeof(bits));
+        buf[0] = (char)0xfa;
+        for (size_t i = 0; i < 4; i++)
+            buf[1 + i] = (char)(bits >> (8 * (3 - i)));
+        return builder_append_str(builder, buf, 5);
+    }
+    uint64_t bits;
+    memcpy(&bits, &dbl, sizeof(bits));
+    buf[0] = (char)0xfb;
+    for (size_t i = 0; i < 8; i++)
+        buf[1 + i] = (char)(bits >> (8 * (7 - i)));
+    return builder_append_str(builder, buf, 9);
+}
+
+bool cbor_write_string(StringBuilder_t* builder, const char* str, size_t len)
+{
+    return cbor_write_head(builder, CBOR_TEXT, len) && builder_append_str(builder, str, len);
+}
+
+bool cbor_write_bool(StringBuilder_t* builder, bool b)
+{
+    return builder_append_ch(builder, (char)(b ? 0xf5 : 0xf4));
+}
+
+bool cbor_write_null(StringBuilder_t* builder)
+{
+    return builder_append_ch(builder, (char)0xf6);
+}
+
+bool cbor_write_array_head(StringBuilder_t* builder, size_t count)
+{
+    return cbor_write_head(builder, CBOR_ARRAY, count);
+}
+
+bool cbor_write_map_head(StringBuilder_t* builder, size_t count)
+{
+    return cbor_write_head(builder, CBOR_MAP, count);
+}
+
+static bool cbor_write_obj(StringBuilder_t* builder, const JsonObject_t* obj)
+{
+    if (!cbor_write_map_head(builder, jc_obj_size(obj)))
+        return false;
+    jc_obj_foreach(obj, key, value)
+    {
+        if (!cbor_write_string(builder, key, strlen(key)) || !cbor_write_value(builder, value))
+            return false;
+    }
+    return true;
+}
+
+static bool cbor_write_arr(StringBuilder_t* builder, const JsonArray_t* arr)
+{
+    if (!cbor_write_array_head(builder, jc_arr_size(arr)))
+        return false;
+    jc_arr_foreach(arr, value)
+    {
+        if (!cbor_write_value(builder, value))
+            return false;
+    }
+    return true;
+}
+
+bool cbor_write_value(StringBuilder_t* builder, const JsonValue_t* value)
+{
+    assert(builder && value);
+    switch (value->ty) {
+    case JC_STRING:
+        return cbor_write_string(builder, value->string, strlen(value->string));
+    case JC_DOUBLE:
+        return cbor_write_double(builder, value->num_double);
+    case JC_INT64:
+        return cbor_write_int64(builder, value->num_int64);
+    case JC_OBJECT:
+        return cbor_write_obj(builder, value->object);
+    case JC_ARRAY:
+        return cbor_write_arr(builder, value->array);
+    case JC_BOOLEAN:
+        return cbor_write_bool(builder, value->boolean);
+    case JC_NULL_LITERAL:
+        return cbor_write_null(builder);
+    case JC_NUMBER_RAW: {
+        int64_t i64;
+        double dbl;
+        if (jc_value_number_type(value) == JC_INT64 && jc_value_get_int64(value, &i64))
+            return cbor_write_int64(builder, i64);
+        return jc_value_get_double(value, &dbl) && cbor_write_double(builder, dbl);
+    }
+    case JC_STRING_RAW: {
+        const char* str = jc_value_get_string(value);
+        return str && cbor_write_string(builder, str, strlen(str));
+    }
+    }
+    return false;
+}
+
+uint8_t* jc_doc_to_cbor(const JsonDocument_t* doc, size_t* len)
+{
+    if (!doc || !len || jc_doc_is_obj(doc) == jc_doc_is_arr(doc))
+        return NULL;
+    StringBuilder_t builder = { 0 };
+    if (!builder_resize(&builder, 64))
+        return NULL;
+    bool written = jc_doc_is_obj(doc) ? cbor_write_obj(&builder, jc_doc_get_obj(doc))
+                                      : cbor_write_arr(&builder, jc_doc_get_arr(doc));
+    if (!written) {
+        free(builder.buffer);
+        return NULL;
+    }
+    *len = builder.pos;
+    return (uint8_t*)builder.buffer;
+}
+
+/*
+ * Decoding
+ */
+
+static bool cbor_read_head(CborReader_t* reader, CborMajorType* major, uint8_t* info, uint64_t* arg)
+{
+    if (reader->pos >= reader->len)
+        return false;
+    uint8_t initial = reader->data[reader->pos++];
+    *major = (CborMajorType)(initial >> 5);
+    *info = initial & 0x1f;
+    if (*info < 24) {
+        *arg = *info;
+        return true;
+    }
+    if (*info > 27)
+        return false;
+    size_t bytes = (size_t)1 << (*info - 24);
+    if (reader->len - reader->pos < bytes)
+        return false;
+    *arg = 0;
+    for (size_t i = 0; i < bytes; i++)
+        *arg = (*arg << 8) | reader->data[reader->pos++];
+    return true;
+}
+
+static double cbor_half_to_double(uint16_t half)
+{
+    unsigned exp = (half >> 10) & 0x1f;
+    unsigned mant = half & 0x3ff;
+    double value;
+    if (exp == 0)
+        value = mant / 16777216.0;
+    else if (exp == 31)
+        value = mant == 0 ? INFINITY : NAN;
+    else if (exp >= 25)
+        value = (mant + 1024) * (double)(1u << (exp - 25));
+    else
+        value = (mant + 1024) / (double)(1u << (25 - exp));
+    return (half & 0x8000) ? -value : value;
+}
+
+static JsonValue_t* cbor_read_value(CborReader_t* reader);
+
+static JsonArray_t* cbor_read_arr(CborReader_t* reader, uint64_t count)
+{
+    JsonArray_t* arr = jc_new_arr_with_capacity(reader_presize_count(reader, count));
+    if (!arr)
+        return NULL;
+    for (uint64_t i = 0; i < count; i++) {
+        JsonValue_t* value = cbor_read_value(reader);
+        if (!value || !jc_arr_insert_value(arr, value)) {
+            jc_free_value(value);
+            jc_free_arr(arr);
+            return NULL;
+        }
+    }
+    return arr;
+}
+
+static JsonObject_t* cbor_read_obj(CborReader_t* reader, uint64_t count)
+{
+    JsonObject_t* obj = jc_new_obj_with_capacity(reader_presize_count(reader, count));
+    if (!obj)
+        return NULL;
+    for (uint64_t i = 0; i < count; i++) {
+        CborMajorType major;
+        uint8_t info;
+        uint64_t key_len;
+        size_t key_offset;
+        if (!cbor_read_head(reader, &major, &info, &key_len) || major != CBOR_TEXT
+            || !reader_read_text(reader, key_len, &key_offset))
+            goto EXIT_ERROR;
+
+        // The key stays in the input until the value is decoded, which may reuse the scratch buffer
+        JsonValue_t* value = cbor_read_value(reader);
+        if (!value)
+            goto EXIT_ERROR;
+        const char* key = reader_terminate(reader, (const char*)&reader->data[key_offset], (size_t)key_len);
+        if (!key || !jc_obj_set(obj, key, value)) {
+            jc_free_value(value);
+            goto EXIT_ERROR;
+        }
+    }
+    return obj;
+
+EXIT_ERROR:
+    jc_free_obj(obj);
+    return NULL;
+}
+
+static JsonValue_t* cbor_read_simple(uint8_t info, uint64_t arg)
+{
+    switch (info) {
+    case 20:
+        return jc_new_bool_value(false);
+    case 21:
+        return jc_new_bool_value(true);
+    case 22:
+    case 23:
+        return jc_new_value(JC_NULL_LITERAL, NULL);
+    case 25:
+        return jc_new_double_value(cbor_half_to_double((uint16_t)arg));
+    case 26: {
+        float flt;
+        uint32_t bits = (uint32_t)arg;
+        memcpy(&flt, &bits, sizeof(flt));
+        return jc_new_double_value(flt);
+    }
+    case 27: {
+        double dbl;
+        memcpy(&dbl, &arg, sizeof(dbl));
+        return jc_new_double_value(dbl);
+    }
+    }
+    return NULL;
+}
+
+static JsonValue_t* cbor_read_value(CborReader_t* reader)
+{
+    CborMajorType major;
+    uint8_t info;
+    uint64_t arg;
+    do {
+        if (!cbor_read_head(reader, &major, &info, &arg))
+            return NULL;
+    } while (major == CBOR_TAG);
+
+    switch (major) {
+    case CBOR_UINT:
+        if (arg > INT64_MAX)
+            return jc_new_double_value((double)arg);
+        return jc_new_int64_value((int64_t)arg);
+    case CBOR_NEGINT:
+        if (arg > INT64_MAX)
+            return jc_new_double_value(-1.0 - (double)arg);
+        return jc_new_int64_value(-1 - (int64_t)arg);
+    case CBOR_TEXT: {
+        size_t offset;
+        const char* text = reader_read_text(reader, arg, &offset);
+        if (!text)
+            return NULL;
+        const char* str = reader_terminate(reader, text, (size_t)arg);
+        return str ? jc_new_value(JC_STRING, (void*)str) : NULL;
+    }
+    case CBOR_ARRAY: {
+        if (!reader_enter(reader))
+            return NULL;
+        JsonArray_t* arr = cbor_read_arr(reader, arg);
+        reader_leave(reader);
+        JsonValue_t* value = arr ? jc_new_value(JC_ARRAY, arr) : NULL;
+        if (arr && !value)
+            jc_free_arr(arr);
+        return value;
+    }
+    case CBOR_MAP: {
+        if (!reader_enter(reader))
+            return NULL;
+        JsonObject_t* obj = cbor_read_obj(reader, arg);
+        reader_leave(reader);
+        JsonValue_t* value = obj ? jc_new_value(JC_OBJECT, obj) : NULL;
+        if (obj && !value)
+            jc_free_obj(obj);
+        return value;
+    }
+    case CBOR_SIMPLE:
+        return cbor_read_simple(info, arg);
+    case CBOR_BYTES:
+    case CBOR_TAG:
+        break;
+    }
+    return NULL;
+}
+
+JsonDocument_t* jc_doc_from_cbor(const uint8_t* data, size_t len)
+{
+    if (!data)
+        return NULL;
+    CborReader_t reader = { .data = data, .pos = 0, .len = len, .scratch = { .scoped = true } };
+    JsonDocument_t* doc = jc_new_doc();
+    if (!doc)
+        return NULL;
+    // The scratch buffer is allocated in the document's scope like the nodes
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(jc_alloc_scope_of(doc));
+    if (!builder_resize(&reader.scratch, 64))
+        goto EXIT_ERROR;
+
+    CborMajorType major;
+    uint8_t info;
+    uint64_t arg;
+    do {
+        if (!cbor_read_head(&reader, &major, &info, &arg))
+            goto EXIT_ERROR;
+    } while (major == CBOR_TAG);
+
+    if (major == CBOR_MAP) {
+        JsonObject_t* obj = cbor_read_obj(&reader, arg);
+        if (!obj)
+            goto EXIT_ERROR;
+        jc_doc_set_obj(doc, obj);
+    } else if (major == CBOR_ARRAY) {
+        JsonArray_t* arr = cbor_read_arr(&reader, arg);
+        if (!arr)
+            goto EXIT_ERROR;
+        jc_doc_set_arr(doc, arr);
+    } else {
+        goto EXIT_ERROR;
+    }
+    // Check if all input was consumed
+    if (reader.pos != reader.len)
+        goto EXIT_ERROR;
+    builder_free(&reader.scratch);
+    jc_alloc_scope_enter(previous_scope);
+    return doc;
+
+EXIT_ERROR:
+    builder_free(&reader.scratch);
+    jc_alloc_scope_enter(previous_scope);
+    jc_free_doc(doc);
+    return NULL;
+}
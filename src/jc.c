@@ -1,6 +1,10 @@
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <jc.h>
+#include <jc_alloc.h>
+#include <jc_parser.h>
+#include <jc_stats.h>
 #include <olh_map.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -16,14 +20,23 @@
 #    define JC_INIT_OBJ_CAPACITY 16
 #endif
 
+// Spare buckets compacted objects keep, in percent of their size
+#ifndef JC_COMPACT_OBJ_SLACK_PERCENT
+#    define JC_COMPACT_OBJ_SLACK_PERCENT 25
+#endif
+
 struct JsonArray_t {
     size_t size;
     size_t capacity;
     JsonValue_t** data;
+    // Owners of a shared array, see jc_arr_share
+    size_t refs;
 };
 
 struct JsonObject_t {
     OrderedLinkedHashMap_t olh_map;
+    // Owners of a shared object, see jc_obj_share
+    size_t refs;
 };
 
 struct JsonDocument_t {
@@ -31,11 +44,27 @@ struct JsonDocument_t {
     JsonArray_t* array;
 };
 
-typedef struct {
-    const char* text;
-    size_t pos;
+// Source text of a number with the result of its conversion, allocated as one block
+typedef struct JsonRawNumber_t {
+    union {
+        double num_double;
+        int64_t num_int64;
+    };
+    size_t len;
+    // Fraction or exponent present, integers outside of int64 are held as double as well
+    bool is_double;
+    bool out_of_range;
+    bool converted;
+    char text[];
+} JsonRawNumber_t;
+
+// Quoted source text of a string with escape sequences, decoded is allocated on the first read
+typedef struct JsonRawString_t {
+    char* decoded;
+    size_t decoded_len;
     size_t len;
-} JsonParser_t;
+    char text[];
+} JsonRawString_t;
 
 static void builder_serialize_obj(StringBuilder_t*, const JsonObject_t*, size_t, size_t);
 static void builder_serialize_arr(StringBuilder_t*, const JsonArray_t*, size_t, size_t);
@@ -44,50 +73,348 @@ static JsonArray_t* parse_arr(JsonParser_t*);
 
 JsonDocument_t* jc_new_doc()
 {
-    return (JsonDocument_t*)calloc(1, sizeof(JsonDocument_t));
+    return jc_new_doc_with_allocator(NULL);
 }
 
-JsonObject_t* jc_new_obj()
+JsonDocument_t* jc_new_doc_with_allocator(const JsonAllocator_t* allocator)
+{
+    JsonAllocScope_t* scope = jc_alloc_scope_new(allocator);
+    if (!scope)
+        return NULL;
+    JsonDocument_t* doc = (JsonDocument_t*)jc_mem_calloc_in(scope, sizeof(JsonDocument_t));
+    if (!doc)
+        jc_alloc_scope_release(scope);
+    return doc;
+}
+
+void jc_use_doc_allocator(const JsonDocument_t* doc)
+{
+    jc_alloc_scope_enter(doc ? jc_alloc_scope_of(doc) : NULL);
+}
+
+bool jc_doc_alloc_stats(const JsonDocument_t* doc, JsonAllocStats_t* stats)
+{
+    if (!doc || !stats)
+        return false;
+    const JsonAllocStats_t* scope_stats = jc_alloc_scope_stats(jc_alloc_scope_of(doc));
+    if (!scope_stats)
+        return false;
+    *stats = *scope_stats;
+    return true;
+}
+
+/*
+ *   Memory usage
+ */
+
+static inline void usage_add_alloc(JsonMemoryUsage_t* usage, size_t size)
+{
+    usage->allocations++;
+    usage->allocator_overhead += jc_mem_overhead(size);
+}
+
+static void usage_add_obj(JsonMemoryUsage_t* usage, const JsonObject_t* obj);
+static void usage_add_arr(JsonMemoryUsage_t* usage, const JsonArray_t* arr);
+
+static void usage_add_value(JsonMemoryUsage_t* usage, const JsonValue_t* value)
+{
+    usage->value_bytes += sizeof(JsonValue_t);
+    usage_add_alloc(usage, sizeof(JsonValue_t));
+    if (value->ty == JC_STRING && value->string) {
+        size_t len = value->string_len != JC_STRING_LEN_UNKNOWN ? value->string_len : strlen(value->string);
+        usage->string_bytes += len + 1;
+        usage_add_alloc(usage, len + 1);
+    } else if (value->ty == JC_NUMBER_RAW && value->raw_number) {
+        size_t size = sizeof(JsonRawNumber_t) + value->raw_number->len + 1;
+        usage->string_bytes += size;
+        usage_add_alloc(usage, size);
+    } else if (value->ty == JC_STRING_RAW && value->raw_string) {
+        size_t size = sizeof(JsonRawString_t) + value->raw_string->len + 1;
+        usage->string_bytes += size;
+        usage_add_alloc(usage, size);
+        if (value->raw_string->decoded) {
+            usage->string_bytes += value->raw_string->len;
+            usage_add_alloc(usage, value->raw_string->len);
+        }
+    } else if (value->ty == JC_OBJECT && value->object) {
+        usage_add_obj(usage, value->object);
+    } else if (value->ty == JC_ARRAY && value->array) {
+        usage_add_arr(usage, value->array);
+    }
+}
+
+static void usage_add_obj(JsonMemoryUsage_t* usage, const JsonObject_t* obj)
+{
+    const OrderedLinkedHashMap_t* map = &obj->olh_map;
+    usage->container_bytes += sizeof(JsonObject_t);
+    usage_add_alloc(usage, sizeof(JsonObject_t));
+    if (map->buckets) {
+        size_t empty = map->capacity - map->size - map->deleted_count;
+        usage->bucket_bytes += map->size * sizeof(BucketEntry_t);
+        usage->bucket_empty_bytes += empty * sizeof(BucketEntry_t);
+        usage->bucket_tombstone_bytes += map->deleted_count * sizeof(BucketEntry_t);
+        usage_add_alloc(usage, map->capacity * sizeof(BucketEntry_t));
+    }
+    for (const BucketEntry_t* bucket = map->head; bucket; bucket = bucket->next) {
+        size_t key_len = olh_map_key_len(bucket);
+        usage->key_bytes += key_len + 1;
+        usage_add_alloc(usage, key_len + 1);
+        usage_add_value(usage, bucket->value);
+    }
+}
+
+static void usage_add_arr(JsonMemoryUsage_t* usage, const JsonArray_t* arr)
+{
+    usage->container_bytes += sizeof(JsonArray_t);
+    usage_add_alloc(usage, sizeof(JsonArray_t));
+    usage->array_bytes += arr->size * sizeof(JsonValue_t*);
+    usage->array_slack_bytes += (arr->capacity - arr->size) * sizeof(JsonValue_t*);
+    usage_add_alloc(usage, arr->capacity * sizeof(JsonValue_t*));
+    for (size_t i = 0; i < arr->size; i++)
+        usage_add_value(usage, arr->data[i]);
+}
+
+static void usage_finish(JsonMemoryUsage_t* usage)
+{
+    usage->total_bytes = usage->value_bytes + usage->container_bytes + usage->bucket_bytes + usage->bucket_empty_bytes
+        + usage->bucket_tombstone_bytes + usage->array_bytes + usage->array_slack_bytes + usage->key_bytes
+        + usage->string_bytes + usage->allocator_overhead;
+}
+
+bool jc_doc_memory_usage(const JsonDocument_t* doc, JsonMemoryUsage_t* usage)
+{
+    if (!doc || !usage)
+        return false;
+    *usage = (JsonMemoryUsage_t) { .container_bytes = sizeof(JsonDocument_t) };
+    usage_add_alloc(usage, sizeof(JsonDocument_t));
+    if (doc->object)
+        usage_add_obj(usage, doc->object);
+    if (doc->array)
+        usage_add_arr(usage, doc->array);
+    usage_finish(usage);
+    return true;
+}
+
+bool jc_obj_memory_usage(const JsonObject_t* obj, JsonMemoryUsage_t* usage)
+{
+    if (!obj || !usage)
+        return false;
+    *usage = (JsonMemoryUsage_t) { 0 };
+    usage_add_obj(usage, obj);
+    usage_finish(usage);
+    return true;
+}
+
+bool jc_arr_memory_usage(const JsonArray_t* arr, JsonMemoryUsage_t* usage)
+{
+    if (!arr || !usage)
+        return false;
+    *usage = (JsonMemoryUsage_t) { 0 };
+    usage_add_arr(usage, arr);
+    usage_finish(usage);
+    return true;
+}
+
+// Smallest bucket table which takes count keys without growing, plus some room to keep probing short
+static inline size_t obj_capacity_for(size_t count)
+{
+    size_t capacity = count + count * JC_COMPACT_OBJ_SLACK_PERCENT / 100 + 2;
+    return capacity < 4 ? 4 : capacity;
+}
+
+// Arrays grow before they are full
+static inline size_t arr_capacity_for(size_t count)
+{
+    return count + 1;
+}
+
+// Shared nodes live in shared scopes and are never modified
+static inline bool node_is_shared(const void* node)
+{
+    return jc_alloc_scope_is_shared(jc_alloc_scope_of(node));
+}
+
+// Private containers have a single owner, shared ones are freed by the last
+static inline bool node_release(const void* node, size_t* refs)
+{
+    return !node_is_shared(node) || __atomic_sub_fetch(refs, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+static JsonObject_t* new_obj_with_capacity(size_t capacity)
 {
-    JsonObject_t* obj = (JsonObject_t*)calloc(1, sizeof(JsonObject_t));
+    JsonObject_t* obj = (JsonObject_t*)jc_mem_calloc(sizeof(JsonObject_t));
     if (!obj)
         return NULL;
+    JC_STATS_ADD(objects_created, 1);
+    obj->refs = 1;
     obj->olh_map.value_free_func = (olh_map_value_free)jc_free_value;
-    if (!olh_map_rehash(&obj->olh_map, JC_INIT_OBJ_CAPACITY)) {
-        free(obj);
+    obj->olh_map.alloc_scope = jc_alloc_scope_of(obj);
+    if (!olh_map_rehash(&obj->olh_map, capacity)) {
+        jc_mem_free(obj);
         return NULL;
     }
     return obj;
 }
 
-JsonArray_t* jc_new_arr()
+static JsonArray_t* new_arr_with_capacity(size_t capacity)
 {
-    JsonArray_t* arr = (JsonArray_t*)calloc(1, sizeof(JsonArray_t));
+    // Inserting grows the capacity by doubling, so it must never be 0
+    capacity = capacity ? capacity : 1;
+    JsonArray_t* arr = (JsonArray_t*)jc_mem_calloc(sizeof(JsonArray_t));
     if (!arr)
         return NULL;
-    arr->data = (JsonValue_t**)calloc(1, JC_INIT_ARR_CAPACITY * sizeof(JsonValue_t*));
+    JC_STATS_ADD(arrays_created, 1);
+    arr->data = (JsonValue_t**)jc_mem_calloc_in(jc_alloc_scope_of(arr), capacity * sizeof(JsonValue_t*));
     if (!arr->data) {
-        free(arr);
+        jc_mem_free(arr);
         return NULL;
     }
-    arr->capacity = JC_INIT_ARR_CAPACITY;
+    arr->capacity = capacity;
+    arr->refs = 1;
     return arr;
 }
 
+JsonObject_t* jc_new_obj()
+{
+    return new_obj_with_capacity(JC_INIT_OBJ_CAPACITY);
+}
+
+JsonArray_t* jc_new_arr()
+{
+    return new_arr_with_capacity(JC_INIT_ARR_CAPACITY);
+}
+
+JsonObject_t* jc_new_obj_with_capacity(size_t count)
+{
+    return new_obj_with_capacity(obj_capacity_for(count));
+}
+
+JsonArray_t* jc_new_arr_with_capacity(size_t count)
+{
+    return new_arr_with_capacity(arr_capacity_for(count));
+}
+
+bool jc_obj_reserve(JsonObject_t* obj, size_t count)
+{
+    if (!obj || node_is_shared(obj))
+        return false;
+    size_t capacity = obj_capacity_for(count);
+    if (obj->olh_map.capacity >= capacity)
+        return true;
+    return olh_map_rehash(&obj->olh_map, capacity);
+}
+
+bool jc_arr_reserve(JsonArray_t* arr, size_t count)
+{
+    if (!arr || node_is_shared(arr))
+        return false;
+    size_t capacity = arr_capacity_for(count);
+    if (arr->capacity >= capacity)
+        return true;
+    JsonValue_t** data = (JsonValue_t**)jc_mem_realloc(arr->data, capacity * sizeof(JsonValue_t*));
+    if (!data)
+        return false;
+    arr->data = data;
+    arr->capacity = capacity;
+    return true;
+}
+
+static bool value_assign_string(JsonValue_t* value, const char* str, size_t len)
+{
+    char* copy = (char*)jc_mem_alloc_in(jc_alloc_scope_of(value), len + 1);
+    if (!copy)
+        return false;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    value->string = copy;
+    if (len < JC_STRING_LEN_UNKNOWN) {
+        value->string_len = (uint32_t)len & JC_STRING_LEN_UNKNOWN;
+        value->string_clean = !builder_needs_escape(str, len);
+    } else {
+        value->string_len = JC_STRING_LEN_UNKNOWN;
+        value->string_clean = false;
+    }
+    return true;
+}
+
+static JsonValue_t* new_string_value(const char* str, size_t len)
+{
+    JsonValue_t* value = (JsonValue_t*)jc_mem_calloc(sizeof(JsonValue_t));
+    if (!value)
+        return NULL;
+    value->ty = JC_STRING;
+    if (!value_assign_string(value, str, len)) {
+        jc_mem_free(value);
+        return NULL;
+    }
+    return value;
+}
+
+static JsonValue_t* new_raw_number_value(const char* text, size_t len, bool is_double)
+{
+    JsonValue_t* value = (JsonValue_t*)jc_mem_calloc(sizeof(JsonValue_t));
+    if (!value)
+        return NULL;
+    JsonRawNumber_t* raw = (JsonRawNumber_t*)jc_mem_alloc_in(jc_alloc_scope_of(value), sizeof(JsonRawNumber_t) + len + 1);
+    if (!raw) {
+        jc_mem_free(value);
+        return NULL;
+    }
+    memset(raw, 0, sizeof(JsonRawNumber_t));
+    raw->len = len;
+    raw->is_double = is_double;
+    memcpy(raw->text, text, len);
+    raw->text[len] = '\0';
+    value->ty = JC_NUMBER_RAW;
+    value->raw_number = raw;
+    return value;
+}
+
+// Text is the quoted string as found in the input
+static JsonValue_t* new_raw_string_value(const char* text, size_t len)
+{
+    JsonValue_t* value = (JsonValue_t*)jc_mem_calloc(sizeof(JsonValue_t));
+    if (!value)
+        return NULL;
+    JsonRawString_t* raw = (JsonRawString_t*)jc_mem_alloc_in(jc_alloc_scope_of(value), sizeof(JsonRawString_t) + len + 1);
+    if (!raw) {
+        jc_mem_free(value);
+        return NULL;
+    }
+    raw->decoded = NULL;
+    raw->len = len;
+    memcpy(raw->text, text, len);
+    raw->text[len] = '\0';
+    value->ty = JC_STRING_RAW;
+    value->raw_string = raw;
+    return value;
+}
+
+// Text has to be a complete JSON number
+static JsonValue_t* new_raw_number_value_checked(const char* text)
+{
+    JsonParser_t parser = { .text = text, .len = strlen(text) };
+    bool is_double;
+    if (!parser_scan_number(&parser, &is_double) || !parser_eof(&parser))
+        return NULL;
+    return new_raw_number_value(text, parser.len, is_double);
+}
+
 JsonValue_t* jc_new_value(JsonValueType_t ty, void* data)
 {
     if (!data && ty != JC_NULL_LITERAL && ty != JC_BOOLEAN)
         return NULL;
 
-    JsonValue_t* value = (JsonValue_t*)calloc(1, sizeof(JsonValue_t));
+    JsonValue_t* value = (JsonValue_t*)jc_mem_calloc(sizeof(JsonValue_t));
     if (!value)
         return NULL;
     value->ty = ty;
     switch (ty) {
     case JC_STRING:
-        value->string = strdup(data);
-        if (!value->string)
+        if (!value_assign_string(value, data, strlen(data))) {
+            jc_mem_free(value);
             return NULL;
+        }
         break;
     case JC_DOUBLE:
         value->num_double = *(const double*)data;
@@ -106,13 +433,20 @@ JsonValue_t* jc_new_value(JsonValueType_t ty, void* data)
         break;
     case JC_NULL_LITERAL:
         break;
+    case JC_NUMBER_RAW:
+        jc_mem_free(value);
+        return new_raw_number_value_checked(data);
+    case JC_STRING_RAW:
+        // Only created by the parser
+        jc_mem_free(value);
+        return NULL;
     }
     return value;
 }
 
 JsonValue_t* jc_new_bool_value(bool b)
 {
-    JsonValue_t* value = (JsonValue_t*)calloc(1, sizeof(JsonValue_t));
+    JsonValue_t* value = (JsonValue_t*)jc_mem_calloc(sizeof(JsonValue_t));
     if (!value)
         return NULL;
     value->ty = JC_BOOLEAN;
@@ -122,7 +456,7 @@ JsonValue_t* jc_new_bool_value(bool b)
 
 JsonValue_t* jc_new_double_value(double dbl)
 {
-    JsonValue_t* value = (JsonValue_t*)calloc(1, sizeof(JsonValue_t));
+    JsonValue_t* value = (JsonValue_t*)jc_mem_calloc(sizeof(JsonValue_t));
     if (!value)
         return NULL;
     value->ty = JC_DOUBLE;
@@ -132,7 +466,7 @@ JsonValue_t* jc_new_double_value(double dbl)
 
 JsonValue_t* jc_new_int64_value(int64_t i64)
 {
-    JsonValue_t* value = (JsonValue_t*)calloc(1, sizeof(JsonValue_t));
+    JsonValue_t* value = (JsonValue_t*)jc_mem_calloc(sizeof(JsonValue_t));
     if (!value)
         return NULL;
     value->ty = JC_INT64;
@@ -140,6 +474,178 @@ JsonValue_t* jc_new_int64_value(int64_t i64)
     return value;
 }
 
+bool jc_value_set_string(JsonValue_t* value, const char* str)
+{
+    if (!value || !str || (value->ty != JC_STRING && value->ty != JC_STRING_RAW) || node_is_shared(value))
+        return false;
+    if (value->ty == JC_STRING_RAW) {
+        JsonRawString_t* raw = value->raw_string;
+        if (!value_assign_string(value, str, strlen(str)))
+            return false;
+        value->ty = JC_STRING;
+        jc_mem_free(raw->decoded);
+        jc_mem_free(raw);
+        return true;
+    }
+    char* previous = value->string;
+    if (!value_assign_string(value, str, strlen(str)))
+        return false;
+    jc_mem_free(previous);
+    return true;
+}
+
+static inline size_t value_string_len(const JsonValue_t* value)
+{
+    return value->string_len != JC_STRING_LEN_UNKNOWN ? value->string_len : strlen(value->string);
+}
+
+const char* jc_value_get_string(const JsonValue_t* value)
+{
+    size_t len;
+    return jc_value_get_string_len(value, &len);
+}
+
+const char* jc_value_get_string_len(const JsonValue_t* value, size_t* len)
+{
+    if (!value || !len)
+        return NULL;
+    if (value->ty == JC_STRING) {
+        *len = value_string_len(value);
+        return value->string;
+    }
+    if (value->ty != JC_STRING_RAW)
+        return NULL;
+
+    JsonRawString_t* raw = value->raw_string;
+    if (raw->decoded) {
+        *len = raw->decoded_len;
+        return raw->decoded;
+    }
+    // The escapes were checked while parsing, decoding only shrinks the text
+    JsonParser_t parser = { .text = raw->text, .len = raw->len };
+    StringBuilder_t builder = { 0 };
+    char* decoded = (char*)jc_mem_alloc_in(jc_alloc_scope_of(value), raw->len);
+    if (!decoded)
+        return NULL;
+    builder_use_buffer(&builder, decoded, raw->len);
+    if (!parse_and_unescape_str(&parser, &builder) || builder.overflow) {
+        jc_mem_free(decoded);
+        return NULL;
+    }
+    decoded[builder.pos] = '\0';
+    raw->decoded_len = builder.pos;
+    raw->decoded = decoded;
+    *len = builder.pos;
+    return decoded;
+}
+
+static bool raw_number_convert(JsonRawNumber_t* raw)
+{
+    if (raw->converted)
+        return true;
+    JsonNumberToken_t token;
+    bool out_of_range = false;
+    // The text was checked when the value was created
+    if (!convert_number(raw->text, raw->len, raw->is_double, &token, &out_of_range))
+        return false;
+    raw->is_double = token.is_double;
+    raw->out_of_range = out_of_range;
+    if (token.is_double)
+        raw->num_double = token.num_double;
+    else
+        raw->num_int64 = token.num_int64;
+    raw->converted = true;
+    return true;
+}
+
+bool jc_value_get_double(const JsonValue_t* value, double* dbl)
+{
+    if (!value || !dbl)
+        return false;
+    switch (value->ty) {
+    case JC_DOUBLE:
+        *dbl = value->num_double;
+        return true;
+    case JC_INT64:
+        *dbl = (double)value->num_int64;
+        return true;
+    case JC_NUMBER_RAW:
+        if (!raw_number_convert(value->raw_number))
+            return false;
+        *dbl = value->raw_number->is_double ? value->raw_number->num_double : (double)value->raw_number->num_int64;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool jc_value_get_int64(const JsonValue_t* value, int64_t* i64)
+{
+    if (!value || !i64)
+        return false;
+    switch (value->ty) {
+    case JC_DOUBLE:
+        *i64 = (int64_t)value->num_double;
+        return true;
+    case JC_INT64:
+        *i64 = value->num_int64;
+        return true;
+    case JC_NUMBER_RAW:
+        if (!raw_number_convert(value->raw_number) || value->raw_number->out_of_range)
+            return false;
+        *i64 = value->raw_number->is_double ? (int64_t)value->raw_number->num_double : value->raw_number->num_int64;
+        return true;
+    default:
+        return false;
+    }
+}
+
+JsonValueType_t jc_value_number_type(const JsonValue_t* value)
+{
+    assert(value);
+    if (value->ty != JC_NUMBER_RAW)
+        return value->ty;
+    // Without memory for the conversion the scanned kind is reported
+    raw_number_convert(value->raw_number);
+    return value->raw_number->is_double ? JC_DOUBLE : JC_INT64;
+}
+
+const char* jc_value_number_text(const JsonValue_t* value, size_t* len)
+{
+    if (!value || value->ty != JC_NUMBER_RAW)
+        return NULL;
+    if (len)
+        *len = value->raw_number->len;
+    return value->raw_number->text;
+}
+
+static bool value_is_number(const JsonValue_t* value)
+{
+    return value && (value->ty == JC_DOUBLE || value->ty == JC_INT64 || value->ty == JC_NUMBER_RAW);
+}
+
+bool jc_value_set_double(JsonValue_t* value, double dbl)
+{
+    if (!value_is_number(value) || node_is_shared(value))
+        return false;
+    if (value->ty == JC_NUMBER_RAW)
+        jc_mem_free(value->raw_number);
+    value->ty = JC_DOUBLE;
+    value->num_double = dbl;
+    return true;
+}
+
+bool jc_value_set_int64(JsonValue_t* value, int64_t i64)
+{
+    if (!value_is_number(value) || node_is_shared(value))
+        return false;
+    if (value->ty == JC_NUMBER_RAW)
+        jc_mem_free(value->raw_number);
+    value->ty = JC_INT64;
+    value->num_int64 = i64;
+    return true;
+}
+
 void jc_free_doc(JsonDocument_t* doc)
 {
     if (!doc)
@@ -148,25 +654,27 @@ void jc_free_doc(JsonDocument_t* doc)
         jc_free_obj(doc->object);
     if (doc->array)
         jc_free_arr(doc->array);
-    free(doc);
+    JsonAllocScope_t* scope = jc_alloc_scope_of(doc);
+    jc_mem_free(doc);
+    jc_alloc_scope_release(scope);
 }
 
 void jc_free_obj(JsonObject_t* obj)
 {
-    if (!obj)
+    if (!obj || !node_release(obj, &obj->refs))
         return;
     olh_map_free(&obj->olh_map);
-    free(obj);
+    jc_mem_free(obj);
 }
 
 void jc_free_arr(JsonArray_t* arr)
 {
-    if (!arr)
+    if (!arr || !node_release(arr, &arr->refs))
         return;
     for (size_t i = 0; i < arr->size; i++)
         jc_free_value(arr->data[i]);
-    free(arr->data);
-    free(arr);
+    jc_mem_free(arr->data);
+    jc_mem_free(arr);
 }
 
 void jc_free_value(JsonValue_t* value)
@@ -174,9 +682,18 @@ void jc_free_value(JsonValue_t* value)
     if (!value)
         return;
     if (value->ty == JC_STRING && value->string) {
-        free(value->string);
+        jc_mem_free(value->string);
         value->string = NULL;
     }
+    if (value->ty == JC_NUMBER_RAW && value->raw_number) {
+        jc_mem_free(value->raw_number);
+        value->raw_number = NULL;
+    }
+    if (value->ty == JC_STRING_RAW && value->raw_string) {
+        jc_mem_free(value->raw_string->decoded);
+        jc_mem_free(value->raw_string);
+        value->raw_string = NULL;
+    }
     if (value->ty == JC_OBJECT && value->object) {
         jc_free_obj(value->object);
         value->object = NULL;
@@ -185,7 +702,7 @@ void jc_free_value(JsonValue_t* value)
         jc_free_arr(value->array);
         value->array = NULL;
     }
-    free(value);
+    jc_mem_free(value);
 }
 
 bool jc_doc_set_obj(JsonDocument_t* doc, JsonObject_t* obj)
@@ -205,7 +722,7 @@ bool jc_doc_is_obj(const JsonDocument_t* doc)
     return doc->object != NULL;
 }
 
-JsonObject_t* jc_doc_get_obj(JsonDocument_t* doc)
+JsonObject_t* jc_doc_get_obj(const JsonDocument_t* doc)
 {
     return doc->object;
 }
@@ -227,7 +744,7 @@ bool jc_doc_is_arr(const JsonDocument_t* doc)
     return doc->array != NULL;
 }
 
-JsonArray_t* jc_doc_get_arr(JsonDocument_t* doc)
+JsonArray_t* jc_doc_get_arr(const JsonDocument_t* doc)
 {
     return doc->array;
 }
@@ -248,10 +765,10 @@ bool jc_arr_insert(JsonArray_t* arr, JsonValueType_t ty, void* data)
 
 bool jc_arr_insert_value(JsonArray_t* arr, JsonValue_t* value)
 {
-    if (!arr || !value)
+    if (!arr || !value || node_is_shared(arr))
         return false;
     if (arr->size + 1 >= arr->capacity) {
-        JsonValue_t** new_buffer = (JsonValue_t**)realloc(arr->data, arr->capacity * 2 * sizeof(JsonValue_t*));
+        JsonValue_t** new_buffer = (JsonValue_t**)jc_mem_realloc(arr->data, arr->capacity * 2 * sizeof(JsonValue_t*));
         if (!new_buffer)
             return false;
         arr->data = new_buffer;
@@ -262,13 +779,13 @@ bool jc_arr_insert_value(JsonArray_t* arr, JsonValue_t* value)
     return true;
 }
 
-size_t jc_arr_size(JsonArray_t* arr)
+size_t jc_arr_size(const JsonArray_t* arr)
 {
     assert(arr);
     return arr->size;
 }
 
-JsonValue_t* jc_arr_at(JsonArray_t* arr, size_t index)
+JsonValue_t* jc_arr_at(const JsonArray_t* arr, size_t index)
 {
     assert(arr);
     if (index >= arr->size)
@@ -279,22 +796,23 @@ JsonValue_t* jc_arr_at(JsonArray_t* arr, size_t index)
 bool jc_arr_remove(JsonArray_t* arr, size_t index, size_t count)
 {
     assert(arr);
-    size_t end = index + count;
-    if (index >= arr->size || end >= arr->size)
+    if (index >= arr->size || count >= arr->size - index || node_is_shared(arr))
         return false;
+    size_t end = index + count;
 
     for (size_t i = index; i < end; i++) {
         if (arr->data[i])
             jc_free_value(arr->data[i]);
     }
-    memmove(&arr->data[index], &arr->data[end], (arr->size - count) * sizeof(JsonValue_t*));
+    // Compacted and presized arrays have no slack past size
+    memmove(&arr->data[index], &arr->data[end], (arr->size - end) * sizeof(JsonValue_t*));
     arr->size -= count;
     return true;
 }
 
 bool jc_obj_set(JsonObject_t* obj, const char* key, JsonValue_t* value)
 {
-    if (!obj || !key || !value)
+    if (!obj || !key || !value || node_is_shared(obj))
         return false;
     return olh_map_set(&obj->olh_map, key, value);
 }
@@ -308,7 +826,10 @@ bool jc_obj_insert(JsonObject_t* obj, const char* key, JsonValueType_t ty, void*
     JsonValue_t* value = jc_new_value(ty, data);
     if (!value)
         return false;
-    jc_obj_set(obj, key, value);
+    if (!jc_obj_set(obj, key, value)) {
+        jc_free_value(value);
+        return false;
+    }
     return true;
 }
 
@@ -320,7 +841,7 @@ size_t jc_obj_size(const JsonObject_t* obj)
 
 bool jc_obj_remove(JsonObject_t* obj, const char* key)
 {
-    if (!obj || !key)
+    if (!obj || !key || node_is_shared(obj))
         return false;
     return olh_map_remove(&obj->olh_map, key);
 }
@@ -332,58 +853,144 @@ JsonValue_t* jc_obj_get(const JsonObject_t* obj, const char* key)
     return (JsonValue_t*)olh_map_get(&obj->olh_map, key);
 }
 
-const char* jc_obj_get_string(const JsonObject_t* obj, const char* key)
+JsonKey_t jc_key(const char* str)
 {
-    JsonValue_t* value = jc_obj_get(obj, key);
-    if (!value || value->ty != JC_STRING)
-        return NULL;
-    return value->string;
+    JsonKey_t key = { .str = str };
+    if (str) {
+        key.len = strlen(str);
+        key.hash = jc_key_hash(str, key.len);
+    }
+    return key;
 }
 
-bool* jc_obj_get_bool(const JsonObject_t* obj, const char* key)
+JsonValue_t* jc_obj_get_k(const JsonObject_t* obj, JsonKey_t key)
 {
-    JsonValue_t* value = jc_obj_get(obj, key);
-    if (!value || value->ty != JC_BOOLEAN)
+    if (!obj || !key.str)
         return NULL;
-    return &value->boolean;
+    return (JsonValue_t*)olh_map_get_hashed(&obj->olh_map, key.str, key.len, key.hash);
 }
 
-bool jc_obj_get_double(const JsonObject_t* obj, const char* key, double* dbl)
+bool jc_obj_set_k(JsonObject_t* obj, JsonKey_t key, JsonValue_t* value)
 {
-    JsonValue_t* value = jc_obj_get(obj, key);
-    if (!value)
+    if (!obj || !key.str || !value || node_is_shared(obj))
         return false;
+    return olh_map_set_hashed(&obj->olh_map, key.str, key.len, key.hash, value);
+}
 
-    switch (value->ty) {
-    case JC_DOUBLE:
-        *dbl = value->num_double;
-        break;
-    case JC_INT64:
-        *dbl = (double)value->num_int64;
-        break;
-    default:
+/*
+ *   Key sets
+ */
+
+#ifndef JC_KEYSET_SEED_ATTEMPTS
+#    define JC_KEYSET_SEED_ATTEMPTS 4096
+#endif
+
+static inline size_t keyset_slot(const JsonKeySet_t* set, uint32_t hash)
+{
+    return (uint32_t)(hash * set->seed) >> set->shift;
+}
+
+// Tries multipliers until every key lands in its own slot, starting with the smallest table that
+// leaves at least half of the slots empty
+static bool keyset_build(JsonKeySet_t* set)
+{
+    for (size_t i = 0; i < set->count; i++)
+        for (size_t j = 0; j < i; j++)
+            if (set->keys[i].hash == set->keys[j].hash)
+                return false;
+
+    uint32_t bits = 1;
+    while (((size_t)1 << bits) < set->count * 2)
+        bits++;
+
+    uint32_t state = 0x9e3779b9u;
+    for (; ((size_t)1 << bits) <= JC_KEYSET_MAX_SLOTS; bits++) {
+        size_t slot_count = (size_t)1 << bits;
+        set->shift = 32 - bits;
+        for (size_t attempt = 0; attempt < JC_KEYSET_SEED_ATTEMPTS; attempt++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            set->seed = state | 1u;
+
+            memset(set->slots, 0, slot_count);
+            bool collision = false;
+            for (size_t i = 0; !collision && i < set->count; i++) {
+                uint8_t* slot = &set->slots[keyset_slot(set, set->keys[i].hash)];
+                collision = *slot != 0;
+                *slot = (uint8_t)(i + 1);
+            }
+            if (!collision) {
+                set->ready = true;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool jc_keyset_init(JsonKeySet_t* set, const char* const* keys, size_t count)
+{
+    if (!set || (!keys && count) || count > JC_KEYSET_MAX_KEYS)
         return false;
+    memset(set, 0, sizeof(JsonKeySet_t));
+    for (size_t i = 0; i < count; i++) {
+        if (!keys[i])
+            return false;
+        set->keys[i] = jc_key(keys[i]);
     }
-    return true;
+    set->count = count;
+    return keyset_build(set);
 }
 
-bool jc_obj_get_int64(const JsonObject_t* obj, const char* key, int64_t* i64)
+int jc_keyset_find(const JsonKeySet_t* set, const char* str, size_t len)
+{
+    return jc_keyset_find_hashed(set, str, len, jc_key_hash(str, len));
+}
+
+int jc_keyset_find_hashed(const JsonKeySet_t* set, const char* str, size_t len, uint32_t hash)
+{
+    assert(set && set->ready);
+    uint8_t slot = set->slots[keyset_slot(set, hash)];
+    if (!slot)
+        return -1;
+    const JsonKey_t* key = &set->keys[slot - 1];
+    if (key->hash != hash || key->len != len || memcmp(key->str, str, len) != 0)
+        return -1;
+    return slot - 1;
+}
+
+size_t jc_obj_get_keyset(const JsonObject_t* obj, const JsonKeySet_t* set, JsonValue_t** values)
+{
+    if (!set || !values)
+        return 0;
+    memset(values, 0, set->count * sizeof(JsonValue_t*));
+    if (!obj)
+        return 0;
+    return olh_map_get_keyset(&obj->olh_map, set, (void**)values);
+}
+
+const char* jc_obj_get_string(const JsonObject_t* obj, const char* key)
+{
+    return jc_value_get_string(jc_obj_get(obj, key));
+}
+
+bool* jc_obj_get_bool(const JsonObject_t* obj, const char* key)
 {
     JsonValue_t* value = jc_obj_get(obj, key);
-    if (!value)
-        return false;
+    if (!value || value->ty != JC_BOOLEAN)
+        return NULL;
+    return &value->boolean;
+}
 
-    switch (value->ty) {
-    case JC_DOUBLE:
-        *i64 = (int64_t)value->num_double;
-        break;
-    case JC_INT64:
-        *i64 = value->num_int64;
-        break;
-    default:
-        return false;
-    }
-    return true;
+bool jc_obj_get_double(const JsonObject_t* obj, const char* key, double* dbl)
+{
+    return jc_value_get_double(jc_obj_get(obj, key), dbl);
+}
+
+bool jc_obj_get_int64(const JsonObject_t* obj, const char* key, int64_t* i64)
+{
+    return jc_value_get_int64(jc_obj_get(obj, key), i64);
 }
 
 JsonObject_t* jc_obj_get_obj(const JsonObject_t* obj, const char* key)
@@ -431,6 +1038,493 @@ JsonValue_t* jc_obj_iter_value(const JsonObjectIter_t* iter)
     return ((BucketEntry_t*)iter->opaque)->value;
 }
 
+/*
+ *   Compaction
+ */
+
+// Compacted arrays are full, the next insert grows them
+static inline size_t compact_arr_capacity(size_t size)
+{
+    return size ? size : 1;
+}
+
+static bool compact_obj(JsonObject_t* obj);
+static bool compact_arr(JsonArray_t* arr);
+
+// Shared subtrees are left alone
+static bool compact_value(JsonValue_t* value)
+{
+    if (value->ty == JC_OBJECT && !node_is_shared(value->object))
+        return compact_obj(value->object);
+    if (value->ty == JC_ARRAY && !node_is_shared(value->array))
+        return compact_arr(value->array);
+    return true;
+}
+
+static bool compact_obj(JsonObject_t* obj)
+{
+    OrderedLinkedHashMap_t* map = &obj->olh_map;
+    bool success = true;
+    size_t capacity = obj_capacity_for(map->size);
+    if (map->capacity != capacity || map->deleted_count)
+        success = olh_map_rehash(map, capacity);
+    for (BucketEntry_t* bucket = map->head; bucket; bucket = bucket->next)
+        success = compact_value(bucket->value) && success;
+    return success;
+}
+
+static bool compact_arr(JsonArray_t* arr)
+{
+    bool success = true;
+    size_t capacity = compact_arr_capacity(arr->size);
+    if (arr->capacity != capacity) {
+        JsonValue_t** data = (JsonValue_t**)jc_mem_realloc(arr->data, capacity * sizeof(JsonValue_t*));
+        if (data) {
+            arr->data = data;
+            arr->capacity = capacity;
+        } else {
+            success = false;
+        }
+    }
+    for (size_t i = 0; i < arr->size; i++)
+        success = compact_value(arr->data[i]) && success;
+    return success;
+}
+
+// Size of the arena block holding a compacted copy of a tree
+static size_t arena_size_obj(const JsonObject_t* obj);
+static size_t arena_size_arr(const JsonArray_t* arr);
+
+static size_t arena_size_value(const JsonValue_t* value)
+{
+    size_t size = jc_mem_arena_size(sizeof(JsonValue_t));
+    if (value->ty == JC_STRING)
+        size += jc_mem_arena_size(value_string_len(value) + 1);
+    else if (value->ty == JC_NUMBER_RAW)
+        size += jc_mem_arena_size(sizeof(JsonRawNumber_t) + value->raw_number->len + 1);
+    else if (value->ty == JC_STRING_RAW)
+        size += jc_mem_arena_size(sizeof(JsonRawString_t) + value->raw_string->len + 1);
+    else if (value->ty == JC_OBJECT && !node_is_shared(value->object))
+        size += arena_size_obj(value->object);
+    else if (value->ty == JC_ARRAY && !node_is_shared(value->array))
+        size += arena_size_arr(value->array);
+    return size;
+}
+
+static size_t arena_size_obj(const JsonObject_t* obj)
+{
+    const OrderedLinkedHashMap_t* map = &obj->olh_map;
+    size_t size = jc_mem_arena_size(sizeof(JsonObject_t));
+    size += jc_mem_arena_size(obj_capacity_for(map->size) * sizeof(BucketEntry_t));
+    for (const BucketEntry_t* bucket = map->head; bucket; bucket = bucket->next) {
+        size_t key_len = olh_map_key_len(bucket);
+        size += jc_mem_arena_size(key_len + 1) + arena_size_value(bucket->value);
+    }
+    return size;
+}
+
+static size_t arena_size_arr(const JsonArray_t* arr)
+{
+    size_t size = jc_mem_arena_size(sizeof(JsonArray_t));
+    size += jc_mem_arena_size(compact_arr_capacity(arr->size) * sizeof(JsonValue_t*));
+    for (size_t i = 0; i < arr->size; i++)
+        size += arena_size_value(arr->data[i]);
+    return size;
+}
+
+// Depth first copies at compact capacity, allocated in the current scope. Shared subtrees are
+// referenced instead of copied.
+static JsonObject_t* copy_obj(const JsonObject_t* obj);
+static JsonArray_t* copy_arr(const JsonArray_t* arr);
+
+static JsonValue_t* copy_value(const JsonValue_t* value)
+{
+    JsonValue_t* copy = (JsonValue_t*)jc_mem_alloc(sizeof(JsonValue_t));
+    if (!copy)
+        return NULL;
+    *copy = *value;
+    bool copied = true;
+    switch (value->ty) {
+    case JC_STRING: {
+        size_t len = value_string_len(value);
+        copy->string = (char*)jc_mem_alloc_in(jc_alloc_scope_of(copy), len + 1);
+        copied = copy->string != NULL;
+        if (copied)
+            memcpy(copy->string, value->string, len + 1);
+        break;
+    }
+    case JC_NUMBER_RAW: {
+        size_t size = sizeof(JsonRawNumber_t) + value->raw_number->len + 1;
+        copy->raw_number = (JsonRawNumber_t*)jc_mem_alloc_in(jc_alloc_scope_of(copy), size);
+        copied = copy->raw_number != NULL;
+        if (copied)
+            memcpy(copy->raw_number, value->raw_number, size);
+        break;
+    }
+    case JC_STRING_RAW: {
+        // The copy decodes again when it is read
+        size_t size = sizeof(JsonRawString_t) + value->raw_string->len + 1;
+        copy->raw_string = (JsonRawString_t*)jc_mem_alloc_in(jc_alloc_scope_of(copy), size);
+        copied = copy->raw_string != NULL;
+        if (copied) {
+            memcpy(copy->raw_string, value->raw_string, size);
+            copy->raw_string->decoded = NULL;
+        }
+        break;
+    }
+    case JC_OBJECT:
+        copy->object = node_is_shared(value->object) ? jc_obj_retain(value->object) : copy_obj(value->object);
+        copied = copy->object != NULL;
+        break;
+    case JC_ARRAY:
+        copy->array = node_is_shared(value->array) ? jc_arr_retain(value->array) : copy_arr(value->array);
+        copied = copy->array != NULL;
+        break;
+    default:
+        break;
+    }
+    if (!copied) {
+        jc_mem_free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+static void* copy_bucket_value(const void* value)
+{
+    return copy_value((const JsonValue_t*)value);
+}
+
+static JsonObject_t* copy_obj(const JsonObject_t* obj)
+{
+    JsonObject_t* copy = new_obj_with_capacity(obj_capacity_for(obj->olh_map.size));
+    if (!copy)
+        return NULL;
+    if (!olh_map_copy(&copy->olh_map, &obj->olh_map, copy_bucket_value)) {
+        jc_free_obj(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+static JsonArray_t* copy_arr(const JsonArray_t* arr)
+{
+    JsonArray_t* copy = new_arr_with_capacity(compact_arr_capacity(arr->size));
+    if (!copy)
+        return NULL;
+    for (size_t i = 0; i < arr->size; i++) {
+        JsonValue_t* value = copy_value(arr->data[i]);
+        if (!value)
+            goto EXIT_ERROR;
+        copy->data[copy->size++] = value;
+    }
+    return copy;
+EXIT_ERROR:
+    jc_free_arr(copy);
+    return NULL;
+}
+
+static bool compact_doc_contiguous(JsonDocument_t* doc)
+{
+    JsonAllocScope_t* scope = jc_alloc_scope_of(doc);
+    size_t size = doc->object ? arena_size_obj(doc->object) : arena_size_arr(doc->array);
+    JsonAllocScope_t* arena = jc_alloc_scope_new_arena(jc_alloc_scope_allocator(scope), size);
+    if (!arena)
+        return false;
+
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(arena);
+    JsonObject_t* object = doc->object ? copy_obj(doc->object) : NULL;
+    JsonArray_t* array = doc->array ? copy_arr(doc->array) : NULL;
+    jc_alloc_scope_enter(previous_scope);
+    if (!object && !array) {
+        jc_alloc_scope_release(arena);
+        return false;
+    }
+
+    jc_free_obj(doc->object);
+    jc_free_arr(doc->array);
+    doc->object = object;
+    doc->array = array;
+    // The document itself stays where it is and moves over to the arena scope, which frees
+    // everything outside of its block through the same allocator
+    if (previous_scope == scope)
+        jc_alloc_scope_enter(arena);
+    jc_mem_adopt(arena, doc);
+    jc_alloc_scope_release(scope);
+    return true;
+}
+
+// Copies a tree into a new document with the same allocator, contiguous clones fill a single arena block
+static JsonDocument_t* clone_doc(const JsonDocument_t* doc, bool contiguous)
+{
+    const JsonAllocator_t* allocator = jc_alloc_scope_allocator(jc_alloc_scope_of(doc));
+    JsonAllocScope_t* scope;
+    if (contiguous) {
+        size_t size = jc_mem_arena_size(sizeof(JsonDocument_t));
+        if (doc->object && !node_is_shared(doc->object))
+            size += arena_size_obj(doc->object);
+        if (doc->array && !node_is_shared(doc->array))
+            size += arena_size_arr(doc->array);
+        scope = jc_alloc_scope_new_arena(allocator, size);
+    } else {
+        scope = jc_alloc_scope_new(allocator);
+    }
+    if (!scope)
+        return NULL;
+
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(scope);
+    JsonDocument_t* clone = (JsonDocument_t*)jc_mem_calloc(sizeof(JsonDocument_t));
+    bool copied = clone != NULL;
+    // Shared roots are referenced like shared members, see jc_doc_get_obj_mut
+    if (copied && doc->object)
+        copied = (clone->object = node_is_shared(doc->object) ? jc_obj_retain(doc->object) : copy_obj(doc->object)) != NULL;
+    if (copied && doc->array)
+        copied = (clone->array = node_is_shared(doc->array) ? jc_arr_retain(doc->array) : copy_arr(doc->array)) != NULL;
+    jc_alloc_scope_enter(previous_scope);
+    if (!copied) {
+        if (clone)
+            jc_free_doc(clone);
+        else
+            jc_alloc_scope_release(scope);
+        return NULL;
+    }
+    return clone;
+}
+
+JsonDocument_t* jc_doc_clone(const JsonDocument_t* doc, bool contiguous)
+{
+    return doc ? clone_doc(doc, contiguous) : NULL;
+}
+
+JsonObject_t* jc_obj_clone(const JsonObject_t* obj, const JsonDocument_t* target)
+{
+    if (!obj)
+        return NULL;
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(target ? jc_alloc_scope_of(target) : jc_alloc_scope_current());
+    JsonObject_t* clone = copy_obj(obj);
+    jc_alloc_scope_enter(previous_scope);
+    return clone;
+}
+
+JsonArray_t* jc_arr_clone(const JsonArray_t* arr, const JsonDocument_t* target)
+{
+    if (!arr)
+        return NULL;
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(target ? jc_alloc_scope_of(target) : jc_alloc_scope_current());
+    JsonArray_t* clone = copy_arr(arr);
+    jc_alloc_scope_enter(previous_scope);
+    return clone;
+}
+
+/*
+ *   Shared subtrees
+ */
+
+// Converts raw values up front, shared values must not be written by their first read
+static bool freeze_value(const JsonAllocScope_t* scope, JsonValue_t* value);
+
+static bool freeze_obj(const JsonAllocScope_t* scope, JsonObject_t* obj)
+{
+    for (BucketEntry_t* bucket = obj->olh_map.head; bucket; bucket = bucket->next)
+        if (!freeze_value(scope, bucket->value))
+            return false;
+    return true;
+}
+
+static bool freeze_arr(const JsonAllocScope_t* scope, JsonArray_t* arr)
+{
+    for (size_t i = 0; i < arr->size; i++)
+        if (!freeze_value(scope, arr->data[i]))
+            return false;
+    return true;
+}
+
+static bool freeze_value(const JsonAllocScope_t* scope, JsonValue_t* value)
+{
+    switch (value->ty) {
+    case JC_NUMBER_RAW:
+        return raw_number_convert(value->raw_number);
+    case JC_STRING_RAW:
+        return jc_value_get_string(value) != NULL;
+    // Subtrees from other shared scopes are frozen already
+    case JC_OBJECT:
+        return jc_alloc_scope_of(value->object) != scope || freeze_obj(scope, value->object);
+    case JC_ARRAY:
+        return jc_alloc_scope_of(value->array) != scope || freeze_arr(scope, value->array);
+    default:
+        return true;
+    }
+}
+
+JsonObject_t* jc_obj_share(const JsonObject_t* obj)
+{
+    if (!obj)
+        return NULL;
+    if (node_is_shared(obj))
+        return jc_obj_retain((JsonObject_t*)obj);
+    const JsonAllocator_t* allocator = jc_alloc_scope_allocator(jc_alloc_scope_of(obj));
+    JsonAllocScope_t* scope = jc_alloc_scope_new_shared(allocator, arena_size_obj(obj));
+    if (!scope)
+        return NULL;
+
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(scope);
+    JsonObject_t* shared = copy_obj(obj);
+    if (shared && !freeze_obj(scope, shared)) {
+        jc_free_obj(shared);
+        shared = NULL;
+    }
+    jc_alloc_scope_enter(previous_scope);
+    jc_alloc_scope_release(scope);
+    return shared;
+}
+
+JsonArray_t* jc_arr_share(const JsonArray_t* arr)
+{
+    if (!arr)
+        return NULL;
+    if (node_is_shared(arr))
+        return jc_arr_retain((JsonArray_t*)arr);
+    const JsonAllocator_t* allocator = jc_alloc_scope_allocator(jc_alloc_scope_of(arr));
+    JsonAllocScope_t* scope = jc_alloc_scope_new_shared(allocator, arena_size_arr(arr));
+    if (!scope)
+        return NULL;
+
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(scope);
+    JsonArray_t* shared = copy_arr(arr);
+    if (shared && !freeze_arr(scope, shared)) {
+        jc_free_arr(shared);
+        shared = NULL;
+    }
+    jc_alloc_scope_enter(previous_scope);
+    jc_alloc_scope_release(scope);
+    return shared;
+}
+
+JsonObject_t* jc_obj_retain(JsonObject_t* obj)
+{
+    if (!obj || !node_is_shared(obj))
+        return NULL;
+    __atomic_add_fetch(&obj->refs, 1, __ATOMIC_RELAXED);
+    return obj;
+}
+
+JsonArray_t* jc_arr_retain(JsonArray_t* arr)
+{
+    if (!arr || !node_is_shared(arr))
+        return NULL;
+    __atomic_add_fetch(&arr->refs, 1, __ATOMIC_RELAXED);
+    return arr;
+}
+
+bool jc_obj_is_shared(const JsonObject_t* obj)
+{
+    return obj && node_is_shared(obj);
+}
+
+bool jc_arr_is_shared(const JsonArray_t* arr)
+{
+    return arr && node_is_shared(arr);
+}
+
+// The private copy references the members of the shared container and is allocated next to the value
+bool jc_value_unshare(JsonValue_t* value)
+{
+    if (!value || node_is_shared(value))
+        return false;
+    bool is_obj = value->ty == JC_OBJECT && node_is_shared(value->object);
+    bool is_arr = value->ty == JC_ARRAY && node_is_shared(value->array);
+    if (!is_obj && !is_arr)
+        return true;
+
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(jc_alloc_scope_of(value));
+    JsonObject_t* object = is_obj ? copy_obj(value->object) : NULL;
+    JsonArray_t* array = is_arr ? copy_arr(value->array) : NULL;
+    jc_alloc_scope_enter(previous_scope);
+    if (!object && !array)
+        return false;
+    if (object) {
+        jc_free_obj(value->object);
+        value->object = object;
+    } else {
+        jc_free_arr(value->array);
+        value->array = array;
+    }
+    return true;
+}
+
+JsonObject_t* jc_doc_get_obj_mut(JsonDocument_t* doc)
+{
+    if (!doc || !doc->object || !node_is_shared(doc->object))
+        return doc ? doc->object : NULL;
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(jc_alloc_scope_of(doc));
+    JsonObject_t* object = copy_obj(doc->object);
+    jc_alloc_scope_enter(previous_scope);
+    if (!object)
+        return NULL;
+    jc_free_obj(doc->object);
+    doc->object = object;
+    return object;
+}
+
+JsonArray_t* jc_doc_get_arr_mut(JsonDocument_t* doc)
+{
+    if (!doc || !doc->array || !node_is_shared(doc->array))
+        return doc ? doc->array : NULL;
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(jc_alloc_scope_of(doc));
+    JsonArray_t* array = copy_arr(doc->array);
+    jc_alloc_scope_enter(previous_scope);
+    if (!array)
+        return NULL;
+    jc_free_arr(doc->array);
+    doc->array = array;
+    return array;
+}
+
+JsonObject_t* jc_obj_get_obj_mut(JsonObject_t* obj, const char* key)
+{
+    JsonValue_t* value = jc_obj_get(obj, key);
+    if (!value || value->ty != JC_OBJECT || !jc_value_unshare(value))
+        return NULL;
+    return value->object;
+}
+
+JsonArray_t* jc_obj_get_arr_mut(JsonObject_t* obj, const char* key)
+{
+    JsonValue_t* value = jc_obj_get(obj, key);
+    if (!value || value->ty != JC_ARRAY || !jc_value_unshare(value))
+        return NULL;
+    return value->array;
+}
+
+JsonObject_t* jc_arr_get_obj_mut(JsonArray_t* arr, size_t index)
+{
+    JsonValue_t* value = arr ? jc_arr_at(arr, index) : NULL;
+    if (!value || value->ty != JC_OBJECT || !jc_value_unshare(value))
+        return NULL;
+    return value->object;
+}
+
+JsonArray_t* jc_arr_get_arr_mut(JsonArray_t* arr, size_t index)
+{
+    JsonValue_t* value = arr ? jc_arr_at(arr, index) : NULL;
+    if (!value || value->ty != JC_ARRAY || !jc_value_unshare(value))
+        return NULL;
+    return value->array;
+}
+
+bool jc_doc_compact(JsonDocument_t* doc, bool contiguous)
+{
+    if (!doc)
+        return false;
+    if (!doc->object && !doc->array)
+        return true;
+    if (doc->object ? node_is_shared(doc->object) : node_is_shared(doc->array))
+        return true;
+    if (contiguous)
+        return compact_doc_contiguous(doc);
+    return doc->object ? compact_obj(doc->object) : compact_arr(doc->array);
+}
+
 /*
  *   Serialization
  */
@@ -440,15 +1534,26 @@ static void print_indent(StringBuilder_t* builder, size_t spaces_per_indent, siz
     builder_append_chrs(builder, ' ', spaces_per_indent * indent_level);
 }
 
+static void builder_serialize_str(StringBuilder_t* builder, const char* str, size_t len, bool clean)
+{
+    builder_append_ch(builder, '"');
+    if (clean)
+        builder_append_str(builder, str, len);
+    else
+        builder_append_escaped(builder, str, len);
+    builder_append_ch(builder, '"');
+}
+
 static void builder_serialize_value(StringBuilder_t* builder, const JsonValue_t* value, size_t spaces_per_indent, size_t indent_level)
 {
     if (!builder || !value)
         return;
     switch (value->ty) {
     case JC_STRING:
-        builder_append_ch(builder, '"');
-        builder_append_escaped_str(builder, value->string);
-        builder_append_ch(builder, '"');
+        if (value->string_len == JC_STRING_LEN_UNKNOWN)
+            builder_serialize_str(builder, value->string, strlen(value->string), false);
+        else
+            builder_serialize_str(builder, value->string, value->string_len, value->string_clean);
         break;
     case JC_DOUBLE:
         builder_append(builder, "%g", value->num_double);
@@ -468,6 +1573,12 @@ static void builder_serialize_value(StringBuilder_t* builder, const JsonValue_t*
     case JC_NULL_LITERAL:
         builder_append(builder, "null");
         break;
+    case JC_NUMBER_RAW:
+        builder_append_str(builder, value->raw_number->text, value->raw_number->len);
+        break;
+    case JC_STRING_RAW:
+        builder_append_str(builder, value->raw_string->text, value->raw_string->len);
+        break;
     }
 }
 
@@ -479,9 +1590,10 @@ void builder_serialize_obj(StringBuilder_t* builder, const JsonObject_t* obj, si
         builder_append_ch(builder, '\n');
     while (current) {
         print_indent(builder, spaces_per_indent, indent_level + 1);
-        builder_append_ch(builder, '"');
-        builder_append_escaped_str(builder, current->key);
-        builder_append_ch(builder, '"');
+        if (current->key_len == OLH_MAP_KEY_LEN_UNKNOWN)
+            builder_serialize_str(builder, current->key, strlen(current->key), false);
+        else
+            builder_serialize_str(builder, current->key, current->key_len, current->key_clean);
         builder_append_ch(builder, ':');
         if (spaces_per_indent != 0)
             builder_append_ch(builder, ' ');
@@ -523,69 +1635,53 @@ void builder_serialize_arr(StringBuilder_t* builder, const JsonArray_t* arr, siz
     builder_append_ch(builder, ']');
 }
 
-char* jc_doc_to_string(const JsonDocument_t* doc, size_t spaces_per_indent)
+static void builder_serialize_doc(StringBuilder_t* builder, const JsonDocument_t* doc, size_t spaces_per_indent)
 {
-    if (doc->array && doc->object)
-        return NULL;
-    StringBuilder_t builder = { 0 };
-    builder_resize(&builder, 64);
     if (doc->object)
-        builder_serialize_obj(&builder, doc->object, spaces_per_indent, 0);
+        builder_serialize_obj(builder, doc->object, spaces_per_indent, 0);
     if (doc->array)
-        builder_serialize_arr(&builder, doc->array, spaces_per_indent, 0);
-    return builder.buffer;
+        builder_serialize_arr(builder, doc->array, spaces_per_indent, 0);
 }
 
-/*
- * Parsing
- */
-
-static inline bool parser_eof(const JsonParser_t* parser) { return parser->pos >= parser->len; }
-
-static inline size_t parser_remaining(const JsonParser_t* parser) { return parser->len - parser->pos; }
-
-void parser_ignore(JsonParser_t* parser, size_t count)
+size_t jc_doc_serialized_size(const JsonDocument_t* doc, size_t spaces_per_indent)
 {
-    size_t skipped = count;
-    size_t remanining = parser->len - parser->pos;
-    if (skipped >= remanining)
-        skipped = remanining;
-    parser->pos += skipped;
+    // A builder without storage only counts, the result matches the serializer byte for byte
+    StringBuilder_t builder;
+    builder_use_buffer(&builder, NULL, 0);
+    builder_serialize_doc(&builder, doc, spaces_per_indent);
+    return builder.pos;
 }
 
-char parser_consume(JsonParser_t* parser)
-{
-    if (parser->pos >= parser->len)
-        return EOF;
-    return parser->text[parser->pos++];
-}
-
-char parser_peek(JsonParser_t* parser, size_t off)
+char* jc_doc_to_string(const JsonDocument_t* doc, size_t spaces_per_indent)
 {
-    if (parser->pos + off >= parser->len)
-        return EOF;
-    return parser->text[parser->pos + off];
+    if (doc->array && doc->object)
+        return NULL;
+    size_t size = jc_doc_serialized_size(doc, spaces_per_indent) + 1;
+    char* buffer = (char*)malloc(size);
+    if (!buffer)
+        return NULL;
+    StringBuilder_t builder;
+    builder_use_buffer(&builder, buffer, size);
+    builder_serialize_doc(&builder, doc, spaces_per_indent);
+    assert(!builder.overflow);
+    return buffer;
 }
 
-static inline bool parser_consume_specific(JsonParser_t* parser, const char* str, size_t len)
+bool jc_doc_to_buffer(const JsonDocument_t* doc, size_t spaces_per_indent, char* buffer, size_t capacity, size_t* needed)
 {
-    if (strncmp(&parser->text[parser->pos], str, len) != 0)
+    if (doc->array && doc->object)
         return false;
-    parser_ignore(parser, len);
-    return true;
-}
-
-static inline bool is_space(char ch)
-{
-    return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r';
+    StringBuilder_t builder;
+    builder_use_buffer(&builder, buffer, capacity);
+    builder_serialize_doc(&builder, doc, spaces_per_indent);
+    if (needed)
+        *needed = builder.pos + 1;
+    return !builder.overflow;
 }
 
-static inline void ignore_whitespace(JsonParser_t* parser)
-{
-    while (!parser_eof(parser) && is_space(parser_peek(parser, 0))) {
-        parser_ignore(parser, 1);
-    }
-}
+/*
+ * Parsing
+ */
 
 static inline bool parse_hex(const char* str, size_t len, uint32_t* value)
 {
@@ -626,16 +1722,29 @@ static inline bool parse_unicode_symbol(JsonParser_t* parser, StringBuilder_t* b
     return false;
 }
 
+static bool parser_fail_alloc(JsonParser_t* parser)
+{
+    bool limited = jc_alloc_scope_limit_exceeded(jc_alloc_scope_current());
+    return parser_fail(parser, limited ? JC_PARSE_ALLOC_LIMIT : JC_PARSE_OUT_OF_MEMORY);
+}
+
 bool parse_and_unescape_str(JsonParser_t* parser, StringBuilder_t* builder)
 {
     if (!parser_consume_specific(parser, "\"", 1))
         return false;
 
+    JC_STATS_ONLY(size_t start_pos = builder->pos;)
+    size_t max_len = parser->limits.max_string_len;
     for (;;) {
+        // Never scan further than one byte past the length limit
+        size_t scan_end = parser->len;
+        if (max_len && scan_end - parser->pos > max_len - builder->pos)
+            scan_end = parser->pos + (max_len - builder->pos) + 1;
+
         size_t peek_index = parser->pos;
         char ch = 0;
         for (;;) {
-            if (peek_index == parser->len)
+            if (peek_index == scan_end)
                 break;
             ch = parser->text[peek_index];
             if (ch == '"' || ch == '\\')
@@ -649,6 +1758,11 @@ bool parse_and_unescape_str(JsonParser_t* parser, StringBuilder_t* builder)
                 return false;
             builder_append_ch(builder, ch);
         }
+        // A scoped builder that can't grow any further fails the parse
+        if (builder->overflow && !builder->external)
+            return parser_fail_alloc(parser);
+        if (max_len && builder->pos > max_len)
+            return parser_fail(parser, JC_PARSE_STRING_TOO_LONG);
         if (parser_eof(parser))
             break;
         if (ch == '"')
@@ -703,49 +1817,179 @@ bool parse_and_unescape_str(JsonParser_t* parser, StringBuilder_t* builder)
     if (!parser_consume_specific(parser, "\"", 1))
         return false;
 
+    JC_STATS_ADD(strings_unescaped, 1);
+    JC_STATS_ADD(bytes_unescaped, builder->pos - start_pos);
+    return true;
+}
+
+static inline JsonValue_t* parser_check_alloc(JsonParser_t* parser, JsonValue_t* value)
+{
+    if (!value)
+        parser_fail_alloc(parser);
+    return value;
+}
+
+bool parser_scan_string(JsonParser_t* parser, bool* has_escapes)
+{
+    size_t start = parser->pos;
+    if (!parser_skip_string(parser))
+        return false;
+    const char* text = &parser->text[start + 1];
+    size_t len = parser->pos - start - 2;
+    if (memchr(text, '\t', len) || memchr(text, '\n', len))
+        return false;
+
+    *has_escapes = memchr(text, '\\', len) != NULL;
+    for (size_t i = 0; *has_escapes && i < len; i++) {
+        if (text[i] != '\\')
+            continue;
+        char ch = text[++i];
+        if (ch == 'u') {
+            uint32_t code_point = 0;
+            if (i + 4 >= len || !parse_hex(&text[i + 1], 4, &code_point))
+                return false;
+            i += 4;
+        } else if (ch != '"' && ch != '\\' && ch != '/' && ch != 'b' && ch != 'f' && ch != 'n' && ch != 'r' && ch != 't') {
+            return false;
+        }
+    }
     return true;
 }
 
 static inline JsonValue_t* parse_string(JsonParser_t* parser)
 {
-    StringBuilder_t builder = { 0 };
-    if (!builder_resize(&builder, 64))
+    if (parser->limits.raw_strings) {
+        size_t start = parser->pos;
+        bool has_escapes;
+        if (!parser_scan_string(parser, &has_escapes)) {
+            parser->pos = start;
+            return NULL;
+        }
+        const char* text = &parser->text[start];
+        size_t len = parser->pos - start;
+        // Length limits apply to the decoded string, strings over it take the regular path
+        size_t max_len = parser->limits.max_string_len;
+        if (!max_len || len - 2 <= max_len) {
+            if (has_escapes)
+                return parser_check_alloc(parser, new_raw_string_value(text, len));
+            return parser_check_alloc(parser, new_string_value(text + 1, len - 2));
+        }
+        parser->pos = start;
+    }
+
+    StringBuilder_t builder = { .scoped = true };
+    if (!builder_resize(&builder, 64)) {
+        parser_fail_alloc(parser);
         return NULL;
+    }
     if (!parse_and_unescape_str(parser, &builder)) {
-        free(builder.buffer);
+        builder_free(&builder);
+        return NULL;
+    }
+    JsonValue_t* value = parser_check_alloc(parser, new_string_value(builder.buffer, builder.pos));
+    builder_free(&builder);
+    return value;
+}
+
+static inline JsonValue_t* parse_true(JsonParser_t* parser)
+{
+    if (!parser_consume_specific(parser, "true", 4))
+        return NULL;
+    return parser_check_alloc(parser, jc_new_bool_value(true));
+}
+
+static inline JsonValue_t* parse_false(JsonParser_t* parser)
+{
+    if (!parser_consume_specific(parser, "false", 5))
         return NULL;
+    return parser_check_alloc(parser, jc_new_bool_value(false));
+}
+
+static inline JsonValue_t* parse_null(JsonParser_t* parser)
+{
+    if (!parser_consume_specific(parser, "null", 4))
+        return NULL;
+    return parser_check_alloc(parser, jc_new_value(JC_NULL_LITERAL, NULL));
+}
+
+bool parser_skip_string(JsonParser_t* parser)
+{
+    if (parser_peek(parser, 0) != '"')
+        return false;
+    const char* text = parser->text;
+    size_t first = parser->pos + 1;
+    for (size_t pos = first; pos < parser->len;) {
+        const char* quote = (const char*)memchr(&text[pos], '"', parser->len - pos);
+        if (!quote)
+            return false;
+        // A quote is escaped by an odd number of backslashes before it
+        size_t end = (size_t)(quote - text);
+        size_t backslashes = 0;
+        while (end - backslashes > first && text[end - backslashes - 1] == '\\')
+            backslashes++;
+        if (backslashes % 2 == 0) {
+            parser->pos = end + 1;
+            return true;
+        }
+        pos = end + 1;
     }
-    JsonValue_t* value = jc_new_value(JC_STRING, builder.buffer);
-    free(builder.buffer);
-    return value;
+    return false;
 }
 
-static inline JsonValue_t* parse_true(JsonParser_t* parser)
+static inline bool is_delimiter(char ch)
 {
-    if (!parser_consume_specific(parser, "true", 4))
-        return NULL;
-    return jc_new_bool_value(true);
+    return is_space(ch) || ch == ',' || ch == ':' || ch == '"' || ch == '[' || ch == ']' || ch == '{' || ch == '}';
 }
 
-static inline JsonValue_t* parse_false(JsonParser_t* parser)
+bool parser_skip_value(JsonParser_t* parser)
 {
-    if (!parser_consume_specific(parser, "false", 5))
-        return NULL;
-    return jc_new_bool_value(false);
+    // Containers are skipped by counting brackets instead of recursing
+    size_t depth = 0;
+    do {
+        ignore_whitespace(parser);
+        if (parser_eof(parser))
+            return false;
+        char ch = parser->text[parser->pos];
+        switch (ch) {
+        case '"':
+            if (!parser_skip_string(parser))
+                return false;
+            break;
+        case '{':
+        case '[':
+            depth++;
+            parser->pos++;
+            break;
+        case '}':
+        case ']':
+        case ',':
+        case ':':
+            if (depth == 0)
+                return false;
+            if (ch == '}' || ch == ']')
+                depth--;
+            parser->pos++;
+            break;
+        default: {
+            size_t start = parser->pos;
+            while (!parser_eof(parser) && !is_delimiter(parser->text[parser->pos]))
+                parser->pos++;
+            if (parser->pos == start)
+                return false;
+        }
+        }
+    } while (depth > 0);
+    return true;
 }
 
-static inline JsonValue_t* parse_null(JsonParser_t* parser)
+static inline void parser_skip_digits(JsonParser_t* parser)
 {
-    if (!parser_consume_specific(parser, "null", 4))
-        return NULL;
-    return jc_new_value(JC_NULL_LITERAL, NULL);
+    while (!parser_eof(parser) && is_digit(parser->text[parser->pos]))
+        parser->pos++;
 }
 
-JsonValue_t* parse_number(JsonParser_t* parser)
+bool parser_scan_number(JsonParser_t* parser, bool* is_double)
 {
-    StringBuilder_t builder = { 0 };
-    builder_resize(&builder, 12);
-
     /*
         https://www.rfc-editor.org/rfc/rfc4627
         number = [ minus ] int [ frac ] [ exp ]
@@ -759,22 +2003,21 @@ JsonValue_t* parse_number(JsonParser_t* parser)
         digit1-9 = %x31-39         ; 1-9
         e = %x65 | %x45            ; e E
     */
+    size_t start = parser->pos;
 
     // [ minus ]
-    char ch = parser_peek(parser, 0);
-    if (ch == '-')
-        builder_append_ch(&builder, parser_consume(parser));
+    if (parser_peek(parser, 0) == '-')
+        parser_ignore(parser, 1);
 
     // int
-    ch = parser_peek(parser, 0);
+    char ch = parser_peek(parser, 0);
     if (ch == '0') {
-        builder_append_ch(&builder, parser_consume(parser));
+        parser_ignore(parser, 1);
     } else if (ch >= '1' && ch <= '9') {
-        builder_append_ch(&builder, parser_consume(parser));
-        while (isdigit(parser_peek(parser, 0)))
-            builder_append_ch(&builder, parser_consume(parser));
+        parser_ignore(parser, 1);
+        parser_skip_digits(parser);
     } else {
-        goto EXIT_ERROR;
+        return false;
     }
 
     bool parse_as_double = false;
@@ -783,71 +2026,116 @@ JsonValue_t* parse_number(JsonParser_t* parser)
     if (ch == '.') {
         // [ frac ]
         parse_as_double = true;
-        builder_append_ch(&builder, parser_consume(parser));
-        ch = parser_peek(parser, 0);
-        if (!isdigit(ch))
-            goto EXIT_ERROR;
-        builder_append_ch(&builder, parser_consume(parser));
-        while (isdigit(parser_peek(parser, 0)))
-            builder_append_ch(&builder, parser_consume(parser));
+        parser_ignore(parser, 1);
+        if (!is_digit(parser_peek(parser, 0)))
+            return false;
+        parser_skip_digits(parser);
         ch = parser_peek(parser, 0);
     }
 
     if (ch == 'e' || ch == 'E') {
         // [ exp ]
         parse_as_double = true;
-        builder_append_ch(&builder, parser_consume(parser));
+        parser_ignore(parser, 1);
         ch = parser_peek(parser, 0);
         if (ch == '+' || ch == '-') {
-            builder_append_ch(&builder, parser_consume(parser));
+            parser_ignore(parser, 1);
             ch = parser_peek(parser, 0);
-            if (ch < '0' || ch > '9')
-                goto EXIT_ERROR;
-        } else if (ch >= '0' && ch <= '9') {
-            builder_append_ch(&builder, parser_consume(parser));
-        } else {
-            goto EXIT_ERROR;
         }
-        while (isdigit(parser_peek(parser, 0)))
-            builder_append_ch(&builder, parser_consume(parser));
+        if (!is_digit(ch))
+            return false;
+        parser_skip_digits(parser);
     }
 
-    JsonValue_t* result = NULL;
-    if (parse_as_double) {
-        char* end_ptr = NULL;
-        double value = strtod(builder.buffer, &end_ptr);
-        if (end_ptr != builder.buffer + builder.pos)
-            goto EXIT_ERROR;
-        result = jc_new_double_value(value);
+    *is_double = parse_as_double;
+    return parser->pos > start;
+}
+
+bool convert_number(const char* text, size_t len, bool is_double, JsonNumberToken_t* token, bool* out_of_range)
+{
+    // The conversion needs a NUL terminated copy, which almost always fits on the stack
+    char stack_buffer[64];
+    char* buffer = len < sizeof(stack_buffer) ? stack_buffer : (char*)jc_mem_alloc(len + 1);
+    if (!buffer)
+        return false;
+    memcpy(buffer, text, len);
+    buffer[len] = '\0';
+
+    token->is_double = is_double;
+    if (is_double) {
+        token->num_double = strtod(buffer, NULL);
     } else {
-        char* end_ptr = NULL;
-        int64_t value = strtoll(builder.buffer, &end_ptr, 10);
-        if (end_ptr != builder.buffer + builder.pos)
-            goto EXIT_ERROR;
-        result = jc_new_int64_value(value);
+        errno = 0;
+        token->num_int64 = strtoll(buffer, NULL, 10);
+        if (out_of_range && (*out_of_range = errno == ERANGE)) {
+            token->is_double = true;
+            token->num_double = strtod(buffer, NULL);
+        }
     }
-    free(builder.buffer);
-    return result;
-EXIT_ERROR:
-    free(builder.buffer);
-    return NULL;
+    if (buffer != stack_buffer)
+        jc_mem_free(buffer);
+    if (token->is_double)
+        JC_STATS_ADD(numbers_double, 1);
+    else
+        JC_STATS_ADD(numbers_int64, 1);
+    return true;
+}
+
+bool parse_number_token(JsonParser_t* parser, JsonNumberToken_t* token)
+{
+    size_t start = parser->pos;
+    bool is_double;
+    if (!parser_scan_number(parser, &is_double))
+        return false;
+    if (!convert_number(&parser->text[start], parser->pos - start, is_double, token, NULL))
+        return parser_fail_alloc(parser);
+    return true;
+}
+
+static inline JsonValue_t* parse_number(JsonParser_t* parser)
+{
+    if (parser->limits.raw_numbers) {
+        size_t start = parser->pos;
+        bool is_double;
+        if (!parser_scan_number(parser, &is_double))
+            return NULL;
+        return parser_check_alloc(parser, new_raw_number_value(&parser->text[start], parser->pos - start, is_double));
+    }
+    JsonNumberToken_t token;
+    if (!parse_number_token(parser, &token))
+        return NULL;
+    if (token.is_double)
+        return parser_check_alloc(parser, jc_new_double_value(token.num_double));
+    return parser_check_alloc(parser, jc_new_int64_value(token.num_int64));
 }
 
 JsonValue_t* parse_value(JsonParser_t* parser)
 {
     ignore_whitespace(parser);
+    if (parser->limits.max_nodes && ++parser->nodes > parser->limits.max_nodes) {
+        parser_fail(parser, JC_PARSE_TOO_MANY_NODES);
+        return NULL;
+    }
     char type_hint = parser_peek(parser, 0);
     switch (type_hint) {
-    case '{':
+    case '{': {
         JsonObject_t* obj = parse_obj(parser);
-        if (obj)
-            return jc_new_value(JC_OBJECT, obj);
-        break;
-    case '[':
+        if (!obj)
+            break;
+        JsonValue_t* value = parser_check_alloc(parser, jc_new_value(JC_OBJECT, obj));
+        if (!value)
+            jc_free_obj(obj);
+        return value;
+    }
+    case '[': {
         JsonArray_t* arr = parse_arr(parser);
-        if (arr)
-            return jc_new_value(JC_ARRAY, arr);
-        break;
+        if (!arr)
+            break;
+        JsonValue_t* value = parser_check_alloc(parser, jc_new_value(JC_ARRAY, arr));
+        if (!value)
+            jc_free_arr(arr);
+        return value;
+    }
     case '"':
         return parse_string(parser);
     case '-':
@@ -872,11 +2160,87 @@ JsonValue_t* parse_value(JsonParser_t* parser)
     return NULL;
 }
 
+// Runs inside the document's scope, so the hints count against its allocation limit
+static bool parser_collect_size_hints(JsonParser_t* parser)
+{
+    size_t capacity = 0;
+    size_t* open = NULL;
+    size_t open_count = 0;
+    size_t open_capacity = 0;
+    const char* text = parser->text;
+    for (size_t pos = parser->pos; pos < parser->len; pos++) {
+        char ch = text[pos];
+        if (ch == '"') {
+            while (++pos < parser->len && text[pos] != '"') {
+                if (text[pos] == '\\')
+                    pos++;
+            }
+        } else if (ch == '{' || ch == '[') {
+            if (parser->size_hint_count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                uint32_t* hints = (uint32_t*)jc_mem_realloc(parser->size_hints, capacity * sizeof(uint32_t));
+                if (!hints)
+                    goto EXIT_ERROR;
+                parser->size_hints = hints;
+            }
+            if (open_count == open_capacity) {
+                open_capacity = open_capacity ? open_capacity * 2 : 16;
+                size_t* new_open = (size_t*)jc_mem_realloc(open, open_capacity * sizeof(size_t));
+                if (!new_open)
+                    goto EXIT_ERROR;
+                open = new_open;
+            }
+            size_t next = pos + 1;
+            while (next < parser->len && is_space(text[next]))
+                next++;
+            bool empty = next < parser->len && (text[next] == '}' || text[next] == ']');
+            parser->size_hints[parser->size_hint_count] = empty ? 0 : 1;
+            open[open_count++] = parser->size_hint_count++;
+        } else if (ch == ',' && open_count) {
+            uint32_t* hint = &parser->size_hints[open[open_count - 1]];
+            if (*hint != UINT32_MAX)
+                (*hint)++;
+        } else if ((ch == '}' || ch == ']') && open_count) {
+            open_count--;
+        }
+    }
+    jc_mem_free(open);
+    return true;
+
+EXIT_ERROR:
+    jc_mem_free(open);
+    return parser_fail_alloc(parser);
+}
+
+// Member count of the next container, false without hints
+static inline bool parser_next_size_hint(JsonParser_t* parser, size_t* count)
+{
+    if (parser->size_hint_next >= parser->size_hint_count)
+        return false;
+    *count = parser->size_hints[parser->size_hint_next++];
+    return true;
+}
+
+static bool parser_enter_container(JsonParser_t* parser)
+{
+    if (parser->limits.max_depth && parser->depth >= parser->limits.max_depth)
+        return parser_fail(parser, JC_PARSE_TOO_DEEP);
+    parser->depth++;
+    return true;
+}
+
 JsonObject_t* parse_obj(JsonParser_t* parser)
 {
-    JsonObject_t* obj = jc_new_obj();
-    StringBuilder_t builder = { 0 };
-    builder_resize(&builder, 64);
+    if (!parser_enter_container(parser))
+        return NULL;
+    size_t count;
+    JsonObject_t* obj = parser_next_size_hint(parser, &count) ? jc_new_obj_with_capacity(count) : jc_new_obj();
+    StringBuilder_t builder = { .scoped = true };
+    size_t members = 0;
+    if (!obj || !builder_resize(&builder, 64)) {
+        parser_fail_alloc(parser);
+        goto EXIT_ERROR;
+    }
 
     if (!parser_consume_specific(parser, "{", 1))
         goto EXIT_ERROR;
@@ -887,6 +2251,10 @@ JsonObject_t* parse_obj(JsonParser_t* parser)
             break;
         ignore_whitespace(parser);
 
+        if (parser->limits.max_object_keys && ++members > parser->limits.max_object_keys) {
+            parser_fail(parser, JC_PARSE_TOO_MANY_KEYS);
+            goto EXIT_ERROR;
+        }
         if (!parse_and_unescape_str(parser, &builder))
             goto EXIT_ERROR;
         ignore_whitespace(parser);
@@ -899,7 +2267,11 @@ JsonObject_t* parse_obj(JsonParser_t* parser)
         if (!value)
             goto EXIT_ERROR;
 
-        jc_obj_set(obj, builder.buffer, value);
+        if (!olh_map_set_len(&obj->olh_map, builder.buffer, builder.pos, value)) {
+            parser_fail_alloc(parser);
+            jc_free_value(value);
+            goto EXIT_ERROR;
+        }
         builder_reset(&builder);
         ignore_whitespace(parser);
         if (parser_peek(parser, 0) == '}')
@@ -917,20 +2289,27 @@ JsonObject_t* parse_obj(JsonParser_t* parser)
     if (!parser_consume_specific(parser, "}", 1))
         goto EXIT_ERROR;
 
-    free(builder.buffer);
+    parser->depth--;
+    builder_free(&builder);
     return obj;
 
 EXIT_ERROR:
-    free(builder.buffer);
+    parser->depth--;
+    builder_free(&builder);
     jc_free_obj(obj);
     return NULL;
 }
 
 JsonArray_t* parse_arr(JsonParser_t* parser)
 {
-    JsonArray_t* arr = jc_new_arr();
-    StringBuilder_t builder = { 0 };
-    builder_resize(&builder, 64);
+    if (!parser_enter_container(parser))
+        return NULL;
+    size_t count;
+    JsonArray_t* arr = parser_next_size_hint(parser, &count) ? jc_new_arr_with_capacity(count) : jc_new_arr();
+    if (!arr) {
+        parser_fail_alloc(parser);
+        goto EXIT_ERROR;
+    }
 
     if (!parser_consume_specific(parser, "[", 1))
         goto EXIT_ERROR;
@@ -943,8 +2322,11 @@ JsonArray_t* parse_arr(JsonParser_t* parser)
         JsonValue_t* value = parse_value(parser);
         if (!value)
             goto EXIT_ERROR;
-        jc_arr_insert_value(arr, value);
-        builder_reset(&builder);
+        if (!jc_arr_insert_value(arr, value)) {
+            parser_fail_alloc(parser);
+            jc_free_value(value);
+            goto EXIT_ERROR;
+        }
         ignore_whitespace(parser);
 
         if (parser_peek(parser, 0) == ']')
@@ -963,18 +2345,30 @@ JsonArray_t* parse_arr(JsonParser_t* parser)
     if (!parser_consume_specific(parser, "]", 1))
         goto EXIT_ERROR;
 
-    free(builder.buffer);
+    parser->depth--;
     return arr;
 
 EXIT_ERROR:
-    free(builder.buffer);
+    parser->depth--;
     jc_free_arr(arr);
     return NULL;
 }
 
 JsonDocument_t* parse_doc(JsonParser_t* parser)
 {
-    JsonDocument_t* doc = jc_new_doc();
+    JsonDocument_t* doc = jc_new_doc_with_allocator(parser->limits.allocator);
+    if (!doc) {
+        parser_fail(parser, JC_PARSE_OUT_OF_MEMORY);
+        return NULL;
+    }
+    // All nodes are allocated with the document's allocator
+    JsonAllocScope_t* scope = jc_alloc_scope_of(doc);
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(scope);
+    jc_alloc_scope_set_limit(scope, parser->limits.max_alloc_bytes);
+    // The root container is parsed directly but counts as a node as well
+    parser->nodes++;
+    if (parser->limits.presize_containers && !parser_collect_size_hints(parser))
+        goto EXIT_ERROR;
 
     ignore_whitespace(parser);
     char type_hint = parser_peek(parser, 0);
@@ -983,36 +2377,376 @@ JsonDocument_t* parse_doc(JsonParser_t* parser)
         JsonObject_t* obj = parse_obj(parser);
         if (obj) {
             jc_doc_set_obj(doc, obj);
-            return doc;
+            goto EXIT;
         }
         break;
     case '[':
         JsonArray_t* arr = parse_arr(parser);
         if (arr) {
             jc_doc_set_arr(doc, arr);
-            return doc;
+            goto EXIT;
         }
         break;
     }
     }
 
+EXIT_ERROR:
     jc_free_doc(doc);
-    return NULL;
+    doc = NULL;
+EXIT:
+    jc_mem_free(parser->size_hints);
+    parser->size_hints = NULL;
+    if (doc)
+        jc_alloc_scope_set_limit(scope, 0);
+    jc_alloc_scope_enter(previous_scope);
+    return doc;
 }
 
-JsonDocument_t* jc_doc_from_string(const char* str)
+JsonDocument_t* jc_doc_from_string_with_options(const char* str, const JsonParseOptions_t* options, JsonParseError_t* error)
 {
-    if (!str)
-        return NULL;
-    JsonParser_t parser = { .text = str, .pos = 0, .len = strlen(str) };
-    JsonDocument_t* doc = parse_doc(&parser);
+    JsonParser_t parser = { .text = str };
+    if (options)
+        parser.limits = *options;
+    JsonDocument_t* doc = NULL;
+    if (!str) {
+        parser_fail(&parser, JC_PARSE_SYNTAX_ERROR);
+        goto EXIT;
+    }
+
+    // Don't even measure inputs above the limit
+    size_t max_input = parser.limits.max_input_bytes;
+    parser.len = max_input ? strnlen(str, max_input + 1) : strlen(str);
+    if (max_input && parser.len > max_input) {
+        parser.pos = max_input;
+        parser_fail(&parser, JC_PARSE_INPUT_TOO_LARGE);
+        goto EXIT;
+    }
+
+    doc = parse_doc(&parser);
     if (!doc)
-        return NULL;
+        goto EXIT;
     // Check if all input was consumed
     ignore_whitespace(&parser);
     if (!parser_eof(&parser)) {
         jc_free_doc(doc);
+        doc = NULL;
+    }
+
+    JC_STATS_ADD(bytes_scanned, parser.pos);
+EXIT:
+    if (!doc)
+        parser_fail(&parser, JC_PARSE_SYNTAX_ERROR);
+    if (error)
+        *error = parser.error;
+    return doc;
+}
+
+JsonDocument_t* jc_doc_from_string_with_allocator(const char* str, const JsonAllocator_t* allocator)
+{
+    JsonParseOptions_t options = { .allocator = allocator };
+    return jc_doc_from_string_with_options(str, &options, NULL);
+}
+
+JsonDocument_t* jc_doc_from_string(const char* str)
+{
+    return jc_doc_from_string_with_options(str, NULL, NULL);
+}
+
+/*
+ *   Projection
+ */
+
+typedef struct {
+    // Unescaped segment, "*" matches every member and element
+    const char* str;
+    size_t len;
+    bool wildcard;
+    bool is_index;
+    size_t index;
+} ProjectSegment_t;
+
+typedef struct {
+    ProjectSegment_t* segments;
+    size_t depth;
+    char* buffer;
+} ProjectPath_t;
+
+typedef struct {
+    JsonParser_t parser;
+    ProjectPath_t paths[JC_PROJECT_MAX_PATHS];
+    size_t path_count;
+} Projection_t;
+
+// Splits a JSON Pointer into unescaped segments (~0 is '~', ~1 is '/')
+static bool project_compile_path(ProjectPath_t* path, const char* pointer)
+{
+    size_t len = strlen(pointer);
+    if (len && pointer[0] != '/')
+        return false;
+    for (size_t i = 0; i < len; i++)
+        path->depth += pointer[i] == '/';
+
+    path->buffer = (char*)jc_mem_alloc(len + 1);
+    path->segments = (ProjectSegment_t*)jc_mem_calloc((path->depth ? path->depth : 1) * sizeof(ProjectSegment_t));
+    if (!path->buffer || !path->segments)
+        return false;
+
+    char* out = path->buffer;
+    ProjectSegment_t* segment = path->segments - 1;
+    for (size_t i = 0; i < len; i++) {
+        char ch = pointer[i];
+        if (ch == '/') {
+            segment++;
+            segment->str = out;
+            continue;
+        }
+        if (ch == '~') {
+            if (i + 1 == len || (pointer[i + 1] != '0' && pointer[i + 1] != '1'))
+                return false;
+            ch = pointer[++i] == '0' ? '~' : '/';
+        }
+        *out++ = ch;
+        segment->len++;
+    }
+
+    for (size_t i = 0; i < path->depth; i++) {
+        segment = &path->segments[i];
+        segment->wildcard = segment->len == 1 && segment->str[0] == '*';
+        segment->is_index = segment->len > 0 && (segment->len == 1 || segment->str[0] != '0');
+        for (size_t j = 0; segment->is_index && j < segment->len; j++) {
+            segment->is_index = is_digit(segment->str[j]) && segment->index <= (SIZE_MAX - 9) / 10;
+            segment->index = segment->index * 10 + (size_t)(segment->str[j] - '0');
+        }
+    }
+    return true;
+}
+
+// Paths of active which continue with the member key (or element index when key is NULL)
+static uint64_t project_match(const Projection_t* proj, uint64_t active, size_t depth, const char* key, size_t len, size_t index)
+{
+    uint64_t next = 0;
+    for (size_t i = 0; i < proj->path_count; i++) {
+        if (!(active & ((uint64_t)1 << i)))
+            continue;
+        const ProjectSegment_t* segment = &proj->paths[i].segments[depth];
+        bool matches = segment->wildcard
+            || (key ? segment->len == len && memcmp(segment->str, key, len) == 0 : segment->is_index && segment->index == index);
+        if (matches)
+            next |= (uint64_t)1 << i;
+    }
+    return next;
+}
+
+// True if one of the paths ends at depth, the whole value is taken then
+static bool project_complete(const Projection_t* proj, uint64_t active, size_t depth)
+{
+    for (size_t i = 0; i < proj->path_count; i++)
+        if ((active & ((uint64_t)1 << i)) && proj->paths[i].depth == depth)
+            return true;
+    return false;
+}
+
+static JsonObject_t* project_obj(Projection_t* proj, uint64_t active, size_t depth);
+static JsonArray_t* project_arr(Projection_t* proj, uint64_t active, size_t depth);
+
+// Stores NULL into value for skipped values and containers without any match
+static bool project_value(Projection_t* proj, uint64_t active, size_t depth, JsonValue_t** value)
+{
+    JsonParser_t* parser = &proj->parser;
+    *value = NULL;
+    if (!active)
+        return parser_skip_value(parser);
+    if (project_complete(proj, active, depth))
+        return (*value = parse_value(parser)) != NULL;
+
+    char type_hint = parser_peek(parser, 0);
+    if (type_hint == '{') {
+        JsonObject_t* obj = project_obj(proj, active, depth);
+        if (!obj)
+            return false;
+        if (jc_obj_size(obj) == 0) {
+            jc_free_obj(obj);
+            return true;
+        }
+        if (!(*value = parser_check_alloc(parser, jc_new_value(JC_OBJECT, obj))))
+            jc_free_obj(obj);
+    } else if (type_hint == '[') {
+        JsonArray_t* arr = project_arr(proj, active, depth);
+        if (!arr)
+            return false;
+        if (jc_arr_size(arr) == 0) {
+            jc_free_arr(arr);
+            return true;
+        }
+        if (!(*value = parser_check_alloc(parser, jc_new_value(JC_ARRAY, arr))))
+            jc_free_arr(arr);
+    } else {
+        return parser_skip_value(parser);
+    }
+    return *value != NULL;
+}
+
+static JsonObject_t* project_obj(Projection_t* proj, uint64_t active, size_t depth)
+{
+    JsonParser_t* parser = &proj->parser;
+    JsonObject_t* obj = jc_new_obj();
+    StringBuilder_t key = { .scoped = true };
+    if (!obj || !builder_resize(&key, 64)) {
+        parser_fail_alloc(parser);
+        goto EXIT_ERROR;
+    }
+    if (!parser_consume_specific(parser, "{", 1))
+        goto EXIT_ERROR;
+
+    ignore_whitespace(parser);
+    if (parser_consume_specific(parser, "}", 1))
+        goto EXIT;
+    for (;;) {
+        ignore_whitespace(parser);
+        builder_reset(&key);
+        if (!parse_and_unescape_str(parser, &key))
+            goto EXIT_ERROR;
+        ignore_whitespace(parser);
+        if (!parser_consume_specific(parser, ":", 1))
+            goto EXIT_ERROR;
+        ignore_whitespace(parser);
+
+        JsonValue_t* value;
+        uint64_t next = project_match(proj, active, depth, key.buffer, key.pos, 0);
+        if (!project_value(proj, next, depth + 1, &value))
+            goto EXIT_ERROR;
+        if (value && !olh_map_set_len(&obj->olh_map, key.buffer, key.pos, value)) {
+            parser_fail_alloc(parser);
+            jc_free_value(value);
+            goto EXIT_ERROR;
+        }
+
+        ignore_whitespace(parser);
+        if (parser_consume_specific(parser, "}", 1))
+            goto EXIT;
+        if (!parser_consume_specific(parser, ",", 1))
+            goto EXIT_ERROR;
+    }
+
+EXIT:
+    builder_free(&key);
+    return obj;
+
+EXIT_ERROR:
+    builder_free(&key);
+    jc_free_obj(obj);
+    return NULL;
+}
+
+static JsonArray_t* project_arr(Projection_t* proj, uint64_t active, size_t depth)
+{
+    JsonParser_t* parser = &proj->parser;
+    JsonArray_t* arr = jc_new_arr();
+    if (!arr) {
+        parser_fail_alloc(parser);
+        return NULL;
+    }
+    if (!parser_consume_specific(parser, "[", 1))
+        goto EXIT_ERROR;
+
+    ignore_whitespace(parser);
+    if (parser_consume_specific(parser, "]", 1))
+        return arr;
+    for (size_t index = 0;; index++) {
+        ignore_whitespace(parser);
+        JsonValue_t* value;
+        uint64_t next = project_match(proj, active, depth, NULL, 0, index);
+        if (!project_value(proj, next, depth + 1, &value))
+            goto EXIT_ERROR;
+        if (value && !jc_arr_insert_value(arr, value)) {
+            parser_fail_alloc(parser);
+            jc_free_value(value);
+            goto EXIT_ERROR;
+        }
+
+        ignore_whitespace(parser);
+        if (parser_consume_specific(parser, "]", 1))
+            return arr;
+        if (!parser_consume_specific(parser, ",", 1))
+            goto EXIT_ERROR;
+    }
+
+EXIT_ERROR:
+    jc_free_arr(arr);
+    return NULL;
+}
+
+JsonDocument_t* jc_doc_from_buffer_project(const char* buf, size_t len, const char* const* paths, size_t path_count)
+{
+    if (!buf || (!paths && path_count) || path_count > JC_PROJECT_MAX_PATHS)
         return NULL;
+
+    Projection_t proj = { .parser = { .text = buf, .len = len }, .path_count = path_count };
+    JsonDocument_t* doc = NULL;
+    uint64_t active = 0;
+    for (size_t i = 0; i < path_count; i++) {
+        if (!paths[i] || !project_compile_path(&proj.paths[i], paths[i]))
+            goto EXIT;
+        active |= (uint64_t)1 << i;
+    }
+    doc = jc_new_doc();
+    if (!doc)
+        goto EXIT;
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(jc_alloc_scope_of(doc));
+    JsonParser_t* parser = &proj.parser;
+    ignore_whitespace(parser);
+    // An empty pointer selects the whole document
+    bool whole = project_complete(&proj, active, 0);
+    bool success = false;
+    if (parser_peek(parser, 0) == '{') {
+        JsonObject_t* obj = whole ? parse_obj(parser) : project_obj(&proj, active, 0);
+        success = obj && jc_doc_set_obj(doc, obj);
+    } else if (parser_peek(parser, 0) == '[') {
+        JsonArray_t* arr = whole ? parse_arr(parser) : project_arr(&proj, active, 0);
+        success = arr && jc_doc_set_arr(doc, arr);
+    }
+    jc_alloc_scope_enter(previous_scope);
+
+    ignore_whitespace(parser);
+    if (!success || !parser_eof(parser)) {
+        jc_free_doc(doc);
+        doc = NULL;
+    }
+    JC_STATS_ADD(bytes_scanned, parser->pos);
+
+EXIT:
+    for (size_t i = 0; i < path_count; i++) {
+        jc_mem_free(proj.paths[i].segments);
+        jc_mem_free(proj.paths[i].buffer);
     }
     return doc;
 }
+
+const char* jc_parse_error_string(JsonParseErrorCode_t code)
+{
+    switch (code) {
+    case JC_PARSE_OK:
+        return "no error";
+    case JC_PARSE_SYNTAX_ERROR:
+        return "syntax error";
+    case JC_PARSE_OUT_OF_MEMORY:
+        return "out of memory";
+    case JC_PARSE_INPUT_TOO_LARGE:
+        return "input too large";
+    case JC_PARSE_TOO_DEEP:
+        return "nesting too deep";
+    case JC_PARSE_TOO_MANY_NODES:
+        return "too many values";
+    case JC_PARSE_STRING_TOO_LONG:
+        return "string too long";
+    case JC_PARSE_TOO_MANY_KEYS:
+        return "too many object keys";
+    case JC_PARSE_ALLOC_LIMIT:
+        return "allocation limit exceeded";
+    case JC_PARSE_TYPE_MISMATCH:
+        return "unexpected value type";
+    case JC_PARSE_UNSUPPORTED_QUERY:
+        return "query can't be streamed";
+    }
+    return "unknown error";
+}
@@ -7,6 +7,8 @@
 typedef struct JsonArray_t JsonArray_t;
 typedef struct JsonObject_t JsonObject_t;
 typedef struct JsonDocument_t JsonDocument_t;
+typedef struct JsonTape_t JsonTape_t;
+typedef struct JsonQuery_t JsonQuery_t;
 
 typedef enum {
     JC_STRING,
@@ -16,8 +18,14 @@ typedef enum {
     JC_ARRAY,
     JC_BOOLEAN,
     JC_NULL_LITERAL,
+    // Number kept as its source text, see JsonParseOptions_t.raw_numbers
+    JC_NUMBER_RAW,
+    // String with escape sequences kept as its source text, see JsonParseOptions_t.raw_strings
+    JC_STRING_RAW,
 } JsonValueType_t;
 
+#define JC_STRING_LEN_UNKNOWN 0x7fffffffu
+
 typedef struct {
     union {
         char* string;
@@ -26,21 +34,220 @@ typedef struct {
         bool boolean;
         JsonObject_t* object;
         JsonArray_t* array;
+        struct JsonRawNumber_t* raw_number;
+        struct JsonRawString_t* raw_string;
     };
     JsonValueType_t ty;
+    // Cached for strings: byte length (JC_STRING_LEN_UNKNOWN for very long strings) and whether
+    // the string can be serialized without escaping. Replace strings through jc_value_set_string.
+    uint32_t string_len : 31;
+    uint32_t string_clean : 1;
 } JsonValue_t;
 
 typedef struct {
     void* opaque;
 } JsonObjectIter_t;
 
+// Object key with its length and hash computed up front, for keys looked up over and over
+typedef struct {
+    const char* str;
+    size_t len;
+    uint32_t hash;
+} JsonKey_t;
+
+typedef struct {
+    const JsonTape_t* tape;
+    size_t index;
+} JsonTapeCursor_t;
+
+typedef struct {
+    void* (*alloc_func)(void* ctx, size_t size);
+    void* (*realloc_func)(void* ctx, void* ptr, size_t size);
+    void (*free_func)(void* ctx, void* ptr);
+    void* ctx;
+} JsonAllocator_t;
+
+// Byte counts cover the requested sizes, not the allocator's bookkeeping
+typedef struct {
+    size_t alloc_count;
+    size_t live_allocations;
+    size_t live_bytes;
+    size_t peak_bytes;
+} JsonAllocStats_t;
+
+typedef enum {
+    JC_PARSE_OK,
+    JC_PARSE_SYNTAX_ERROR,
+    JC_PARSE_OUT_OF_MEMORY,
+    JC_PARSE_INPUT_TOO_LARGE,
+    JC_PARSE_TOO_DEEP,
+    JC_PARSE_TOO_MANY_NODES,
+    JC_PARSE_STRING_TOO_LONG,
+    JC_PARSE_TOO_MANY_KEYS,
+    JC_PARSE_ALLOC_LIMIT,
+    JC_PARSE_TYPE_MISMATCH,
+    JC_PARSE_UNSUPPORTED_QUERY,
+} JsonParseErrorCode_t;
+
+typedef struct {
+    JsonParseErrorCode_t code;
+    // Byte offset into the input at which parsing stopped
+    size_t offset;
+} JsonParseError_t;
+
+// Bytes held by a tree, by category. Every category except allocator_overhead counts requested sizes.
+typedef struct {
+    // JsonValue_t cells
+    size_t value_bytes;
+    // JsonDocument_t, JsonObject_t and JsonArray_t headers
+    size_t container_bytes;
+    // Bucket tables split into occupied, empty and tombstone slots
+    size_t bucket_bytes;
+    size_t bucket_empty_bytes;
+    size_t bucket_tombstone_bytes;
+    // Array pointer storage split into used and unused slots
+    size_t array_bytes;
+    size_t array_slack_bytes;
+    // Key, string and raw number copies including their NUL terminators
+    size_t key_bytes;
+    size_t string_bytes;
+    // Estimated allocation headers and malloc rounding
+    size_t allocator_overhead;
+    size_t allocations;
+    size_t total_bytes;
+} JsonMemoryUsage_t;
+
+// Probe length histograms use power of two buckets: 1, 2-3, 4-7, ..., 64-127 and 128 or more probes
+#define JC_STATS_PROBE_BUCKETS 8
+
+// Hot path counters, only maintained in builds with JC_STATS defined
+typedef struct {
+    uint64_t bytes_scanned;
+    uint64_t strings_unescaped;
+    uint64_t bytes_unescaped;
+    uint64_t numbers_int64;
+    uint64_t numbers_double;
+    uint64_t objects_created;
+    uint64_t arrays_created;
+    uint64_t map_rehashes;
+    uint64_t map_rehash_bytes;
+    uint64_t map_read_probes[JC_STATS_PROBE_BUCKETS];
+    uint64_t map_write_probes[JC_STATS_PROBE_BUCKETS];
+    uint64_t builder_grows;
+    uint64_t builder_grow_bytes;
+} JsonStats_t;
+
+// Limits for parsing untrusted input, checked while parsing. 0 means unlimited.
+typedef struct {
+    size_t max_input_bytes;
+    size_t max_depth;
+    size_t max_nodes;
+    size_t max_string_len;
+    size_t max_object_keys;
+    size_t max_alloc_bytes;
+    // NULL for the global allocator
+    const JsonAllocator_t* allocator;
+    // Counts the members of all containers in a pre-pass over the input to allocate them at their final size
+    bool presize_containers;
+    // Stores numbers as JC_NUMBER_RAW: the source text is copied, converted on first access and serialized
+    // unchanged. Keeps integers beyond int64 and decimals exact.
+    bool raw_numbers;
+    // Strings without escape sequences are copied as they are, strings with escapes are stored as
+    // JC_STRING_RAW: their source text is serialized unchanged and decoded on the first read through
+    // jc_value_get_string or jc_obj_get_string, their string member is not set.
+    bool raw_strings;
+} JsonParseOptions_t;
+
 JsonDocument_t* jc_new_doc();
 JsonObject_t* jc_new_obj();
 JsonArray_t* jc_new_arr();
+// Containers which take count members without growing
+JsonObject_t* jc_new_obj_with_capacity(size_t count);
+JsonArray_t* jc_new_arr_with_capacity(size_t count);
+bool jc_obj_reserve(JsonObject_t* obj, size_t count);
+bool jc_arr_reserve(JsonArray_t* arr, size_t count);
 JsonValue_t* jc_new_value(JsonValueType_t ty, void* data);
 JsonValue_t* jc_new_bool_value(bool);
 JsonValue_t* jc_new_double_value(double);
 JsonValue_t* jc_new_int64_value(int64_t);
+bool jc_value_set_string(JsonValue_t* value, const char* str);
+// Works for JC_STRING and JC_STRING_RAW, raw strings are decoded once and the result is kept. That first
+// decode writes to the value, so it must not race with other reads of the same value. NULL for other
+// types or when decoding runs out of memory.
+const char* jc_value_get_string(const JsonValue_t* value);
+// Same as jc_value_get_string and also reports the byte length, strings may contain NUL bytes (\u0000)
+const char* jc_value_get_string_len(const JsonValue_t* value, size_t* len);
+// Numbers of any type, JC_NUMBER_RAW values are converted once and the result is kept. That first
+// conversion writes to the value, so it must not race with other reads of the same value.
+// Integers outside of int64 can only be read as double.
+bool jc_value_get_double(const JsonValue_t* value, double* dbl);
+bool jc_value_get_int64(const JsonValue_t* value, int64_t* i64);
+// JC_INT64 or JC_DOUBLE for numbers depending on how they convert, the type of any other value
+JsonValueType_t jc_value_number_type(const JsonValue_t* value);
+// Source text of a JC_NUMBER_RAW value
+const char* jc_value_number_text(const JsonValue_t* value, size_t* len);
+// Replace the number of a value of any number type
+bool jc_value_set_double(JsonValue_t* value, double dbl);
+bool jc_value_set_int64(JsonValue_t* value, int64_t i64);
+
+/*
+ * Allocation: every document allocates its nodes with its own allocator (by default the global one)
+ * and keeps count of them. Nodes created outside of a document use the global allocator, unless
+ * jc_use_doc_allocator selected a document for the calling thread (NULL to deselect).
+ * jc_set_allocator must not race with other calls into the library.
+ */
+bool jc_set_allocator(const JsonAllocator_t* allocator);
+JsonDocument_t* jc_new_doc_with_allocator(const JsonAllocator_t* allocator);
+JsonDocument_t* jc_doc_from_string_with_allocator(const char* str, const JsonAllocator_t* allocator);
+void jc_use_doc_allocator(const JsonDocument_t* doc);
+bool jc_doc_alloc_stats(const JsonDocument_t* doc, JsonAllocStats_t* stats);
+
+// Walks a tree and reports the memory it holds, usage is overwritten
+bool jc_doc_memory_usage(const JsonDocument_t* doc, JsonMemoryUsage_t* usage);
+bool jc_obj_memory_usage(const JsonObject_t* obj, JsonMemoryUsage_t* usage);
+bool jc_arr_memory_usage(const JsonArray_t* arr, JsonMemoryUsage_t* usage);
+
+/*
+ * Shrinks every array and object of a document to fit and drops tombstones. With contiguous set the
+ * tree is copied in depth first order into a single block owned by the document, values inserted
+ * afterwards are allocated separately. Pointers into the document are invalidated in that case.
+ */
+bool jc_doc_compact(JsonDocument_t* doc, bool contiguous);
+
+/*
+ * Deep copies which allocate every container at its compacted size. A document clone gets its own scope
+ * with the allocator of doc, with contiguous set it is a single block as after jc_doc_compact. Subtrees
+ * are allocated for the target document, or as jc_new_obj/jc_new_arr would with target NULL.
+ */
+JsonDocument_t* jc_doc_clone(const JsonDocument_t* doc, bool contiguous);
+JsonObject_t* jc_obj_clone(const JsonObject_t* obj, const JsonDocument_t* target);
+JsonArray_t* jc_arr_clone(const JsonArray_t* arr, const JsonDocument_t* target);
+
+/*
+ * Shared subtrees: jc_obj_share/jc_arr_share copy a tree into one immutable block with an atomic reference
+ * count, owned by the caller. Before the same subtree is inserted into another container or document,
+ * jc_obj_retain/jc_arr_retain add an owner. jc_free_obj/jc_free_arr drop one, the last owner frees the
+ * block, from any thread. Calls which would modify a shared container or its values fail.
+ *
+ * Copy on write: the *_mut getters replace a shared container held by a private parent with a private copy,
+ * whose members still reference their shared subtrees, and return it. Getting each container on the way
+ * down from the document with them copies only the path to the node being modified. Clones, copies and
+ * compaction reference shared subtrees instead of copying them. Retain returns NULL for private containers.
+ */
+JsonObject_t* jc_obj_share(const JsonObject_t* obj);
+JsonArray_t* jc_arr_share(const JsonArray_t* arr);
+JsonObject_t* jc_obj_retain(JsonObject_t* obj);
+JsonArray_t* jc_arr_retain(JsonArray_t* arr);
+bool jc_obj_is_shared(const JsonObject_t* obj);
+bool jc_arr_is_shared(const JsonArray_t* arr);
+// Makes the container of a private value private, true for values of other types
+bool jc_value_unshare(JsonValue_t* value);
+JsonObject_t* jc_doc_get_obj_mut(JsonDocument_t* doc);
+JsonArray_t* jc_doc_get_arr_mut(JsonDocument_t* doc);
+JsonObject_t* jc_obj_get_obj_mut(JsonObject_t* obj, const char* key);
+JsonArray_t* jc_obj_get_arr_mut(JsonObject_t* obj, const char* key);
+JsonObject_t* jc_arr_get_obj_mut(JsonArray_t* arr, size_t index);
+JsonArray_t* jc_arr_get_arr_mut(JsonArray_t* arr, size_t index);
 
 void jc_free_doc(JsonDocument_t* doc);
 void jc_free_obj(JsonObject_t* obj);
@@ -49,16 +256,16 @@ void jc_free_value(JsonValue_t* value);
 
 bool jc_doc_set_obj(JsonDocument_t* doc, JsonObject_t* obj);
 bool jc_doc_is_obj(const JsonDocument_t* doc);
-JsonObject_t* jc_doc_get_obj(JsonDocument_t* doc);
+JsonObject_t* jc_doc_get_obj(const JsonDocument_t* doc);
 
 bool jc_doc_set_arr(JsonDocument_t* doc, JsonArray_t* obj);
 bool jc_doc_is_arr(const JsonDocument_t* doc);
-JsonArray_t* jc_doc_get_arr(JsonDocument_t* doc);
+JsonArray_t* jc_doc_get_arr(const JsonDocument_t* doc);
 
 bool jc_arr_insert_value(JsonArray_t* arr, JsonValue_t* value);
 bool jc_arr_insert(JsonArray_t* arr, JsonValueType_t ty, void* data);
-size_t jc_arr_size(JsonArray_t* arr);
-JsonValue_t* jc_arr_at(JsonArray_t* arr, size_t index);
+size_t jc_arr_size(const JsonArray_t* arr);
+JsonValue_t* jc_arr_at(const JsonArray_t* arr, size_t index);
 bool jc_arr_remove(JsonArray_t* arr, size_t index, size_t count);
 
 bool jc_obj_set(JsonObject_t* obj, const char* key, JsonValue_t* value);
@@ -67,6 +274,80 @@ bool jc_obj_remove(JsonObject_t* obj, const char* key);
 size_t jc_obj_size(const JsonObject_t* obj);
 
 JsonValue_t* jc_obj_get(const JsonObject_t* obj, const char* key);
+
+// Hash used for object keys (Jenkins one-at-a-time)
+static inline uint32_t jc_key_hash_add(uint32_t hash, uint8_t ch)
+{
+    hash += ch;
+    hash += hash << 10;
+    return hash ^ (hash >> 6);
+}
+
+static inline uint32_t jc_key_hash_finish(uint32_t hash)
+{
+    hash += hash << 3;
+    hash ^= hash >> 11;
+    return hash + (hash << 15);
+}
+
+static inline uint32_t jc_key_hash(const char* key, size_t len)
+{
+    uint32_t hash = 0;
+    for (size_t i = 0; i < len; i++)
+        hash = jc_key_hash_add(hash, (uint8_t)key[i]);
+    return jc_key_hash_finish(hash);
+}
+
+// Fully unrolled, so optimizing compilers fold the hash of string literals into a constant
+static inline uint32_t jc_key_hash_literal(const char* key, size_t len)
+{
+    uint32_t hash = 0;
+#if defined(__GNUC__)
+#    pragma GCC unroll 128
+#endif
+    for (size_t i = 0; i < len; i++)
+        hash = jc_key_hash_add(hash, (uint8_t)key[i]);
+    return jc_key_hash_finish(hash);
+}
+
+// The key string is referenced, not copied
+JsonKey_t jc_key(const char* str);
+#define JC_KEY(LITERAL) ((JsonKey_t) { (LITERAL), sizeof(LITERAL) - 1, jc_key_hash_literal((LITERAL), sizeof(LITERAL) - 1) })
+
+JsonValue_t* jc_obj_get_k(const JsonObject_t* obj, JsonKey_t key);
+bool jc_obj_set_k(JsonObject_t* obj, JsonKey_t key, JsonValue_t* value);
+
+/*
+ * Key sets: a fixed list of keys with a collision free (perfect) hash, built once at startup. Every key
+ * maps to its own slot, so resolving a key to its index takes one hash and one compare.
+ */
+#ifndef JC_KEYSET_MAX_KEYS
+#    define JC_KEYSET_MAX_KEYS 64
+#endif
+#if JC_KEYSET_MAX_KEYS > 254
+#    error "JC_KEYSET_MAX_KEYS has to fit into the uint8_t slots"
+#endif
+#define JC_KEYSET_MAX_SLOTS (JC_KEYSET_MAX_KEYS * 8)
+
+typedef struct {
+    JsonKey_t keys[JC_KEYSET_MAX_KEYS];
+    // Index of the key plus one, 0 for unused slots
+    uint8_t slots[JC_KEYSET_MAX_SLOTS];
+    uint32_t seed;
+    uint32_t shift;
+    size_t count;
+    bool ready;
+} JsonKeySet_t;
+
+// Keys are referenced, not copied. Fails for duplicates, more than JC_KEYSET_MAX_KEYS keys or
+// keys with the same hash.
+bool jc_keyset_init(JsonKeySet_t* set, const char* const* keys, size_t count);
+// Index of the key, -1 if it is not in the set
+int jc_keyset_find(const JsonKeySet_t* set, const char* str, size_t len);
+int jc_keyset_find_hashed(const JsonKeySet_t* set, const char* str, size_t len, uint32_t hash);
+// Looks up every key of the set in one pass over the object, values[i] receives the value of key i
+// or NULL. Returns the number of keys found.
+size_t jc_obj_get_keyset(const JsonObject_t* obj, const JsonKeySet_t* set, JsonValue_t** values);
 const char* jc_obj_get_string(const JsonObject_t* obj, const char* key);
 bool* jc_obj_get_bool(const JsonObject_t* obj, const char* key);
 bool jc_obj_get_double(const JsonObject_t* obj, const char* key, double* dbl);
@@ -74,8 +355,30 @@ bool jc_obj_get_int64(const JsonObject_t* obj, const char* key, int64_t* i64);
 JsonObject_t* jc_obj_get_obj(const JsonObject_t* obj, const char* key);
 JsonArray_t* jc_obj_get_arr(const JsonObject_t* obj, const char* key);
 
+size_t jc_doc_serialized_size(const JsonDocument_t* doc, size_t spaces_per_indent);
 char* jc_doc_to_string(const JsonDocument_t* doc, size_t spaces_per_indent);
+// Serializes into a caller provided buffer, needed receives the size including the NUL terminator
+bool jc_doc_to_buffer(const JsonDocument_t* doc, size_t spaces_per_indent, char* buffer, size_t capacity, size_t* needed);
 JsonDocument_t* jc_doc_from_string(const char* str);
+JsonDocument_t* jc_doc_from_string_with_options(const char* str, const JsonParseOptions_t* options, JsonParseError_t* error);
+
+#ifndef JC_PROJECT_MAX_PATHS
+#    define JC_PROJECT_MAX_PATHS 64
+#endif
+#if JC_PROJECT_MAX_PATHS > 64
+#    error "JC_PROJECT_MAX_PATHS has to fit into a 64 bit mask"
+#endif
+
+// Parses only the parts of buf selected by JSON Pointer paths ("/headers/tenant"), a "*" segment
+// matches every element of an array or member of an object. Everything else is skipped without
+// unescaping strings or converting numbers, only its brackets and quotes are checked. Arrays keep
+// the selected elements in order, containers without any selected value are left out. The empty
+// path "" selects the whole document.
+JsonDocument_t* jc_doc_from_buffer_project(const char* buf, size_t len, const char* const* paths, size_t path_count);
+const char* jc_parse_error_string(JsonParseErrorCode_t code);
+
+// Sum of the counters of all threads, false if the library was built without JC_STATS
+bool jc_stats_snapshot(JsonStats_t* stats);
 
 JsonObjectIter_t jc_obj_iter(const JsonObject_t* obj);
 bool jc_obj_iter_next(JsonObjectIter_t* iter);
@@ -94,4 +397,149 @@ JsonValue_t* jc_obj_iter_value(const JsonObjectIter_t* iter);
     JsonValue_t* value = jc_arr_at(arr, 0); \
     for (size_t loopv##arr = 0; loopv##arr < len##arr; loopv##arr++, value = jc_arr_at(arr, loopv##arr))
 
+/*
+ * Queries: JSONPath ("$.orders[*].lines[?(@.qty > 0)].sku") or JSON Pointer ("/orders/0/id", "*" as a
+ * wildcard segment) compiled once with all keys hashed. Paths support .name, ['name'], [n] (negative
+ * from the end), [*] and .*, [start:end:step] slices and [?(@.a.b OP literal)] filters with ==, !=,
+ * <, <=, >, >= against numbers, strings, true, false and null, or [?(@.a)] to test for a member.
+ * Running a query allocates nothing, callback receives every match and returns false to stop.
+ */
+typedef bool (*JsonQueryCallback_t)(JsonValue_t* value, void* ctx);
+
+// NULL for invalid expressions
+JsonQuery_t* jc_query_compile(const char* expr);
+void jc_query_free(JsonQuery_t* query);
+// Returns the number of matches, the value passed for a query matching the root is a temporary
+size_t jc_query_run(const JsonQuery_t* query, const JsonDocument_t* doc, JsonQueryCallback_t callback, void* ctx);
+size_t jc_query_run_value(const JsonQuery_t* query, JsonValue_t* value, JsonQueryCallback_t callback, void* ctx);
+
+// Streams raw input (one or more consecutive root values) through a query without building a document,
+// every match is passed as the span of input bytes holding it. Memory use does not depend on the input.
+// Matched scalars are validated, matched containers and values which don't match are only checked for
+// terminated strings and balanced brackets, so a matched container may still hold invalid scalars.
+// Negative indices and slice bounds can't be streamed
+// and fail with JC_PARSE_UNSUPPORTED_QUERY. Returns the number of matches, error receives syntax errors.
+typedef bool (*JsonStreamCallback_t)(const char* value, size_t len, void* ctx);
+size_t jc_query_stream(const JsonQuery_t* query, const char* buf, size_t len, JsonStreamCallback_t callback, void* ctx, JsonParseError_t* error);
+
+/*
+ * Binding: parses JSON objects straight into C structs described by a schema, without building a
+ * document, and serializes them back. Members which are not in the schema are skipped, null leaves
+ * a member untouched. Strings and arrays are allocated with malloc and released by jc_bind_free.
+ *
+ *   typedef struct { int64_t id; char* name; } User_t;
+ *   static const JsonField_t user_fields[] = { JC_FIELD(User_t, id, JC_FIELD_INT64), JC_FIELD(User_t, name, JC_FIELD_STRING) };
+ *   static const JsonSchema_t user_schema = JC_SCHEMA(User_t, user_fields);
+ */
+typedef enum {
+    JC_FIELD_INT64,
+    JC_FIELD_DOUBLE,
+    JC_FIELD_BOOL,
+    // char*
+    JC_FIELD_STRING,
+    // char[N] inside the struct, longer strings fail
+    JC_FIELD_STRING_BUF,
+    JC_FIELD_OBJECT,
+    // Pointer to the elements plus a size_t count member, elements can't be arrays or string buffers
+    JC_FIELD_ARRAY,
+} JsonFieldType_t;
+
+typedef struct JsonSchema_t JsonSchema_t;
+
+typedef struct {
+    const char* name;
+    size_t name_len;
+    JsonFieldType_t type;
+    size_t offset;
+    // Member size, element size for arrays
+    size_t size;
+    size_t count_offset;
+    JsonFieldType_t element_type;
+    // Objects and arrays of objects
+    const JsonSchema_t* schema;
+} JsonField_t;
+
+struct JsonSchema_t {
+    const JsonField_t* fields;
+    size_t field_count;
+    size_t struct_size;
+    // Optional, filled by jc_bind_prepare: key i is the name of field i
+    JsonKeySet_t* keys;
+};
+
+#define JC_FIELD_NAMED(STRUCT, MEMBER, NAME, TYPE)                                                     \
+    {                                                                                                  \
+        .name = (NAME), .name_len = sizeof(NAME) - 1, .type = (TYPE), .offset = offsetof(STRUCT, MEMBER), \
+        .size = sizeof(((STRUCT*)0)->MEMBER)                                                           \
+    }
+#define JC_FIELD(STRUCT, MEMBER, TYPE) JC_FIELD_NAMED(STRUCT, MEMBER, #MEMBER, TYPE)
+#define JC_FIELD_OBJ(STRUCT, MEMBER, SCHEMA)                                                                  \
+    {                                                                                                         \
+        .name = #MEMBER, .name_len = sizeof(#MEMBER) - 1, .type = JC_FIELD_OBJECT, .offset = offsetof(STRUCT, MEMBER), \
+        .size = sizeof(((STRUCT*)0)->MEMBER), .schema = (SCHEMA)                                              \
+    }
+#define JC_FIELD_ARR(STRUCT, MEMBER, COUNT_MEMBER, ELEMENT_TYPE, ELEMENT_SCHEMA)                                      \
+    {                                                                                                                 \
+        .name = #MEMBER, .name_len = sizeof(#MEMBER) - 1, .type = JC_FIELD_ARRAY, .offset = offsetof(STRUCT, MEMBER),  \
+        .size = sizeof(*((STRUCT*)0)->MEMBER), .count_offset = offsetof(STRUCT, COUNT_MEMBER),                        \
+        .element_type = (ELEMENT_TYPE), .schema = (ELEMENT_SCHEMA)                                                    \
+    }
+#define JC_SCHEMA(STRUCT, FIELDS) \
+    { .fields = (FIELDS), .field_count = sizeof(FIELDS) / sizeof((FIELDS)[0]), .struct_size = sizeof(STRUCT) }
+// KEYSET points to a JsonKeySet_t with static storage, member names are resolved through it once
+// jc_bind_prepare built it
+#define JC_SCHEMA_INDEXED(STRUCT, FIELDS, KEYSET)                                                      \
+    {                                                                                                 \
+        .fields = (FIELDS), .field_count = sizeof(FIELDS) / sizeof((FIELDS)[0]), .struct_size = sizeof(STRUCT), \
+        .keys = (KEYSET)                                                                              \
+    }
+
+// Builds the key sets of the schema and all nested schemas, call once before binding from several threads
+bool jc_bind_prepare(const JsonSchema_t* schema);
+// dst is cleared first and left cleared on failure
+bool jc_bind_from_string(const JsonSchema_t* schema, const char* str, void* dst, JsonParseError_t* error);
+char* jc_bind_to_string(const JsonSchema_t* schema, const void* src);
+void jc_bind_free(const JsonSchema_t* schema, void* dst);
+
+uint8_t* jc_doc_to_cbor(const JsonDocument_t* doc, size_t* len);
+JsonDocument_t* jc_doc_from_cbor(const uint8_t* data, size_t len);
+uint8_t* jc_doc_to_msgpack(const JsonDocument_t* doc, size_t* len);
+JsonDocument_t* jc_doc_from_msgpack(const uint8_t* data, size_t len);
+
+/*
+ * Tape: immutable, read-only document representation. The whole document is kept
+ * in a flat array of 64-bit words and a single string buffer.
+ */
+JsonTape_t* jc_tape_from_string(const char* str);
+JsonTape_t* jc_tape_from_doc(const JsonDocument_t* doc);
+JsonDocument_t* jc_tape_to_doc(const JsonTape_t* tape);
+void jc_free_tape(JsonTape_t* tape);
+
+/*
+ * Binary images of a tape, including prebuilt key hash tables for larger objects.
+ * Opened images are mapped read-only and accessed in place with the cursor API.
+ */
+bool jc_doc_save_binary(const JsonDocument_t* doc, const char* path);
+bool jc_tape_save_binary(const JsonTape_t* tape, const char* path);
+JsonTape_t* jc_tape_open_binary(const char* path);
+
+JsonTapeCursor_t jc_tape_root(const JsonTape_t* tape);
+JsonValueType_t jc_tape_type(JsonTapeCursor_t cursor);
+size_t jc_tape_size(JsonTapeCursor_t cursor);
+
+bool jc_tape_obj_find(JsonTapeCursor_t obj, const char* key, JsonTapeCursor_t* value);
+bool jc_tape_obj_first(JsonTapeCursor_t obj, JsonTapeCursor_t* member);
+bool jc_tape_obj_next(JsonTapeCursor_t* member);
+const char* jc_tape_obj_key(JsonTapeCursor_t member);
+JsonTapeCursor_t jc_tape_obj_value(JsonTapeCursor_t member);
+
+bool jc_tape_arr_first(JsonTapeCursor_t arr, JsonTapeCursor_t* elem);
+bool jc_tape_arr_next(JsonTapeCursor_t* elem);
+bool jc_tape_arr_at(JsonTapeCursor_t arr, size_t index, JsonTapeCursor_t* elem);
+
+const char* jc_tape_get_string(JsonTapeCursor_t cursor, size_t* len);
+bool jc_tape_get_double(JsonTapeCursor_t cursor, double* dbl);
+bool jc_tape_get_int64(JsonTapeCursor_t cursor, int64_t* i64);
+bool jc_tape_get_bool(JsonTapeCursor_t cursor, bool* b);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,370 @@
+#include <jc_alloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 8
+
+typedef struct {
+    // Allocations which don't fit into the block go here
+    JsonAllocator_t parent;
+    char* pos;
+    char* end;
+} JsonArena_t;
+
+struct JsonAllocScope_t {
+    JsonAllocator_t allocator;
+    // Set for arena scopes, freed together with the scope
+    JsonArena_t* arena;
+    JsonAllocStats_t stats;
+    // Only document scopes are counted, the global scope is shared between threads
+    bool counted;
+    // Set once the owner is gone, the scope is freed together with its last allocation
+    bool released;
+    // Set for shared scopes, which count their live allocations in shared_live instead of stats
+    bool shared;
+    size_t shared_live;
+    // Allocations which would push live_bytes above a non-zero limit fail
+    bool limit_exceeded;
+    size_t byte_limit;
+    JsonAllocScope_t* retired_next;
+};
+
+typedef struct {
+    JsonAllocScope_t* scope;
+    size_t size;
+} JsonAllocHeader_t;
+
+static void* default_alloc(void* ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+static void* default_realloc(void* ctx, void* ptr, size_t size)
+{
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void default_free(void* ctx, void* ptr)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+static inline size_t arena_align(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static inline bool arena_owns(const JsonArena_t* arena, const void* ptr)
+{
+    return (const char*)ptr >= (const char*)(arena + 1) && (const char*)ptr < arena->end;
+}
+
+static void* arena_alloc(void* ctx, size_t size)
+{
+    JsonArena_t* arena = (JsonArena_t*)ctx;
+    size_t aligned = arena_align(size);
+    if (aligned >= size && aligned <= (size_t)(arena->end - arena->pos)) {
+        void* ptr = arena->pos;
+        arena->pos += aligned;
+        return ptr;
+    }
+    return arena->parent.alloc_func(arena->parent.ctx, size);
+}
+
+static void* arena_realloc(void* ctx, void* ptr, size_t size)
+{
+    JsonArena_t* arena = (JsonArena_t*)ctx;
+    if (!arena_owns(arena, ptr))
+        return arena->parent.realloc_func(arena->parent.ctx, ptr, size);
+    // Block memory is never reused, move the allocation out. Its old size is unknown here, but
+    // copying up to the end of the block never leaves it.
+    void* moved = arena->parent.alloc_func(arena->parent.ctx, size);
+    if (!moved)
+        return NULL;
+    size_t available = (size_t)(arena->end - (char*)ptr);
+    memcpy(moved, ptr, size < available ? size : available);
+    return moved;
+}
+
+static void arena_free(void* ctx, void* ptr)
+{
+    JsonArena_t* arena = (JsonArena_t*)ctx;
+    if (!arena_owns(arena, ptr))
+        arena->parent.free_func(arena->parent.ctx, ptr);
+}
+
+static JsonAllocScope_t s_default_scope = {
+    .allocator = { .alloc_func = default_alloc, .realloc_func = default_realloc, .free_func = default_free, .ctx = NULL },
+};
+static JsonAllocScope_t* s_global_scope = &s_default_scope;
+// Replaced global scopes may still own allocations, they are kept reachable but never freed
+static JsonAllocScope_t* s_retired_scopes = NULL;
+static _Thread_local JsonAllocScope_t* s_current_scope = NULL;
+
+bool jc_set_allocator(const JsonAllocator_t* allocator)
+{
+    if (!allocator) {
+        s_global_scope = &s_default_scope;
+        return true;
+    }
+    if (!allocator->alloc_func || !allocator->realloc_func || !allocator->free_func)
+        return false;
+
+    JsonAllocScope_t* scope = (JsonAllocScope_t*)allocator->alloc_func(allocator->ctx, sizeof(JsonAllocScope_t));
+    if (!scope)
+        return false;
+    *scope = (JsonAllocScope_t) { .allocator = *allocator, .retired_next = s_retired_scopes };
+    s_retired_scopes = scope;
+    s_global_scope = scope;
+    return true;
+}
+
+JsonAllocScope_t* jc_alloc_scope_new(const JsonAllocator_t* allocator)
+{
+    if (!allocator)
+        allocator = &s_global_scope->allocator;
+    if (!allocator->alloc_func || !allocator->realloc_func || !allocator->free_func)
+        return NULL;
+
+    JsonAllocScope_t* scope = (JsonAllocScope_t*)allocator->alloc_func(allocator->ctx, sizeof(JsonAllocScope_t));
+    if (!scope)
+        return NULL;
+    *scope = (JsonAllocScope_t) { .allocator = *allocator, .counted = true };
+    return scope;
+}
+
+JsonAllocScope_t* jc_alloc_scope_new_arena(const JsonAllocator_t* allocator, size_t capacity)
+{
+    if (!allocator)
+        allocator = &s_global_scope->allocator;
+    if (capacity > SIZE_MAX - sizeof(JsonArena_t))
+        return NULL;
+    JsonAllocScope_t* scope = jc_alloc_scope_new(allocator);
+    if (!scope)
+        return NULL;
+    JsonArena_t* arena = (JsonArena_t*)allocator->alloc_func(allocator->ctx, sizeof(JsonArena_t) + capacity);
+    if (!arena) {
+        jc_alloc_scope_release(scope);
+        return NULL;
+    }
+    arena->parent = *allocator;
+    arena->pos = (char*)(arena + 1);
+    arena->end = arena->pos + capacity;
+    scope->arena = arena;
+    scope->allocator = (JsonAllocator_t) { .alloc_func = arena_alloc, .realloc_func = arena_realloc, .free_func = arena_free, .ctx = arena };
+    return scope;
+}
+
+JsonAllocScope_t* jc_alloc_scope_new_shared(const JsonAllocator_t* allocator, size_t capacity)
+{
+    JsonAllocScope_t* scope = jc_alloc_scope_new_arena(allocator, capacity);
+    if (!scope)
+        return NULL;
+    scope->counted = false;
+    scope->shared = true;
+    scope->shared_live = 1;
+    return scope;
+}
+
+bool jc_alloc_scope_is_shared(const JsonAllocScope_t* scope)
+{
+    return scope->shared;
+}
+
+const JsonAllocator_t* jc_alloc_scope_allocator(const JsonAllocScope_t* scope)
+{
+    return scope->arena ? &scope->arena->parent : &scope->allocator;
+}
+
+static void scope_free(JsonAllocScope_t* scope)
+{
+    JsonAllocator_t allocator = scope->allocator;
+    JsonArena_t* arena = scope->arena;
+    // The scope itself never lives inside the arena block
+    allocator.free_func(allocator.ctx, scope);
+    if (arena)
+        arena->parent.free_func(arena->parent.ctx, arena);
+}
+
+static inline void shared_scope_drop(JsonAllocScope_t* scope)
+{
+    if (__atomic_sub_fetch(&scope->shared_live, 1, __ATOMIC_ACQ_REL) == 0)
+        scope_free(scope);
+}
+
+void jc_alloc_scope_release(JsonAllocScope_t* scope)
+{
+    if (!scope || (!scope->counted && !scope->shared))
+        return;
+    if (s_current_scope == scope)
+        s_current_scope = NULL;
+    if (scope->shared) {
+        shared_scope_drop(scope);
+        return;
+    }
+    scope->released = true;
+    if (scope->stats.live_allocations == 0)
+        scope_free(scope);
+}
+
+const JsonAllocStats_t* jc_alloc_scope_stats(const JsonAllocScope_t* scope)
+{
+    return scope && scope->counted ? &scope->stats : NULL;
+}
+
+void jc_alloc_scope_set_limit(JsonAllocScope_t* scope, size_t byte_limit)
+{
+    if (!scope->counted)
+        return;
+    scope->byte_limit = byte_limit;
+    scope->limit_exceeded = false;
+}
+
+bool jc_alloc_scope_limit_exceeded(const JsonAllocScope_t* scope)
+{
+    return scope->limit_exceeded;
+}
+
+JsonAllocScope_t* jc_alloc_scope_current(void)
+{
+    return s_current_scope ? s_current_scope : s_global_scope;
+}
+
+JsonAllocScope_t* jc_alloc_scope_enter(JsonAllocScope_t* scope)
+{
+    JsonAllocScope_t* previous = s_current_scope;
+    s_current_scope = scope;
+    return previous;
+}
+
+JsonAllocScope_t* jc_alloc_scope_of(const void* ptr)
+{
+    if (!ptr)
+        return jc_alloc_scope_current();
+    return ((const JsonAllocHeader_t*)ptr - 1)->scope;
+}
+
+static inline bool within_limit(JsonAllocScope_t* scope, size_t size, size_t old_size)
+{
+    if (!scope->byte_limit)
+        return true;
+    size_t remaining_bytes = scope->stats.live_bytes - old_size;
+    if (remaining_bytes <= scope->byte_limit && size <= scope->byte_limit - remaining_bytes)
+        return true;
+    scope->limit_exceeded = true;
+    return false;
+}
+
+static inline void account_alloc(JsonAllocScope_t* scope, size_t size)
+{
+    JsonAllocStats_t* stats = &scope->stats;
+    stats->alloc_count++;
+    stats->live_bytes += size;
+    if (stats->live_bytes > stats->peak_bytes)
+        stats->peak_bytes = stats->live_bytes;
+}
+
+void* jc_mem_alloc_in(JsonAllocScope_t* scope, size_t size)
+{
+    if (!scope)
+        scope = jc_alloc_scope_current();
+    if (size > SIZE_MAX - sizeof(JsonAllocHeader_t) || !within_limit(scope, size, 0))
+        return NULL;
+    JsonAllocHeader_t* header = (JsonAllocHeader_t*)scope->allocator.alloc_func(scope->allocator.ctx, sizeof(JsonAllocHeader_t) + size);
+    if (!header)
+        return NULL;
+    header->scope = scope;
+    header->size = size;
+    if (scope->counted) {
+        scope->stats.live_allocations++;
+        account_alloc(scope, size);
+    } else if (scope->shared) {
+        __atomic_add_fetch(&scope->shared_live, 1, __ATOMIC_RELAXED);
+    }
+    return header + 1;
+}
+
+void* jc_mem_calloc_in(JsonAllocScope_t* scope, size_t size)
+{
+    void* ptr = jc_mem_alloc_in(scope, size);
+    if (ptr)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void* jc_mem_realloc(void* ptr, size_t size)
+{
+    if (!ptr)
+        return jc_mem_alloc(size);
+    if (size > SIZE_MAX - sizeof(JsonAllocHeader_t))
+        return NULL;
+
+    JsonAllocHeader_t* header = (JsonAllocHeader_t*)ptr - 1;
+    JsonAllocScope_t* scope = header->scope;
+    size_t old_size = header->size;
+    if (!within_limit(scope, size, old_size))
+        return NULL;
+    header = (JsonAllocHeader_t*)scope->allocator.realloc_func(scope->allocator.ctx, header, sizeof(JsonAllocHeader_t) + size);
+    if (!header)
+        return NULL;
+    header->size = size;
+    if (scope->counted) {
+        scope->stats.live_bytes -= old_size;
+        account_alloc(scope, size);
+    }
+    return header + 1;
+}
+
+size_t jc_mem_overhead(size_t size)
+{
+    // malloc implementations typically keep a size word and round chunks up to 16 bytes, 32 at least
+    size_t chunk = (sizeof(JsonAllocHeader_t) + size + sizeof(size_t) + 15) & ~(size_t)15;
+    if (chunk < 32)
+        chunk = 32;
+    return chunk - size;
+}
+
+size_t jc_mem_arena_size(size_t size)
+{
+    return arena_align(sizeof(JsonAllocHeader_t) + size);
+}
+
+void jc_mem_adopt(JsonAllocScope_t* scope, void* ptr)
+{
+    JsonAllocHeader_t* header = (JsonAllocHeader_t*)ptr - 1;
+    JsonAllocScope_t* previous = header->scope;
+    if (previous == scope)
+        return;
+    if (previous->counted) {
+        previous->stats.live_allocations--;
+        previous->stats.live_bytes -= header->size;
+    }
+    header->scope = scope;
+    if (scope->counted) {
+        scope->stats.live_allocations++;
+        account_alloc(scope, header->size);
+    }
+    if (previous->released && previous->stats.live_allocations == 0)
+        scope_free(previous);
+}
+
+void jc_mem_free(void* ptr)
+{
+    if (!ptr)
+        return;
+    JsonAllocHeader_t* header = (JsonAllocHeader_t*)ptr - 1;
+    JsonAllocScope_t* scope = header->scope;
+    if (scope->counted) {
+        scope->stats.live_allocations--;
+        scope->stats.live_bytes -= header->size;
+    }
+    scope->allocator.free_func(scope->allocator.ctx, header);
+    if (scope->shared)
+        shared_scope_drop(scope);
+    else if (scope->released && scope->stats.live_allocations == 0)
+        scope_free(scope);
+}
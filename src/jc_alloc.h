@@ -0,0 +1,55 @@
+#ifndef JC_ALLOC__
+#define JC_ALLOC__
+
+#include <jc.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Every allocation made through jc_mem_* is prefixed with a header pointing to the scope it was
+ * allocated in, so it is always released through the right allocator and accounted for in the
+ * right document. Each document owns a scope, everything else lives in the global scope.
+ */
+typedef struct JsonAllocScope_t JsonAllocScope_t;
+
+JsonAllocScope_t* jc_alloc_scope_new(const JsonAllocator_t* allocator);
+// Scope which hands out allocations from one block of capacity bytes first, see jc_mem_arena_size
+JsonAllocScope_t* jc_alloc_scope_new_arena(const JsonAllocator_t* allocator, size_t capacity);
+/*
+ * Arena scope for a subtree which is shared between documents and threads. It is written by one thread
+ * while the subtree is built and only freed from afterwards, by any thread. Nothing but its live
+ * allocations is counted, atomically. The builder holds one allocation count until it releases the
+ * scope, the scope is freed together with the last allocation after that.
+ */
+JsonAllocScope_t* jc_alloc_scope_new_shared(const JsonAllocator_t* allocator, size_t capacity);
+bool jc_alloc_scope_is_shared(const JsonAllocScope_t* scope);
+// Allocator a scope ultimately allocates from
+const JsonAllocator_t* jc_alloc_scope_allocator(const JsonAllocScope_t* scope);
+void jc_alloc_scope_release(JsonAllocScope_t* scope);
+const JsonAllocStats_t* jc_alloc_scope_stats(const JsonAllocScope_t* scope);
+// Limits the live bytes of a document scope (0 for no limit) until reset
+void jc_alloc_scope_set_limit(JsonAllocScope_t* scope, size_t byte_limit);
+bool jc_alloc_scope_limit_exceeded(const JsonAllocScope_t* scope);
+
+// Scope used for new allocations on the calling thread, enter returns the previous one
+JsonAllocScope_t* jc_alloc_scope_current(void);
+JsonAllocScope_t* jc_alloc_scope_enter(JsonAllocScope_t* scope);
+JsonAllocScope_t* jc_alloc_scope_of(const void* ptr);
+
+// A NULL scope allocates in the current scope
+void* jc_mem_alloc_in(JsonAllocScope_t* scope, size_t size);
+void* jc_mem_calloc_in(JsonAllocScope_t* scope, size_t size);
+void* jc_mem_realloc(void* ptr, size_t size);
+void jc_mem_free(void* ptr);
+// Estimated bytes an allocation of size costs on top of size: our header plus malloc chunk rounding
+size_t jc_mem_overhead(size_t size);
+// Bytes an allocation of size takes up inside an arena block
+size_t jc_mem_arena_size(size_t size);
+// Moves the accounting of an allocation to scope, both scopes must free through the same allocator
+void jc_mem_adopt(JsonAllocScope_t* scope, void* ptr);
+
+static inline void* jc_mem_alloc(size_t size) { return jc_mem_alloc_in(jc_alloc_scope_current(), size); }
+
+static inline void* jc_mem_calloc(size_t size) { return jc_mem_calloc_in(jc_alloc_scope_current(), size); }
+
+#endif
@@ -0,0 +1,455 @@
+#include <assert.h>
+#include <jc.h>
+#include <jc_parser.h>
+#include <jc_stats.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string_builder.h>
+
+/*
+ * Parses straight into caller structs. Keys and strings without escape sequences are used in
+ * place, everything else is unescaped into a scratch buffer shared by the whole parse.
+ */
+
+#ifndef JC_BIND_MAX_DEPTH
+#    define JC_BIND_MAX_DEPTH 256
+#endif
+
+#ifndef JC_BIND_MAX_SCHEMAS
+#    define JC_BIND_MAX_SCHEMAS 64
+#endif
+
+typedef struct {
+    JsonParser_t parser;
+    StringBuilder_t scratch;
+    size_t depth;
+} BindReader_t;
+
+static bool bind_fail(BindReader_t* reader, JsonParseErrorCode_t code)
+{
+    return parser_fail(&reader->parser, code);
+}
+
+// Reads a string, str points either into the input or into the scratch buffer
+static bool bind_read_str(BindReader_t* reader, const char** str, size_t* len)
+{
+    JsonParser_t* parser = &reader->parser;
+    if (parser_peek(parser, 0) != '"')
+        return false;
+    size_t start = parser->pos + 1;
+    for (size_t pos = start; pos < parser->len; pos++) {
+        char ch = parser->text[pos];
+        if (ch == '"') {
+            *str = &parser->text[start];
+            *len = pos - start;
+            parser->pos = pos + 1;
+            return true;
+        }
+        if (ch == '\\' || ch == '\t' || ch == '\n')
+            break;
+    }
+    builder_reset(&reader->scratch);
+    if (!parse_and_unescape_str(parser, &reader->scratch))
+        return false;
+    *str = reader->scratch.buffer;
+    *len = reader->scratch.pos;
+    return true;
+}
+
+// Members usually come in schema order, so the search starts after the previous match
+static const JsonField_t* schema_find(const JsonSchema_t* schema, const char* key, size_t len, size_t* next)
+{
+    if (schema->keys && schema->keys->ready) {
+        int index = jc_keyset_find(schema->keys, key, len);
+        return index >= 0 ? &schema->fields[index] : NULL;
+    }
+
+    size_t index = *next;
+    for (size_t i = 0; i < schema->field_count; i++, index++) {
+        if (index >= schema->field_count)
+            index = 0;
+        const JsonField_t* field = &schema->fields[index];
+        if (field->name_len == len && memcmp(field->name, key, len) == 0) {
+            *next = index + 1;
+            return field;
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    const JsonSchema_t* schemas[JC_BIND_MAX_SCHEMAS];
+    size_t count;
+} BindVisited_t;
+
+// Nested schemas can refer back to their parents, every schema is visited once
+static bool bind_prepare(const JsonSchema_t* schema, BindVisited_t* visited)
+{
+    for (size_t i = 0; i < visited->count; i++)
+        if (visited->schemas[i] == schema)
+            return true;
+    if (visited->count == JC_BIND_MAX_SCHEMAS)
+        return false;
+    visited->schemas[visited->count++] = schema;
+
+    if (schema->keys && !schema->keys->ready) {
+        const char* names[JC_KEYSET_MAX_KEYS];
+        if (schema->field_count > JC_KEYSET_MAX_KEYS)
+            return false;
+        for (size_t i = 0; i < schema->field_count; i++)
+            names[i] = schema->fields[i].name;
+        if (!jc_keyset_init(schema->keys, names, schema->field_count))
+            return false;
+    }
+    for (size_t i = 0; i < schema->field_count; i++)
+        if (schema->fields[i].schema && !bind_prepare(schema->fields[i].schema, visited))
+            return false;
+    return true;
+}
+
+bool jc_bind_prepare(const JsonSchema_t* schema)
+{
+    BindVisited_t visited = { .count = 0 };
+    return schema && bind_prepare(schema, &visited);
+}
+
+static void bind_free_value(JsonFieldType_t type, const JsonSchema_t* schema, char* member);
+
+static void bind_free_array(const JsonField_t* field, char* dst)
+{
+    char** items = (char**)(dst + field->offset);
+    size_t* count = (size_t*)(dst + field->count_offset);
+    for (size_t i = 0; *items && i < *count; i++)
+        bind_free_value(field->element_type, field->schema, *items + i * field->size);
+    free(*items);
+    *items = NULL;
+    *count = 0;
+}
+
+static void bind_free_value(JsonFieldType_t type, const JsonSchema_t* schema, char* member)
+{
+    switch (type) {
+    case JC_FIELD_STRING:
+        free(*(char**)member);
+        *(char**)member = NULL;
+        break;
+    case JC_FIELD_OBJECT:
+        jc_bind_free(schema, member);
+        break;
+    default:
+        break;
+    }
+}
+
+void jc_bind_free(const JsonSchema_t* schema, void* dst)
+{
+    if (!schema || !dst)
+        return;
+    for (size_t i = 0; i < schema->field_count; i++) {
+        const JsonField_t* field = &schema->fields[i];
+        if (field->type == JC_FIELD_ARRAY)
+            bind_free_array(field, (char*)dst);
+        else
+            bind_free_value(field->type, field->schema, (char*)dst + field->offset);
+    }
+}
+
+static bool bind_read_obj(BindReader_t* reader, const JsonSchema_t* schema, char* dst);
+
+// A value of another JSON type is a mismatch, anything else is left as a syntax error
+static bool bind_mismatch(BindReader_t* reader)
+{
+    char ch = parser_peek(&reader->parser, 0);
+    if (ch == '"' || ch == '{' || ch == '[' || ch == 't' || ch == 'f' || ch == 'n' || ch == '-' || is_digit(ch))
+        return bind_fail(reader, JC_PARSE_TYPE_MISMATCH);
+    return false;
+}
+
+// Integers beyond int64 are converted to double, an int64 field rejects them like any other fraction
+static bool bind_read_number(BindReader_t* reader, JsonNumberToken_t* token)
+{
+    JsonParser_t* parser = &reader->parser;
+    char ch = parser_peek(parser, 0);
+    if (ch != '-' && !is_digit(ch))
+        return bind_mismatch(reader);
+    size_t start = parser->pos;
+    bool is_double, out_of_range;
+    if (!parser_scan_number(parser, &is_double))
+        return false;
+    if (!convert_number(&parser->text[start], parser->pos - start, is_double, token, &out_of_range))
+        return bind_fail(reader, JC_PARSE_OUT_OF_MEMORY);
+    return true;
+}
+
+static bool bind_read_value(BindReader_t* reader, JsonFieldType_t type, const JsonSchema_t* schema, size_t size, char* member)
+{
+    JsonParser_t* parser = &reader->parser;
+    JsonNumberToken_t token;
+    const char* str;
+    size_t len;
+    switch (type) {
+    case JC_FIELD_INT64: {
+        size_t start = parser->pos;
+        if (!bind_read_number(reader, &token))
+            return false;
+        if (token.is_double) {
+            parser->pos = start;
+            return bind_fail(reader, JC_PARSE_TYPE_MISMATCH);
+        }
+        *(int64_t*)member = token.num_int64;
+        return true;
+    }
+    case JC_FIELD_DOUBLE:
+        if (!bind_read_number(reader, &token))
+            return false;
+        *(double*)member = token.is_double ? token.num_double : (double)token.num_int64;
+        return true;
+    case JC_FIELD_BOOL:
+        if (parser_consume_specific(parser, "true", 4)) {
+            *(bool*)member = true;
+            return true;
+        }
+        if (parser_consume_specific(parser, "false", 5)) {
+            *(bool*)member = false;
+            return true;
+        }
+        return parser_peek(parser, 0) != 't' && parser_peek(parser, 0) != 'f' ? bind_mismatch(reader) : false;
+    case JC_FIELD_STRING: {
+        if (parser_peek(parser, 0) != '"')
+            return bind_mismatch(reader);
+        if (!bind_read_str(reader, &str, &len))
+            return false;
+        char* copy = (char*)malloc(len + 1);
+        if (!copy)
+            return bind_fail(reader, JC_PARSE_OUT_OF_MEMORY);
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+        free(*(char**)member);
+        *(char**)member = copy;
+        return true;
+    }
+    case JC_FIELD_STRING_BUF:
+        if (parser_peek(parser, 0) != '"')
+            return bind_mismatch(reader);
+        if (!bind_read_str(reader, &str, &len))
+            return false;
+        if (len >= size)
+            return bind_fail(reader, JC_PARSE_STRING_TOO_LONG);
+        memcpy(member, str, len);
+        member[len] = '\0';
+        return true;
+    case JC_FIELD_OBJECT:
+        return bind_read_obj(reader, schema, member);
+    case JC_FIELD_ARRAY:
+        break;
+    }
+    return bind_fail(reader, JC_PARSE_TYPE_MISMATCH);
+}
+
+static bool bind_read_arr(BindReader_t* reader, const JsonField_t* field, char* dst)
+{
+    JsonParser_t* parser = &reader->parser;
+    if (field->element_type == JC_FIELD_ARRAY || field->element_type == JC_FIELD_STRING_BUF)
+        return bind_fail(reader, JC_PARSE_TYPE_MISMATCH);
+    if (!parser_consume_specific(parser, "[", 1))
+        return bind_fail(reader, JC_PARSE_TYPE_MISMATCH);
+
+    // A repeated member replaces the previous array
+    bind_free_array(field, dst);
+    char** items = (char**)(dst + field->offset);
+    size_t* count = (size_t*)(dst + field->count_offset);
+    size_t capacity = 0;
+    ignore_whitespace(parser);
+    if (parser_consume_specific(parser, "]", 1))
+        return true;
+
+    for (;;) {
+        ignore_whitespace(parser);
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            char* grown = (char*)realloc(*items, capacity * field->size);
+            if (!grown)
+                return bind_fail(reader, JC_PARSE_OUT_OF_MEMORY);
+            *items = grown;
+        }
+        char* element = *items + *count * field->size;
+        memset(element, 0, field->size);
+        // Counted right away, so a partially read element is released as well
+        (*count)++;
+        if (!parser_consume_specific(parser, "null", 4)
+            && !bind_read_value(reader, field->element_type, field->schema, field->size, element))
+            return false;
+        ignore_whitespace(parser);
+        if (parser_consume_specific(parser, "]", 1))
+            return true;
+        if (!parser_consume_specific(parser, ",", 1))
+            return false;
+    }
+}
+
+static bool bind_read_obj(BindReader_t* reader, const JsonSchema_t* schema, char* dst)
+{
+    JsonParser_t* parser = &reader->parser;
+    if (!parser_consume_specific(parser, "{", 1))
+        return bind_fail(reader, JC_PARSE_TYPE_MISMATCH);
+    if (++reader->depth > JC_BIND_MAX_DEPTH)
+        return bind_fail(reader, JC_PARSE_TOO_DEEP);
+
+    size_t next = 0;
+    ignore_whitespace(parser);
+    if (parser_consume_specific(parser, "}", 1))
+        goto EXIT;
+    for (;;) {
+        ignore_whitespace(parser);
+        const char* key;
+        size_t key_len;
+        if (!bind_read_str(reader, &key, &key_len))
+            return false;
+        const JsonField_t* field = schema_find(schema, key, key_len, &next);
+        ignore_whitespace(parser);
+        if (!parser_consume_specific(parser, ":", 1))
+            return false;
+        ignore_whitespace(parser);
+
+        if (!field) {
+            if (!parser_skip_value(parser))
+                return false;
+        } else if (!parser_consume_specific(parser, "null", 4)) {
+            bool success = field->type == JC_FIELD_ARRAY
+                ? bind_read_arr(reader, field, dst)
+                : bind_read_value(reader, field->type, field->schema, field->size, dst + field->offset);
+            if (!success)
+                return false;
+        }
+
+        ignore_whitespace(parser);
+        if (parser_consume_specific(parser, "}", 1))
+            break;
+        if (!parser_consume_specific(parser, ",", 1))
+            return false;
+    }
+EXIT:
+    reader->depth--;
+    return true;
+}
+
+bool jc_bind_from_string(const JsonSchema_t* schema, const char* str, void* dst, JsonParseError_t* error)
+{
+    BindReader_t reader = { .parser = { .text = str }, .scratch = { .scoped = true } };
+    bool success = false;
+    if (!schema || !str || !dst)
+        goto EXIT;
+    memset(dst, 0, schema->struct_size);
+    reader.parser.len = strlen(str);
+
+    ignore_whitespace(&reader.parser);
+    success = bind_read_obj(&reader, schema, (char*)dst);
+    ignore_whitespace(&reader.parser);
+    success = success && parser_eof(&reader.parser);
+    JC_STATS_ADD(bytes_scanned, reader.parser.pos);
+    if (!success) {
+        jc_bind_free(schema, dst);
+        memset(dst, 0, schema->struct_size);
+    }
+
+EXIT:
+    if (!success)
+        parser_fail(&reader.parser, JC_PARSE_SYNTAX_ERROR);
+    if (error)
+        *error = reader.parser.error;
+    builder_free(&reader.scratch);
+    return success;
+}
+
+/*
+ *   Serialization
+ */
+
+static void bind_write_obj(StringBuilder_t* builder, const JsonSchema_t* schema, const char* src);
+
+static void bind_write_str(StringBuilder_t* builder, const char* str, size_t len)
+{
+    builder_append_ch(builder, '"');
+    builder_append_escaped(builder, str, len);
+    builder_append_ch(builder, '"');
+}
+
+static void bind_write_value(StringBuilder_t* builder, JsonFieldType_t type, const JsonSchema_t* schema, size_t size, const char* member)
+{
+    switch (type) {
+    case JC_FIELD_INT64:
+        builder_append(builder, "%ld", *(const int64_t*)member);
+        break;
+    case JC_FIELD_DOUBLE:
+        builder_append(builder, "%g", *(const double*)member);
+        break;
+    case JC_FIELD_BOOL:
+        builder_append(builder, "%s", *(const bool*)member ? "true" : "false");
+        break;
+    case JC_FIELD_STRING: {
+        const char* str = *(char* const*)member;
+        if (str)
+            bind_write_str(builder, str, strlen(str));
+        else
+            builder_append(builder, "null");
+        break;
+    }
+    case JC_FIELD_STRING_BUF:
+        bind_write_str(builder, member, strnlen(member, size));
+        break;
+    case JC_FIELD_OBJECT:
+        bind_write_obj(builder, schema, member);
+        break;
+    case JC_FIELD_ARRAY:
+        builder_append(builder, "null");
+        break;
+    }
+}
+
+static void bind_write_arr(StringBuilder_t* builder, const JsonField_t* field, const char* src)
+{
+    const char* items = *(char* const*)(src + field->offset);
+    size_t count = *(const size_t*)(src + field->count_offset);
+    builder_append_ch(builder, '[');
+    for (size_t i = 0; items && i < count; i++) {
+        if (i)
+            builder_append_ch(builder, ',');
+        bind_write_value(builder, field->element_type, field->schema, field->size, items + i * field->size);
+    }
+    builder_append_ch(builder, ']');
+}
+
+static void bind_write_obj(StringBuilder_t* builder, const JsonSchema_t* schema, const char* src)
+{
+    builder_append_ch(builder, '{');
+    for (size_t i = 0; i < schema->field_count; i++) {
+        const JsonField_t* field = &schema->fields[i];
+        if (i)
+            builder_append_ch(builder, ',');
+        bind_write_str(builder, field->name, field->name_len);
+        builder_append_ch(builder, ':');
+        if (field->type == JC_FIELD_ARRAY)
+            bind_write_arr(builder, field, src);
+        else
+            bind_write_value(builder, field->type, field->schema, field->size, src + field->offset);
+    }
+    builder_append_ch(builder, '}');
+}
+
+char* jc_bind_to_string(const JsonSchema_t* schema, const void* src)
+{
+    if (!schema || !src)
+        return NULL;
+    // Measure first, then write into a buffer of the exact size
+    StringBuilder_t builder;
+    builder_use_buffer(&builder, NULL, 0);
+    bind_write_obj(&builder, schema, (const char*)src);
+    size_t size = builder.pos + 1;
+    char* buffer = (char*)malloc(size);
+    if (!buffer)
+        return NULL;
+    builder_use_buffer(&builder, buffer, size);
+    bind_write_obj(&builder, schema, (const char*)src);
+    assert(!builder.overflow);
+    return buffer;
+}
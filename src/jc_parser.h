@@ -0,0 +1,109 @@
+#ifndef JC_PARSER__
+#define JC_PARSER__
+
+#include <jc.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string_builder.h>
+
+typedef struct {
+    const char* text;
+    size_t pos;
+    size_t len;
+    // Zero initialized parsers have no limits
+    JsonParseOptions_t limits;
+    size_t depth;
+    size_t nodes;
+    JsonParseError_t error;
+    // Member counts of all containers in the order they are opened, see limits.presize_containers
+    uint32_t* size_hints;
+    size_t size_hint_count;
+    size_t size_hint_next;
+} JsonParser_t;
+
+typedef struct {
+    bool is_double;
+    union {
+        double num_double;
+        int64_t num_int64;
+    };
+} JsonNumberToken_t;
+
+static inline bool parser_eof(const JsonParser_t* parser) { return parser->pos >= parser->len; }
+
+static inline size_t parser_remaining(const JsonParser_t* parser) { return parser->len - parser->pos; }
+
+static inline void parser_ignore(JsonParser_t* parser, size_t count)
+{
+    size_t skipped = count;
+    size_t remanining = parser->len - parser->pos;
+    if (skipped >= remanining)
+        skipped = remanining;
+    parser->pos += skipped;
+}
+
+static inline char parser_consume(JsonParser_t* parser)
+{
+    if (parser->pos >= parser->len)
+        return EOF;
+    return parser->text[parser->pos++];
+}
+
+static inline char parser_peek(const JsonParser_t* parser, size_t off)
+{
+    if (parser->pos + off >= parser->len)
+        return EOF;
+    return parser->text[parser->pos + off];
+}
+
+static inline bool parser_consume_specific(JsonParser_t* parser, const char* str, size_t len)
+{
+    if (parser_remaining(parser) < len || memcmp(&parser->text[parser->pos], str, len) != 0)
+        return false;
+    parser_ignore(parser, len);
+    return true;
+}
+
+// Records the first error, later failures while unwinding keep it
+static inline bool parser_fail(JsonParser_t* parser, JsonParseErrorCode_t code)
+{
+    if (parser->error.code == JC_PARSE_OK) {
+        parser->error.code = code;
+        parser->error.offset = parser->pos;
+    }
+    return false;
+}
+
+static inline bool is_digit(char ch) { return ch >= '0' && ch <= '9'; }
+
+static inline bool is_space(char ch)
+{
+    return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r';
+}
+
+static inline void ignore_whitespace(JsonParser_t* parser)
+{
+    while (!parser_eof(parser) && is_space(parser_peek(parser, 0))) {
+        parser_ignore(parser, 1);
+    }
+}
+
+bool parse_and_unescape_str(JsonParser_t* parser, StringBuilder_t* builder);
+bool parse_number_token(JsonParser_t* parser, JsonNumberToken_t* token);
+// Checks the number grammar and moves past the number without converting it
+bool parser_scan_number(JsonParser_t* parser, bool* is_double);
+// Finds the end of a string and checks it like parse_and_unescape_str without decoding it
+bool parser_scan_string(JsonParser_t* parser, bool* has_escapes);
+// Converts a number checked by parser_scan_number. With out_of_range set integers beyond int64 are
+// converted to double and flagged, otherwise they are clamped. Fails only when the copy of a long
+// number can't be allocated.
+bool convert_number(const char* text, size_t len, bool is_double, JsonNumberToken_t* token, bool* out_of_range);
+// Skips a value without building it. Only the structure is checked: strings have to be terminated
+// and brackets balanced, scalars are not validated.
+bool parser_skip_string(JsonParser_t* parser);
+bool parser_skip_value(JsonParser_t* parser);
+
+#endif
@@ -0,0 +1,879 @@
+#include <assert.h>
+#include <jc.h>
+#include <jc_alloc.h>
+#include <jc_parser.h>
+#include <jc_stats.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ *   Queries
+ *
+ * Compiled into a list of steps with all keys hashed up front. Running a query walks the document
+ * recursively, one level per step, and calls back for every value reached by the last step.
+ */
+
+typedef enum {
+    QUERY_KEY,
+    QUERY_INDEX,
+    QUERY_WILDCARD,
+    QUERY_SLICE,
+    QUERY_FILTER,
+} QueryStepKind;
+
+typedef enum {
+    // Only checks that the filter path exists
+    QUERY_OP_EXISTS,
+    QUERY_OP_EQ,
+    QUERY_OP_NE,
+    QUERY_OP_LT,
+    QUERY_OP_LE,
+    QUERY_OP_GT,
+    QUERY_OP_GE,
+} QueryOp;
+
+typedef struct {
+    QueryStepKind kind;
+    // Key steps, JSON Pointer segments made of digits also select array elements through index
+    JsonKey_t key;
+    bool has_index;
+    // Index steps count from the end when negative, slices use all three
+    int64_t index;
+    int64_t end;
+    int64_t step;
+    bool has_start;
+    bool has_end;
+    // Filters: keys below the current element, the operator and the value compared to
+    JsonKey_t* path;
+    size_t path_len;
+    QueryOp op;
+    JsonValue_t literal;
+    size_t literal_len;
+} QueryStep_t;
+
+struct JsonQuery_t {
+    QueryStep_t* steps;
+    size_t step_count;
+    size_t step_capacity;
+};
+
+typedef struct {
+    const char* text;
+    size_t pos;
+} QueryLexer_t;
+
+static QueryStep_t* query_add_step(JsonQuery_t* query, QueryStepKind kind)
+{
+    if (query->step_count == query->step_capacity) {
+        size_t capacity = query->step_capacity ? query->step_capacity * 2 : 8;
+        QueryStep_t* steps = (QueryStep_t*)jc_mem_realloc(query->steps, capacity * sizeof(QueryStep_t));
+        if (!steps)
+            return NULL;
+        query->steps = steps;
+        query->step_capacity = capacity;
+    }
+    QueryStep_t* step = &query->steps[query->step_count++];
+    memset(step, 0, sizeof(QueryStep_t));
+    step->kind = kind;
+    return step;
+}
+
+// The key owns a copy of str
+static bool query_make_key(JsonKey_t* key, const char* str, size_t len)
+{
+    char* copy = (char*)jc_mem_alloc(len + 1);
+    if (!copy)
+        return false;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    key->str = copy;
+    key->len = len;
+    key->hash = jc_key_hash(copy, len);
+    return true;
+}
+
+static inline char lexer_peek(const QueryLexer_t* lexer) { return lexer->text[lexer->pos]; }
+
+static inline bool lexer_accept(QueryLexer_t* lexer, char ch)
+{
+    if (lexer->text[lexer->pos] != ch)
+        return false;
+    lexer->pos++;
+    return true;
+}
+
+static inline void lexer_skip_space(QueryLexer_t* lexer)
+{
+    while (lexer_peek(lexer) == ' ')
+        lexer->pos++;
+}
+
+static inline bool is_name_char(char ch)
+{
+    return ch && ch != '.' && ch != '[' && ch != ']' && ch != ' ' && ch != '(' && ch != ')' && ch != '='
+        && ch != '!' && ch != '<' && ch != '>' && ch != '\'' && ch != '"';
+}
+
+static bool lexer_name(QueryLexer_t* lexer, JsonKey_t* key)
+{
+    size_t start = lexer->pos;
+    while (is_name_char(lexer_peek(lexer)))
+        lexer->pos++;
+    return lexer->pos > start && query_make_key(key, &lexer->text[start], lexer->pos - start);
+}
+
+// 'single' or "double" quoted, a backslash escapes the next character
+static bool lexer_quoted(QueryLexer_t* lexer, JsonKey_t* key)
+{
+    char quote = lexer_peek(lexer);
+    if (quote != '\'' && quote != '"')
+        return false;
+    lexer->pos++;
+    size_t start = lexer->pos;
+    size_t escapes = 0;
+    for (; lexer_peek(lexer) != quote; lexer->pos++) {
+        if (!lexer_peek(lexer))
+            return false;
+        if (lexer_peek(lexer) == '\\') {
+            lexer->pos++;
+            escapes++;
+            if (!lexer_peek(lexer))
+                return false;
+        }
+    }
+    size_t raw_len = lexer->pos - start;
+    lexer->pos++;
+
+    char* str = (char*)jc_mem_alloc(raw_len - escapes + 1);
+    if (!str)
+        return false;
+    size_t len = 0;
+    for (size_t i = start; i < start + raw_len; i++) {
+        if (lexer->text[i] == '\\')
+            i++;
+        str[len++] = lexer->text[i];
+    }
+    str[len] = '\0';
+    key->str = str;
+    key->len = len;
+    key->hash = jc_key_hash(str, len);
+    return true;
+}
+
+static bool lexer_int(QueryLexer_t* lexer, int64_t* value)
+{
+    bool negative = lexer_accept(lexer, '-');
+    char ch = lexer_peek(lexer);
+    if (ch < '0' || ch > '9')
+        return false;
+    int64_t result = 0;
+    while ((ch = lexer_peek(lexer)) >= '0' && ch <= '9') {
+        if (result > (INT64_MAX - (ch - '0')) / 10)
+            return false;
+        result = result * 10 + (ch - '0');
+        lexer->pos++;
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+static bool lexer_literal(QueryLexer_t* lexer, JsonValue_t* literal, size_t* literal_len)
+{
+    const char* text = &lexer->text[lexer->pos];
+    if (strncmp(text, "true", 4) == 0 || strncmp(text, "false", 5) == 0) {
+        literal->ty = JC_BOOLEAN;
+        literal->boolean = text[0] == 't';
+        lexer->pos += literal->boolean ? 4 : 5;
+        return true;
+    }
+    if (strncmp(text, "null", 4) == 0) {
+        literal->ty = JC_NULL_LITERAL;
+        lexer->pos += 4;
+        return true;
+    }
+    if (text[0] == '\'' || text[0] == '"') {
+        JsonKey_t str;
+        if (!lexer_quoted(lexer, &str))
+            return false;
+        literal->ty = JC_STRING;
+        literal->string = (char*)str.str;
+        *literal_len = str.len;
+        return true;
+    }
+
+    // Numbers follow the JSON grammar, integers have to fit into int64
+    JsonParser_t parser = { .text = text, .len = strlen(text) };
+    JsonNumberToken_t token;
+    bool is_double;
+    bool out_of_range = false;
+    if (!parser_scan_number(&parser, &is_double) || !convert_number(text, parser.pos, is_double, &token, &out_of_range) || out_of_range)
+        return false;
+    if (token.is_double) {
+        literal->ty = JC_DOUBLE;
+        literal->num_double = token.num_double;
+    } else {
+        literal->ty = JC_INT64;
+        literal->num_int64 = token.num_int64;
+    }
+    lexer->pos += parser.pos;
+    return true;
+}
+
+// ?(@.a.b OP literal) without the leading '?'
+static bool compile_filter(QueryLexer_t* lexer, QueryStep_t* step)
+{
+    if (!lexer_accept(lexer, '('))
+        return false;
+    lexer_skip_space(lexer);
+    if (!lexer_accept(lexer, '@'))
+        return false;
+
+    size_t capacity = 0;
+    for (;;) {
+        JsonKey_t key;
+        if (lexer_accept(lexer, '.')) {
+            if (!lexer_name(lexer, &key))
+                return false;
+        } else if (lexer_peek(lexer) == '[') {
+            lexer->pos++;
+            if (!lexer_quoted(lexer, &key))
+                return false;
+            if (!lexer_accept(lexer, ']')) {
+                jc_mem_free((char*)key.str);
+                return false;
+            }
+        } else {
+            break;
+        }
+        if (step->path_len == capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            JsonKey_t* path = (JsonKey_t*)jc_mem_realloc(step->path, capacity * sizeof(JsonKey_t));
+            if (!path) {
+                jc_mem_free((char*)key.str);
+                return false;
+            }
+            step->path = path;
+        }
+        step->path[step->path_len++] = key;
+    }
+
+    lexer_skip_space(lexer);
+    static const struct {
+        const char* token;
+        QueryOp op;
+    } ops[] = { { "==", QUERY_OP_EQ }, { "!=", QUERY_OP_NE }, { "<=", QUERY_OP_LE }, { ">=", QUERY_OP_GE },
+        { "<", QUERY_OP_LT }, { ">", QUERY_OP_GT } };
+    step->op = QUERY_OP_EXISTS;
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        size_t len = strlen(ops[i].token);
+        if (strncmp(&lexer->text[lexer->pos], ops[i].token, len) == 0) {
+            step->op = ops[i].op;
+            lexer->pos += len;
+            break;
+        }
+    }
+    if (step->op != QUERY_OP_EXISTS) {
+        lexer_skip_space(lexer);
+        if (!lexer_literal(lexer, &step->literal, &step->literal_len))
+            return false;
+        lexer_skip_space(lexer);
+    }
+    return lexer_accept(lexer, ')');
+}
+
+// Everything between '[' and ']'
+static bool compile_bracket(QueryLexer_t* lexer, JsonQuery_t* query)
+{
+    lexer_skip_space(lexer);
+    char ch = lexer_peek(lexer);
+    QueryStep_t* step;
+    if (ch == '*') {
+        lexer->pos++;
+        step = query_add_step(query, QUERY_WILDCARD);
+    } else if (ch == '\'' || ch == '"') {
+        step = query_add_step(query, QUERY_KEY);
+        if (!step || !lexer_quoted(lexer, &step->key))
+            return false;
+    } else if (ch == '?') {
+        lexer->pos++;
+        step = query_add_step(query, QUERY_FILTER);
+        if (!step || !compile_filter(lexer, step))
+            return false;
+    } else {
+        step = query_add_step(query, QUERY_INDEX);
+        if (!step)
+            return false;
+        step->has_start = lexer_int(lexer, &step->index);
+        if (lexer_accept(lexer, ':')) {
+            step->kind = QUERY_SLICE;
+            step->step = 1;
+            step->has_end = lexer_int(lexer, &step->end);
+            if (lexer_accept(lexer, ':') && lexer_int(lexer, &step->step) && step->step == 0)
+                return false;
+        } else if (!step->has_start) {
+            return false;
+        }
+    }
+    if (!step)
+        return false;
+    lexer_skip_space(lexer);
+    return lexer_accept(lexer, ']');
+}
+
+static bool compile_path(QueryLexer_t* lexer, JsonQuery_t* query)
+{
+    lexer->pos++;
+    while (lexer_peek(lexer)) {
+        if (lexer_accept(lexer, '.')) {
+            if (lexer_accept(lexer, '*')) {
+                if (!query_add_step(query, QUERY_WILDCARD))
+                    return false;
+                continue;
+            }
+            QueryStep_t* step = query_add_step(query, QUERY_KEY);
+            if (!step || !lexer_name(lexer, &step->key))
+                return false;
+        } else if (lexer_accept(lexer, '[')) {
+            if (!compile_bracket(lexer, query))
+                return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// RFC 6901, "*" segments act as wildcards
+static bool compile_pointer(QueryLexer_t* lexer, JsonQuery_t* query)
+{
+    while (lexer_accept(lexer, '/')) {
+        size_t start = lexer->pos;
+        size_t end = start;
+        while (lexer->text[end] && lexer->text[end] != '/')
+            end++;
+        lexer->pos = end;
+        if (end - start == 1 && lexer->text[start] == '*') {
+            if (!query_add_step(query, QUERY_WILDCARD))
+                return false;
+            continue;
+        }
+
+        QueryStep_t* step = query_add_step(query, QUERY_KEY);
+        char* str = step ? (char*)jc_mem_alloc(end - start + 1) : NULL;
+        if (!str)
+            return false;
+        size_t len = 0;
+        for (size_t i = start; i < end; i++) {
+            char ch = lexer->text[i];
+            if (ch == '~') {
+                if (i + 1 == end || (lexer->text[i + 1] != '0' && lexer->text[i + 1] != '1')) {
+                    jc_mem_free(str);
+                    return false;
+                }
+                ch = lexer->text[++i] == '0' ? '~' : '/';
+            }
+            str[len++] = ch;
+        }
+        str[len] = '\0';
+        step->key = (JsonKey_t) { str, len, jc_key_hash(str, len) };
+
+        // Array indices are digits without leading zeros
+        step->has_index = len > 0 && (len == 1 || str[0] != '0');
+        for (size_t i = 0; step->has_index && i < len; i++) {
+            step->has_index = str[i] >= '0' && str[i] <= '9' && step->index <= (INT64_MAX - 9) / 10;
+            step->index = step->index * 10 + (str[i] - '0');
+        }
+    }
+    return lexer_peek(lexer) == '\0';
+}
+
+JsonQuery_t* jc_query_compile(const char* expr)
+{
+    if (!expr)
+        return NULL;
+    JsonQuery_t* query = (JsonQuery_t*)jc_mem_calloc(sizeof(JsonQuery_t));
+    if (!query)
+        return NULL;
+    QueryLexer_t lexer = { .text = expr };
+    bool success = expr[0] == '$' ? compile_path(&lexer, query) : compile_pointer(&lexer, query);
+    if (!success) {
+        jc_query_free(query);
+        return NULL;
+    }
+    return query;
+}
+
+void jc_query_free(JsonQuery_t* query)
+{
+    if (!query)
+        return;
+    for (size_t i = 0; i < query->step_count; i++) {
+        QueryStep_t* step = &query->steps[i];
+        jc_mem_free((char*)step->key.str);
+        for (size_t k = 0; k < step->path_len; k++)
+            jc_mem_free((char*)step->path[k].str);
+        jc_mem_free(step->path);
+        if (step->literal.ty == JC_STRING)
+            jc_mem_free(step->literal.string);
+    }
+    jc_mem_free(query->steps);
+    jc_mem_free(query);
+}
+
+/*
+ *   Evaluation
+ */
+
+typedef struct {
+    const JsonQuery_t* query;
+    JsonQueryCallback_t callback;
+    void* ctx;
+    size_t matches;
+    bool stopped;
+} QueryRun_t;
+
+static int compare_numbers(const JsonValue_t* a, const JsonValue_t* b)
+{
+    if (a->ty == JC_INT64 && b->ty == JC_INT64)
+        return (a->num_int64 > b->num_int64) - (a->num_int64 < b->num_int64);
+    double lhs = a->ty == JC_INT64 ? (double)a->num_int64 : a->num_double;
+    double rhs = b->ty == JC_INT64 ? (double)b->num_int64 : b->num_double;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// value is what the filter path leads to, len is the byte length of string values
+static bool filter_compare(const QueryStep_t* step, const JsonValue_t* value, size_t len)
+{
+    if (step->op == QUERY_OP_EXISTS)
+        return true;
+
+    const JsonValue_t* literal = &step->literal;
+    bool lhs_number = value->ty == JC_INT64 || value->ty == JC_DOUBLE;
+    bool rhs_number = literal->ty == JC_INT64 || literal->ty == JC_DOUBLE;
+    int order;
+    if (lhs_number && rhs_number) {
+        order = compare_numbers(value, literal);
+    } else if (value->ty == JC_STRING && literal->ty == JC_STRING) {
+        // Strings may contain NUL bytes, the shorter one orders first on a common prefix
+        size_t common = len < step->literal_len ? len : step->literal_len;
+        order = memcmp(value->string, literal->string, common);
+        if (order == 0)
+            order = (len > step->literal_len) - (len < step->literal_len);
+    } else if (value->ty != literal->ty) {
+        return step->op == QUERY_OP_NE;
+    } else if (value->ty == JC_BOOLEAN || value->ty == JC_NULL_LITERAL) {
+        // Only equality is defined for these
+        bool equal = value->ty == JC_NULL_LITERAL || value->boolean == literal->boolean;
+        return step->op == QUERY_OP_EQ ? equal : step->op == QUERY_OP_NE && !equal;
+    } else {
+        return step->op == QUERY_OP_NE;
+    }
+
+    switch (step->op) {
+    case QUERY_OP_EQ:
+        return order == 0;
+    case QUERY_OP_NE:
+        return order != 0;
+    case QUERY_OP_LT:
+        return order < 0;
+    case QUERY_OP_LE:
+        return order <= 0;
+    case QUERY_OP_GT:
+        return order > 0;
+    case QUERY_OP_GE:
+        return order >= 0;
+    case QUERY_OP_EXISTS:
+        break;
+    }
+    return true;
+}
+
+static bool filter_matches(const QueryStep_t* step, const JsonValue_t* value)
+{
+    for (size_t i = 0; value && i < step->path_len; i++)
+        value = value->ty == JC_OBJECT ? jc_obj_get_k(value->object, step->path[i]) : NULL;
+    if (!value)
+        return false;
+
+    // Raw numbers and strings are compared by their converted value
+    JsonValue_t plain = { .ty = JC_NULL_LITERAL };
+    size_t len = 0;
+    if (value->ty == JC_STRING || value->ty == JC_STRING_RAW) {
+        plain.ty = JC_STRING;
+        plain.string = (char*)jc_value_get_string_len(value, &len);
+        if (!plain.string)
+            return false;
+        value = &plain;
+    } else if (value->ty == JC_NUMBER_RAW) {
+        plain.ty = jc_value_number_type(value);
+        bool converted = plain.ty == JC_INT64 ? jc_value_get_int64(value, &plain.num_int64) : jc_value_get_double(value, &plain.num_double);
+        if (!converted)
+            return false;
+        value = &plain;
+    }
+    return filter_compare(step, value, len);
+}
+
+static void query_eval(QueryRun_t* run, size_t step_index, JsonValue_t* value);
+
+static void query_eval_children(QueryRun_t* run, size_t step_index, JsonValue_t* value, const QueryStep_t* filter)
+{
+    if (value->ty == JC_ARRAY) {
+        size_t size = jc_arr_size(value->array);
+        for (size_t i = 0; i < size && !run->stopped; i++) {
+            JsonValue_t* child = jc_arr_at(value->array, i);
+            if (!filter || filter_matches(filter, child))
+                query_eval(run, step_index, child);
+        }
+    } else if (value->ty == JC_OBJECT) {
+        JsonObjectIter_t iter = jc_obj_iter(value->object);
+        for (JsonValue_t* child = jc_obj_iter_value(&iter); child && !run->stopped;
+             jc_obj_iter_next(&iter), child = jc_obj_iter_value(&iter)) {
+            if (!filter || filter_matches(filter, child))
+                query_eval(run, step_index, child);
+        }
+    }
+}
+
+// Python style slice bounds, negative values count from the end
+static void query_eval_slice(QueryRun_t* run, size_t step_index, JsonArray_t* arr, const QueryStep_t* step)
+{
+    int64_t size = (int64_t)jc_arr_size(arr);
+    int64_t start = step->index;
+    int64_t end = step->end;
+    if (step->step > 0) {
+        start = !step->has_start ? 0 : start < 0 ? (start + size < 0 ? 0 : start + size) : (start > size ? size : start);
+        end = !step->has_end ? size : end < 0 ? (end + size < 0 ? 0 : end + size) : (end > size ? size : end);
+        // The next index is checked against end before stepping, huge steps would overflow
+        for (int64_t i = start; i < end && !run->stopped; i += step->step) {
+            query_eval(run, step_index, jc_arr_at(arr, (size_t)i));
+            if (end - i <= step->step)
+                break;
+        }
+    } else {
+        start = !step->has_start ? size - 1 : start < 0 ? (start + size < -1 ? -1 : start + size) : (start >= size ? size - 1 : start);
+        end = !step->has_end ? -1 : end < 0 ? (end + size < -1 ? -1 : end + size) : (end >= size ? size - 1 : end);
+        for (int64_t i = start; i > end && !run->stopped; i += step->step) {
+            query_eval(run, step_index, jc_arr_at(arr, (size_t)i));
+            if (step->step <= end - i)
+                break;
+        }
+    }
+}
+
+static void query_eval(QueryRun_t* run, size_t step_index, JsonValue_t* value)
+{
+    if (step_index == run->query->step_count) {
+        run->matches++;
+        if (run->callback && !run->callback(value, run->ctx))
+            run->stopped = true;
+        return;
+    }
+
+    const QueryStep_t* step = &run->query->steps[step_index];
+    switch (step->kind) {
+    case QUERY_KEY: {
+        JsonValue_t* child = NULL;
+        if (value->ty == JC_OBJECT)
+            child = jc_obj_get_k(value->object, step->key);
+        else if (value->ty == JC_ARRAY && step->has_index && (uint64_t)step->index < jc_arr_size(value->array))
+            child = jc_arr_at(value->array, (size_t)step->index);
+        if (child)
+            query_eval(run, step_index + 1, child);
+        break;
+    }
+    case QUERY_INDEX:
+        if (value->ty == JC_ARRAY) {
+            int64_t size = (int64_t)jc_arr_size(value->array);
+            int64_t index = step->index < 0 ? step->index + size : step->index;
+            if (index >= 0 && index < size)
+                query_eval(run, step_index + 1, jc_arr_at(value->array, (size_t)index));
+        }
+        break;
+    case QUERY_WILDCARD:
+        query_eval_children(run, step_index + 1, value, NULL);
+        break;
+    case QUERY_SLICE:
+        if (value->ty == JC_ARRAY)
+            query_eval_slice(run, step_index + 1, value->array, step);
+        break;
+    case QUERY_FILTER:
+        query_eval_children(run, step_index + 1, value, step);
+        break;
+    }
+}
+
+size_t jc_query_run(const JsonQuery_t* query, const JsonDocument_t* doc, JsonQueryCallback_t callback, void* ctx)
+{
+    if (!query || !doc)
+        return 0;
+    // The root is only wrapped for the walk, it is not part of the document
+    JsonValue_t root = { .ty = JC_NULL_LITERAL };
+    if (jc_doc_is_obj(doc)) {
+        root.ty = JC_OBJECT;
+        root.object = jc_doc_get_obj(doc);
+    } else if (jc_doc_is_arr(doc)) {
+        root.ty = JC_ARRAY;
+        root.array = jc_doc_get_arr(doc);
+    } else {
+        return 0;
+    }
+    return jc_query_run_value(query, &root, callback, ctx);
+}
+
+size_t jc_query_run_value(const JsonQuery_t* query, JsonValue_t* value, JsonQueryCallback_t callback, void* ctx)
+{
+    if (!query || !value)
+        return 0;
+    QueryRun_t run = { .query = query, .callback = callback, .ctx = ctx };
+    query_eval(&run, 0, value);
+    return run.matches;
+}
+
+/*
+ *   Streaming
+ *
+ * Matches a compiled query against raw input without building anything. Only the path leading to
+ * the steps of the query is followed, every other value is passed over by the skipper. Filters
+ * scan the element a second time before it is entered.
+ */
+
+typedef struct {
+    const JsonQuery_t* query;
+    JsonParser_t parser;
+    // Unescaped keys and strings compared by filters
+    StringBuilder_t scratch;
+    JsonStreamCallback_t callback;
+    void* ctx;
+    size_t matches;
+    bool stopped;
+} QueryStream_t;
+
+// Array lengths are unknown while streaming, so positions can't count from the end
+static bool query_streamable(const JsonQuery_t* query)
+{
+    for (size_t i = 0; i < query->step_count; i++) {
+        const QueryStep_t* step = &query->steps[i];
+        if (step->kind == QUERY_INDEX && step->index < 0)
+            return false;
+        if (step->kind == QUERY_SLICE && (step->step < 0 || step->index < 0 || (step->has_end && step->end < 0)))
+            return false;
+    }
+    return true;
+}
+
+// Reads a key, pointing into the input when it has no escape sequences
+static bool stream_read_key(QueryStream_t* stream, JsonParser_t* parser, const char** key, size_t* len)
+{
+    size_t start = parser->pos + 1;
+    if (!parser_skip_string(parser))
+        return parser_fail(parser, JC_PARSE_SYNTAX_ERROR);
+    *key = &parser->text[start];
+    *len = parser->pos - 1 - start;
+    if (!memchr(*key, '\\', *len))
+        return true;
+
+    parser->pos = start - 1;
+    builder_reset(&stream->scratch);
+    if (!parse_and_unescape_str(parser, &stream->scratch))
+        return parser_fail(parser, JC_PARSE_SYNTAX_ERROR);
+    *key = stream->scratch.buffer;
+    *len = stream->scratch.pos;
+    return true;
+}
+
+static inline bool stream_expect(JsonParser_t* parser, const char* token)
+{
+    ignore_whitespace(parser);
+    if (!parser_consume_specific(parser, token, 1))
+        return parser_fail(parser, JC_PARSE_SYNTAX_ERROR);
+    ignore_whitespace(parser);
+    return true;
+}
+
+// Follows the filter path through the element starting at the parser position and compares the
+// value found there, the parser is a copy and can be left anywhere
+static bool stream_filter_matches(QueryStream_t* stream, const QueryStep_t* step, JsonParser_t parser)
+{
+    for (size_t i = 0; i < step->path_len; i++) {
+        if (!parser_consume_specific(&parser, "{", 1))
+            return false;
+        for (;;) {
+            ignore_whitespace(&parser);
+            const char* key;
+            size_t len;
+            if (parser_peek(&parser, 0) != '"' || !stream_read_key(stream, &parser, &key, &len) || !stream_expect(&parser, ":"))
+                return false;
+            if (len == step->path[i].len && memcmp(key, step->path[i].str, len) == 0)
+                break;
+            if (!parser_skip_value(&parser))
+                return false;
+            ignore_whitespace(&parser);
+            if (!parser_consume_specific(&parser, ",", 1))
+                return false;
+        }
+    }
+
+    JsonValue_t value = { .ty = JC_NULL_LITERAL };
+    size_t len = 0;
+    JsonNumberToken_t token;
+    char ch = parser_peek(&parser, 0);
+    if (ch == '"') {
+        builder_reset(&stream->scratch);
+        if (!parse_and_unescape_str(&parser, &stream->scratch))
+            return false;
+        value.ty = JC_STRING;
+        value.string = stream->scratch.buffer;
+        len = stream->scratch.pos;
+    } else if (ch == '-' || is_digit(ch)) {
+        if (!parse_number_token(&parser, &token))
+            return false;
+        value.ty = token.is_double ? JC_DOUBLE : JC_INT64;
+        if (token.is_double)
+            value.num_double = token.num_double;
+        else
+            value.num_int64 = token.num_int64;
+    } else if (parser_consume_specific(&parser, "true", 4) || parser_consume_specific(&parser, "false", 5)) {
+        value.ty = JC_BOOLEAN;
+        value.boolean = ch == 't';
+    } else if (ch == '{' || ch == '[') {
+        // Containers are never equal to a literal
+        return step->op == QUERY_OP_EXISTS || step->op == QUERY_OP_NE;
+    } else if (!parser_consume_specific(&parser, "null", 4)) {
+        return false;
+    }
+    return filter_compare(step, &value, len);
+}
+
+static bool stream_value(QueryStream_t* stream, size_t step_index);
+
+// Decides whether the child at index (or with the given key) continues the query
+static bool stream_child(QueryStream_t* stream, size_t step_index, const char* key, size_t len, size_t index)
+{
+    const QueryStep_t* step = &stream->query->steps[step_index];
+    bool matches = false;
+    switch (step->kind) {
+    case QUERY_KEY:
+        matches = key ? len == step->key.len && memcmp(key, step->key.str, len) == 0
+                      : step->has_index && (uint64_t)step->index == index;
+        break;
+    case QUERY_INDEX:
+        matches = !key && (uint64_t)step->index == index;
+        break;
+    case QUERY_WILDCARD:
+        matches = true;
+        break;
+    case QUERY_SLICE: {
+        uint64_t start = step->has_start ? (uint64_t)step->index : 0;
+        matches = !key && index >= start && (!step->has_end || index < (uint64_t)step->end)
+            && (index - start) % (uint64_t)step->step == 0;
+        break;
+    }
+    case QUERY_FILTER:
+        matches = stream_filter_matches(stream, step, stream->parser);
+        break;
+    }
+    if (!matches || stream->stopped)
+        return parser_skip_value(&stream->parser) || parser_fail(&stream->parser, JC_PARSE_SYNTAX_ERROR);
+    return stream_value(stream, step_index + 1);
+}
+
+// Matched scalars are checked like the parser does, matched containers only for their structure
+static bool stream_skip_match(JsonParser_t* parser)
+{
+    char ch = parser_peek(parser, 0);
+    bool scanned;
+    if (ch == '{' || ch == '[') {
+        return parser_skip_value(parser);
+    } else if (ch == '"') {
+        bool has_escapes;
+        scanned = parser_scan_string(parser, &has_escapes);
+    } else if (ch == '-' || is_digit(ch)) {
+        bool is_double;
+        scanned = parser_scan_number(parser, &is_double);
+    } else {
+        scanned = parser_consume_specific(parser, "true", 4) || parser_consume_specific(parser, "false", 5)
+            || parser_consume_specific(parser, "null", 4);
+    }
+    // Scalars have to be followed by whatever may come after a value, "1x" or "truex" are rejected
+    ch = parser_peek(parser, 0);
+    return scanned && (parser_eof(parser) || is_space(ch) || ch == ',' || ch == ']' || ch == '}');
+}
+
+static bool stream_value(QueryStream_t* stream, size_t step_index)
+{
+    JsonParser_t* parser = &stream->parser;
+    ignore_whitespace(parser);
+    size_t start = parser->pos;
+    if (step_index == stream->query->step_count) {
+        if (!stream_skip_match(parser))
+            return parser_fail(parser, JC_PARSE_SYNTAX_ERROR);
+        stream->matches++;
+        if (stream->callback && !stream->callback(&parser->text[start], parser->pos - start, stream->ctx))
+            stream->stopped = true;
+        return true;
+    }
+
+    char ch = parser_peek(parser, 0);
+    if (ch != '{' && ch != '[')
+        return parser_skip_value(parser) || parser_fail(parser, JC_PARSE_SYNTAX_ERROR);
+    bool is_obj = ch == '{';
+    const char* close = is_obj ? "}" : "]";
+    parser->pos++;
+    ignore_whitespace(parser);
+    if (parser_consume_specific(parser, close, 1))
+        return true;
+
+    for (size_t index = 0;; index++) {
+        const char* key = NULL;
+        size_t len = 0;
+        if (is_obj) {
+            ignore_whitespace(parser);
+            if (!stream_read_key(stream, parser, &key, &len) || !stream_expect(parser, ":"))
+                return false;
+        }
+        if (!stream_child(stream, step_index, key, len, index))
+            return false;
+        ignore_whitespace(parser);
+        if (parser_consume_specific(parser, close, 1))
+            return true;
+        if (!stream_expect(parser, ","))
+            return false;
+    }
+}
+
+size_t jc_query_stream(const JsonQuery_t* query, const char* buf, size_t len, JsonStreamCallback_t callback, void* ctx, JsonParseError_t* error)
+{
+    QueryStream_t stream = { .query = query, .parser = { .text = buf, .len = len }, .scratch = { .scoped = true }, .callback = callback, .ctx = ctx };
+    JsonParser_t* parser = &stream.parser;
+    if (!query || !buf) {
+        parser_fail(parser, JC_PARSE_SYNTAX_ERROR);
+        goto EXIT;
+    }
+    if (!query_streamable(query)) {
+        parser_fail(parser, JC_PARSE_UNSUPPORTED_QUERY);
+        goto EXIT;
+    }
+    if (!builder_resize(&stream.scratch, 64)) {
+        parser_fail(parser, JC_PARSE_OUT_OF_MEMORY);
+        goto EXIT;
+    }
+
+    // Consecutive root values (NDJSON) are matched one after the other
+    ignore_whitespace(parser);
+    while (!parser_eof(parser) && !stream.stopped) {
+        if (!stream_value(&stream, 0)) {
+            parser_fail(parser, JC_PARSE_SYNTAX_ERROR);
+            break;
+        }
+        ignore_whitespace(parser);
+    }
+    JC_STATS_ADD(bytes_scanned, parser->pos);
+
+EXIT:
+    builder_free(&stream.scratch);
+    if (error)
+        *error = parser->error;
+    return stream.matches;
+}
@@ -0,0 +1,94 @@
+#include <jc_stats.h>
+#include <string.h>
+
+#ifdef JC_STATS
+#    include <pthread.h>
+#    include <stdlib.h>
+
+#    define STATS_COUNTERS (sizeof(JsonStats_t) / sizeof(uint64_t))
+_Static_assert(sizeof(JsonStats_t) % sizeof(uint64_t) == 0, "JsonStats_t must only hold uint64_t counters");
+
+typedef struct ThreadStats_t {
+    JsonStats_t stats;
+    struct ThreadStats_t* previous;
+    struct ThreadStats_t* next;
+} ThreadStats_t;
+
+_Thread_local JsonStats_t* jc_stats_thread = NULL;
+
+static pthread_mutex_t s_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t s_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t s_stats_key;
+static ThreadStats_t* s_stats_threads = NULL;
+// Counters of threads which already exited
+static JsonStats_t s_stats_retired;
+
+static void stats_accumulate(JsonStats_t* total, const JsonStats_t* stats)
+{
+    uint64_t* dst = (uint64_t*)total;
+    const uint64_t* src = (const uint64_t*)stats;
+    for (size_t i = 0; i < STATS_COUNTERS; i++)
+        dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+}
+
+static void stats_thread_exit(void* data)
+{
+    ThreadStats_t* thread = (ThreadStats_t*)data;
+    pthread_mutex_lock(&s_stats_lock);
+    stats_accumulate(&s_stats_retired, &thread->stats);
+    if (thread->previous)
+        thread->previous->next = thread->next;
+    else
+        s_stats_threads = thread->next;
+    if (thread->next)
+        thread->next->previous = thread->previous;
+    pthread_mutex_unlock(&s_stats_lock);
+    free(thread);
+}
+
+static void stats_create_key(void)
+{
+    pthread_key_create(&s_stats_key, stats_thread_exit);
+}
+
+JsonStats_t* jc_stats_register_thread(void)
+{
+    pthread_once(&s_stats_once, stats_create_key);
+    ThreadStats_t* thread = (ThreadStats_t*)calloc(1, sizeof(ThreadStats_t));
+    if (!thread)
+        return NULL;
+
+    pthread_mutex_lock(&s_stats_lock);
+    thread->next = s_stats_threads;
+    if (s_stats_threads)
+        s_stats_threads->previous = thread;
+    s_stats_threads = thread;
+    pthread_mutex_unlock(&s_stats_lock);
+
+    pthread_setspecific(s_stats_key, thread);
+    jc_stats_thread = &thread->stats;
+    return jc_stats_thread;
+}
+
+bool jc_stats_snapshot(JsonStats_t* stats)
+{
+    if (!stats)
+        return false;
+    pthread_mutex_lock(&s_stats_lock);
+    *stats = s_stats_retired;
+    for (ThreadStats_t* thread = s_stats_threads; thread; thread = thread->next)
+        stats_accumulate(stats, &thread->stats);
+    pthread_mutex_unlock(&s_stats_lock);
+    return true;
+}
+
+#else
+
+bool jc_stats_snapshot(JsonStats_t* stats)
+{
+    if (stats)
+        memset(stats, 0, sizeof(*stats));
+    return false;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef JC_STATS__
+#define JC_STATS__
+
+#include <jc.h>
+#include <stdint.h>
+
+/*
+ * Counters are kept per thread and only written by their own thread. Relaxed atomic loads and
+ * stores keep concurrent snapshots well defined without a locked read-modify-write.
+ * Without JC_STATS all of this compiles to nothing.
+ */
+#ifdef JC_STATS
+extern _Thread_local JsonStats_t* jc_stats_thread;
+JsonStats_t* jc_stats_register_thread(void);
+
+static inline JsonStats_t* jc_stats_local(void)
+{
+    return jc_stats_thread ? jc_stats_thread : jc_stats_register_thread();
+}
+
+static inline void jc_stats_add(uint64_t* counter, uint64_t n)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline size_t jc_stats_probe_bucket(size_t probes)
+{
+    size_t bucket = 0;
+    while (probes > 1 && bucket < JC_STATS_PROBE_BUCKETS - 1) {
+        probes >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+#    define JC_STATS_ONLY(...) __VA_ARGS__
+#    define JC_STATS_ADD(FIELD, N)                                     \
+        do {                                                           \
+            JsonStats_t* jc_stats = jc_stats_local();                  \
+            if (jc_stats)                                              \
+                jc_stats_add(&jc_stats->FIELD, (uint64_t)(N));         \
+        } while (0)
+#    define JC_STATS_PROBES(HISTOGRAM, PROBES) JC_STATS_ADD(HISTOGRAM[jc_stats_probe_bucket(PROBES)], 1)
+#else
+#    define JC_STATS_ONLY(...)
+#    define JC_STATS_ADD(FIELD, N) ((void)0)
+#    define JC_STATS_PROBES(HISTOGRAM, PROBES) ((void)0)
+#endif
+
+#endif
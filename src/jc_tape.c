@@ -0,0 +1,1067 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <jc.h>
+#include <jc_alloc.h>
+#include <jc_parser.h>
+#include <jc_stats.h>
+#include <olh_map.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string_builder.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef JC_INIT_TAPE_CAPACITY
+#    define JC_INIT_TAPE_CAPACITY 64
+#endif
+
+#ifndef JC_TAPE_INDEX_MIN_MEMBERS
+#    define JC_TAPE_INDEX_MIN_MEMBERS 8
+#endif
+
+#ifndef JC_TAPE_SAVE_CHUNK
+#    define JC_TAPE_SAVE_CHUNK 4096
+#endif
+
+// Building and reading tapes recurses per container, deeper input is rejected like in the binary readers
+#ifndef JC_TAPE_MAX_DEPTH
+#    define JC_TAPE_MAX_DEPTH 256
+#endif
+
+/*
+ * Every tape word carries a type tag in its upper 8 bits and a 56 bit payload:
+ *   '{' / '['  low 32 bits: index one past the matching close word, upper 24 bits: member count
+ *   '}' / ']'  index of the matching open word
+ *   '"'        offset of the string in the string buffer (uint32_t length, bytes, '\0')
+ *   'l' / 'd'  payload unused, the following word holds the raw int64/double bits
+ *   't' 'f' 'n'
+ * Object members are stored as a key string word followed by the value.
+ *
+ * Binary images store the header, the tape words, the key index and the string buffer back
+ * to back. In an image the payload of '}' is the offset + 1 of the object's key hash table
+ * in the index (0 if the object has none). A table is a uint32_t capacity followed by
+ * capacity slots holding the key word index relative to the object, 0 marks an empty slot.
+ */
+#define TAPE_TAG_SHIFT 56
+#define TAPE_PAYLOAD_MASK ((UINT64_C(1) << TAPE_TAG_SHIFT) - 1)
+#define TAPE_END_MASK UINT64_C(0xffffffff)
+#define TAPE_COUNT_SHIFT 32
+#define TAPE_COUNT_MAX UINT64_C(0xffffff)
+#define TAPE_IMAGE_MAGIC UINT64_C(0x313045504154434a) // "JCTAPE01"
+
+struct JsonTape_t {
+    const uint64_t* words;
+    size_t size;
+    size_t capacity;
+    const char* strings;
+    size_t strings_len;
+    const uint32_t* index;
+    size_t index_len;
+    void* mapping;
+    size_t mapping_len;
+    uint64_t storage[];
+};
+
+typedef struct {
+    JsonTape_t* tape;
+    StringBuilder_t strings;
+    size_t depth;
+} TapeWriter_t;
+
+typedef struct {
+    uint64_t magic;
+    uint64_t word_count;
+    uint64_t index_len;
+    uint64_t strings_len;
+} TapeImageHeader_t;
+
+typedef struct {
+    uint32_t* data;
+    size_t size;
+    size_t capacity;
+} TapeIndex_t;
+
+static inline uint8_t tape_tag(uint64_t word) { return (uint8_t)(word >> TAPE_TAG_SHIFT); }
+
+static inline uint64_t tape_payload(uint64_t word) { return word & TAPE_PAYLOAD_MASK; }
+
+static inline uint64_t tape_word(char tag, uint64_t payload)
+{
+    return ((uint64_t)(uint8_t)tag << TAPE_TAG_SHIFT) | (payload & TAPE_PAYLOAD_MASK);
+}
+
+static inline size_t tape_skip(const JsonTape_t* tape, size_t index)
+{
+    uint64_t word = tape->words[index];
+    switch (tape_tag(word)) {
+    case '{':
+    case '[':
+        return (size_t)(word & TAPE_END_MASK);
+    case 'l':
+    case 'd':
+        return index + 2;
+    default:
+        return index + 1;
+    }
+}
+
+/*
+ *   Tape construction
+ */
+
+static bool writer_init(TapeWriter_t* writer)
+{
+    writer->tape = (JsonTape_t*)jc_mem_alloc(sizeof(JsonTape_t) + JC_INIT_TAPE_CAPACITY * sizeof(uint64_t));
+    if (!writer->tape)
+        return false;
+    *writer->tape = (JsonTape_t) { .capacity = JC_INIT_TAPE_CAPACITY };
+    writer->depth = 0;
+    writer->strings = (StringBuilder_t) { .scoped = true };
+    if (!builder_resize(&writer->strings, 64)) {
+        jc_mem_free(writer->tape);
+        return false;
+    }
+    return true;
+}
+
+static JsonTape_t* writer_finish(TapeWriter_t* writer)
+{
+    JsonTape_t* tape = writer->tape;
+    tape->words = tape->storage;
+    tape->strings = writer->strings.buffer;
+    tape->strings_len = writer->strings.pos;
+    return tape;
+}
+
+static void writer_abort(TapeWriter_t* writer)
+{
+    builder_free(&writer->strings);
+    jc_mem_free(writer->tape);
+}
+
+static bool writer_push(TapeWriter_t* writer, uint64_t word)
+{
+    JsonTape_t* tape = writer->tape;
+    if (tape->size == tape->capacity) {
+        if (tape->capacity > TAPE_END_MASK)
+            return false;
+        JsonTape_t* new_tape = (JsonTape_t*)jc_mem_realloc(tape, sizeof(JsonTape_t) + tape->capacity * 2 * sizeof(uint64_t));
+        if (!new_tape)
+            return false;
+        new_tape->capacity *= 2;
+        writer->tape = tape = new_tape;
+    }
+    tape->storage[tape->size++] = word;
+    return true;
+}
+
+static bool writer_push_raw(TapeWriter_t* writer, char tag, const void* raw)
+{
+    uint64_t bits;
+    memcpy(&bits, raw, sizeof(bits));
+    return writer_push(writer, tape_word(tag, 0)) && writer_push(writer, bits);
+}
+
+static bool writer_begin_string(TapeWriter_t* writer, size_t* start)
+{
+    *start = writer->strings.pos;
+    return writer_push(writer, tape_word('"', *start)) && builder_append_chrs(&writer->strings, '\0', sizeof(uint32_t));
+}
+
+static bool writer_end_string(TapeWriter_t* writer, size_t start)
+{
+    size_t len = writer->strings.pos - start - sizeof(uint32_t);
+    if (len > UINT32_MAX)
+        return false;
+    uint32_t len32 = (uint32_t)len;
+    memcpy(&writer->strings.buffer[start], &len32, sizeof(len32));
+    return builder_append_ch(&writer->strings, '\0');
+}
+
+static bool writer_push_string(TapeWriter_t* writer, const char* str)
+{
+    size_t start;
+    if (!writer_begin_string(writer, &start))
+        return false;
+    if (!builder_append_str(&writer->strings, str, strlen(str)))
+        return false;
+    return writer_end_string(writer, start);
+}
+
+static bool writer_open(TapeWriter_t* writer, char tag, size_t* start)
+{
+    if (writer->depth == JC_TAPE_MAX_DEPTH)
+        return false;
+    writer->depth++;
+    *start = writer->tape->size;
+    return writer_push(writer, tape_word(tag, 0));
+}
+
+static bool writer_close(TapeWriter_t* writer, char tag, size_t start, size_t count)
+{
+    writer->depth--;
+    if (!writer_push(writer, tape_word(tag, start)))
+        return false;
+    uint64_t end = writer->tape->size;
+    if (end > TAPE_END_MASK)
+        return false;
+    uint64_t saturated = count < TAPE_COUNT_MAX ? count : TAPE_COUNT_MAX;
+    uint64_t* open = &writer->tape->storage[start];
+    *open = tape_word((char)tape_tag(*open), (saturated << TAPE_COUNT_SHIFT) | end);
+    return true;
+}
+
+static bool tape_parse_value(JsonParser_t* parser, TapeWriter_t* writer);
+
+static bool tape_parse_string(JsonParser_t* parser, TapeWriter_t* writer)
+{
+    size_t start;
+    if (!writer_begin_string(writer, &start))
+        return false;
+    if (!parse_and_unescape_str(parser, &writer->strings))
+        return false;
+    return writer_end_string(writer, start);
+}
+
+static bool tape_parse_obj(JsonParser_t* parser, TapeWriter_t* writer)
+{
+    size_t start, count = 0;
+    if (!parser_consume_specific(parser, "{", 1) || !writer_open(writer, '{', &start))
+        return false;
+
+    for (;;) {
+        ignore_whitespace(parser);
+        if (parser_peek(parser, 0) == '}')
+            break;
+
+        if (!tape_parse_string(parser, writer))
+            return false;
+        ignore_whitespace(parser);
+
+        if (!parser_consume_specific(parser, ":", 1))
+            return false;
+        ignore_whitespace(parser);
+
+        if (!tape_parse_value(parser, writer))
+            return false;
+        count++;
+        ignore_whitespace(parser);
+        if (parser_peek(parser, 0) == '}')
+            break;
+
+        if (!parser_consume_specific(parser, ",", 1))
+            return false;
+        ignore_whitespace(parser);
+
+        if (parser_peek(parser, 0) == '}')
+            return false;
+    }
+
+    if (!parser_consume_specific(parser, "}", 1))
+        return false;
+    return writer_close(writer, '}', start, count);
+}
+
+static bool tape_parse_arr(JsonParser_t* parser, TapeWriter_t* writer)
+{
+    size_t start, count = 0;
+    if (!parser_consume_specific(parser, "[", 1) || !writer_open(writer, '[', &start))
+        return false;
+
+    for (;;) {
+        ignore_whitespace(parser);
+        if (parser_peek(parser, 0) == ']')
+            break;
+
+        if (!tape_parse_value(parser, writer))
+            return false;
+        count++;
+        ignore_whitespace(parser);
+
+        if (parser_peek(parser, 0) == ']')
+            break;
+
+        if (!parser_consume_specific(parser, ",", 1))
+            return false;
+        ignore_whitespace(parser);
+
+        if (parser_peek(parser, 0) == ']')
+            return false;
+    }
+
+    if (!parser_consume_specific(parser, "]", 1))
+        return false;
+    return writer_close(writer, ']', start, count);
+}
+
+static bool tape_parse_value(JsonParser_t* parser, TapeWriter_t* writer)
+{
+    ignore_whitespace(parser);
+    switch (parser_peek(parser, 0)) {
+    case '{':
+        return tape_parse_obj(parser, writer);
+    case '[':
+        return tape_parse_arr(parser, writer);
+    case '"':
+        return tape_parse_string(parser, writer);
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9': {
+        JsonNumberToken_t token;
+        if (!parse_number_token(parser, &token))
+            return false;
+        if (token.is_double)
+            return writer_push_raw(writer, 'd', &token.num_double);
+        return writer_push_raw(writer, 'l', &token.num_int64);
+    }
+    case 'f':
+        return parser_consume_specific(parser, "false", 5) && writer_push(writer, tape_word('f', 0));
+    case 't':
+        return parser_consume_specific(parser, "true", 4) && writer_push(writer, tape_word('t', 0));
+    case 'n':
+        return parser_consume_specific(parser, "null", 4) && writer_push(writer, tape_word('n', 0));
+    }
+    return false;
+}
+
+JsonTape_t* jc_tape_from_string(const char* str)
+{
+    if (!str)
+        return NULL;
+    JsonParser_t parser = { .text = str, .pos = 0, .len = strlen(str) };
+    TapeWriter_t writer;
+    if (!writer_init(&writer))
+        return NULL;
+
+    ignore_whitespace(&parser);
+    char type_hint = parser_peek(&parser, 0);
+    if (type_hint != '{' && type_hint != '[')
+        goto EXIT_ERROR;
+    if (!tape_parse_value(&parser, &writer))
+        goto EXIT_ERROR;
+    // Check if all input was consumed
+    ignore_whitespace(&parser);
+    if (!parser_eof(&parser))
+        goto EXIT_ERROR;
+    JC_STATS_ADD(bytes_scanned, parser.pos);
+    return writer_finish(&writer);
+
+EXIT_ERROR:
+    JC_STATS_ADD(bytes_scanned, parser.pos);
+    writer_abort(&writer);
+    return NULL;
+}
+
+static bool tape_write_obj(TapeWriter_t* writer, const JsonObject_t* obj);
+static bool tape_write_arr(TapeWriter_t* writer, const JsonArray_t* arr);
+
+static bool tape_write_value(TapeWriter_t* writer, const JsonValue_t* value)
+{
+    switch (value->ty) {
+    case JC_STRING:
+        return writer_push_string(writer, value->string);
+    case JC_DOUBLE:
+        return writer_push_raw(writer, 'd', &value->num_double);
+    case JC_INT64:
+        return writer_push_raw(writer, 'l', &value->num_int64);
+    case JC_OBJECT:
+        return tape_write_obj(writer, value->object);
+    case JC_ARRAY:
+        return tape_write_arr(writer, value->array);
+    case JC_BOOLEAN:
+        return writer_push(writer, tape_word(value->boolean ? 't' : 'f', 0));
+    case JC_NULL_LITERAL:
+        return writer_push(writer, tape_word('n', 0));
+    case JC_NUMBER_RAW: {
+        int64_t i64;
+        double dbl;
+        if (jc_value_number_type(value) == JC_INT64 && jc_value_get_int64(value, &i64))
+            return writer_push_raw(writer, 'l', &i64);
+        return jc_value_get_double(value, &dbl) && writer_push_raw(writer, 'd', &dbl);
+    }
+    case JC_STRING_RAW: {
+        const char* str = jc_value_get_string(value);
+        return str && writer_push_string(writer, str);
+    }
+    }
+    return false;
+}
+
+static bool tape_write_obj(TapeWriter_t* writer, const JsonObject_t* obj)
+{
+    size_t start;
+    if (!writer_open(writer, '{', &start))
+        return false;
+    jc_obj_foreach(obj, key, value)
+    {
+        if (!writer_push_string(writer, key) || !tape_write_value(writer, value))
+            return false;
+    }
+    return writer_close(writer, '}', start, jc_obj_size(obj));
+}
+
+static bool tape_write_arr(TapeWriter_t* writer, const JsonArray_t* arr)
+{
+    size_t start;
+    if (!writer_open(writer, '[', &start))
+        return false;
+    jc_arr_foreach(arr, value)
+    {
+        if (!tape_write_value(writer, value))
+            return false;
+    }
+    return writer_close(writer, ']', start, jc_arr_size(arr));
+}
+
+JsonTape_t* jc_tape_from_doc(const JsonDocument_t* doc)
+{
+    if (!doc || (jc_doc_is_obj(doc) == jc_doc_is_arr(doc)))
+        return NULL;
+    TapeWriter_t writer;
+    if (!writer_init(&writer))
+        return NULL;
+    bool written = jc_doc_is_obj(doc) ? tape_write_obj(&writer, jc_doc_get_obj(doc))
+                                      : tape_write_arr(&writer, jc_doc_get_arr(doc));
+    if (!written) {
+        writer_abort(&writer);
+        return NULL;
+    }
+    return writer_finish(&writer);
+}
+
+static JsonObject_t* tape_read_obj(JsonTapeCursor_t cursor);
+static JsonArray_t* tape_read_arr(JsonTapeCursor_t cursor);
+
+static JsonValue_t* tape_read_value(JsonTapeCursor_t cursor)
+{
+    switch (jc_tape_type(cursor)) {
+    case JC_STRING:
+        return jc_new_value(JC_STRING, (void*)jc_tape_get_string(cursor, NULL));
+    case JC_DOUBLE: {
+        double dbl = 0;
+        jc_tape_get_double(cursor, &dbl);
+        return jc_new_double_value(dbl);
+    }
+    case JC_INT64: {
+        int64_t i64 = 0;
+        jc_tape_get_int64(cursor, &i64);
+        return jc_new_int64_value(i64);
+    }
+    case JC_OBJECT: {
+        JsonObject_t* obj = tape_read_obj(cursor);
+        if (!obj)
+            return NULL;
+        JsonValue_t* value = jc_new_value(JC_OBJECT, obj);
+        if (!value)
+            jc_free_obj(obj);
+        return value;
+    }
+    case JC_ARRAY: {
+        JsonArray_t* arr = tape_read_arr(cursor);
+        if (!arr)
+            return NULL;
+        JsonValue_t* value = jc_new_value(JC_ARRAY, arr);
+        if (!value)
+            jc_free_arr(arr);
+        return value;
+    }
+    case JC_BOOLEAN: {
+        bool b = false;
+        jc_tape_get_bool(cursor, &b);
+        return jc_new_bool_value(b);
+    }
+    case JC_NULL_LITERAL:
+        return jc_new_value(JC_NULL_LITERAL, NULL);
+    case JC_NUMBER_RAW:
+    case JC_STRING_RAW:
+        // Tapes hold converted numbers and decoded strings only
+        break;
+    }
+    return NULL;
+}
+
+static JsonObject_t* tape_read_obj(JsonTapeCursor_t cursor)
+{
+    JsonObject_t* obj = jc_new_obj_with_capacity(jc_tape_size(cursor));
+    if (!obj)
+        return NULL;
+    JsonTapeCursor_t member;
+    for (bool more = jc_tape_obj_first(cursor, &member); more; more = jc_tape_obj_next(&member)) {
+        JsonValue_t* value = tape_read_value(jc_tape_obj_value(member));
+        if (!value || !jc_obj_set(obj, jc_tape_obj_key(member), value)) {
+            jc_free_value(value);
+            jc_free_obj(obj);
+            return NULL;
+        }
+    }
+    return obj;
+}
+
+static JsonArray_t* tape_read_arr(JsonTapeCursor_t cursor)
+{
+    JsonArray_t* arr = jc_new_arr_with_capacity(jc_tape_size(cursor));
+    if (!arr)
+        return NULL;
+    JsonTapeCursor_t elem;
+    for (bool more = jc_tape_arr_first(cursor, &elem); more; more = jc_tape_arr_next(&elem)) {
+        JsonValue_t* value = tape_read_value(elem);
+        if (!value || !jc_arr_insert_value(arr, value)) {
+            jc_free_value(value);
+            jc_free_arr(arr);
+            return NULL;
+        }
+    }
+    return arr;
+}
+
+JsonDocument_t* jc_tape_to_doc(const JsonTape_t* tape)
+{
+    if (!tape || tape->size == 0)
+        return NULL;
+    JsonDocument_t* doc = jc_new_doc();
+    if (!doc)
+        return NULL;
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(jc_alloc_scope_of(doc));
+    JsonTapeCursor_t root = jc_tape_root(tape);
+    bool ok = false;
+    if (jc_tape_type(root) == JC_OBJECT) {
+        JsonObject_t* obj = tape_read_obj(root);
+        ok = obj && jc_doc_set_obj(doc, obj);
+    } else {
+        JsonArray_t* arr = tape_read_arr(root);
+        ok = arr && jc_doc_set_arr(doc, arr);
+    }
+    jc_alloc_scope_enter(previous_scope);
+    if (ok)
+        return doc;
+    jc_free_doc(doc);
+    return NULL;
+}
+
+void jc_free_tape(JsonTape_t* tape)
+{
+    if (!tape)
+        return;
+    if (tape->mapping)
+        munmap(tape->mapping, tape->mapping_len);
+    else
+        jc_mem_free((char*)tape->strings);
+    jc_mem_free(tape);
+}
+
+/*
+ *   Binary images
+ */
+
+static inline const char* tape_string_at(const JsonTape_t* tape, size_t index, uint32_t* len);
+
+static bool index_append_table(TapeIndex_t* index, JsonTapeCursor_t obj, size_t count, size_t* offset)
+{
+    size_t capacity = 16;
+    while (capacity < count * 2)
+        capacity <<= 1;
+    if (capacity > UINT32_MAX)
+        return false;
+
+    size_t needed = index->size + 1 + capacity;
+    if (needed > index->capacity) {
+        size_t new_capacity = index->capacity ? index->capacity : 1024;
+        while (new_capacity < needed)
+            new_capacity *= 2;
+        uint32_t* new_data = (uint32_t*)jc_mem_realloc(index->data, new_capacity * sizeof(uint32_t));
+        if (!new_data)
+            return false;
+        index->data = new_data;
+        index->capacity = new_capacity;
+    }
+
+    uint32_t* table = &index->data[index->size];
+    memset(table, 0, (1 + capacity) * sizeof(uint32_t));
+    table[0] = (uint32_t)capacity;
+    JsonTapeCursor_t member;
+    for (bool more = jc_tape_obj_first(obj, &member); more; more = jc_tape_obj_next(&member)) {
+        uint32_t len;
+        const char* key = tape_string_at(obj.tape, member.index, &len);
+        size_t slot = olh_map_hash(key, len) & (capacity - 1);
+        while (table[1 + slot])
+            slot = (slot + 1) & (capacity - 1);
+        table[1 + slot] = (uint32_t)(member.index - obj.index);
+    }
+    *offset = index->size;
+    index->size = needed;
+    return true;
+}
+
+static bool tape_image_word(const JsonTape_t* tape, TapeIndex_t* index, uint64_t* word)
+{
+    if (tape->index || tape_tag(*word) != '}')
+        return true;
+
+    JsonTapeCursor_t obj = { .tape = tape, .index = (size_t)tape_payload(*word) };
+    size_t count = jc_tape_size(obj);
+    size_t offset = 0;
+    if (count >= JC_TAPE_INDEX_MIN_MEMBERS) {
+        if (!index_append_table(index, obj, count, &offset))
+            return false;
+        offset++;
+    }
+    *word = tape_word('}', offset);
+    return true;
+}
+
+bool jc_tape_save_binary(const JsonTape_t* tape, const char* path)
+{
+    if (!tape || !path || tape->size == 0)
+        return false;
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    TapeImageHeader_t header = { .magic = TAPE_IMAGE_MAGIC, .word_count = tape->size, .strings_len = tape->strings_len };
+    TapeIndex_t index = { 0 };
+    uint64_t chunk[JC_TAPE_SAVE_CHUNK];
+    size_t chunk_len = 0;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; ok && i < tape->size; i++) {
+        uint64_t word = tape->words[i];
+        ok = tape_image_word(tape, &index, &word);
+        chunk[chunk_len++] = word;
+        if (ok && (chunk_len == JC_TAPE_SAVE_CHUNK || i + 1 == tape->size)) {
+            ok = fwrite(chunk, sizeof(uint64_t), chunk_len, file) == chunk_len;
+            chunk_len = 0;
+        }
+    }
+
+    const uint32_t* index_data = tape->index ? tape->index : index.data;
+    header.index_len = tape->index ? tape->index_len : index.size;
+    if (ok && header.index_len)
+        ok = fwrite(index_data, sizeof(uint32_t), header.index_len, file) == header.index_len;
+    if (ok && tape->strings_len)
+        ok = fwrite(tape->strings, 1, tape->strings_len, file) == tape->strings_len;
+    if (ok)
+        ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+
+    jc_mem_free(index.data);
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok)
+        remove(path);
+    return ok;
+}
+
+bool jc_doc_save_binary(const JsonDocument_t* doc, const char* path)
+{
+    JsonTape_t* tape = jc_tape_from_doc(doc);
+    if (!tape)
+        return false;
+    bool ok = jc_tape_save_binary(tape, path);
+    jc_free_tape(tape);
+    return ok;
+}
+
+static bool tape_image_valid(const TapeImageHeader_t* header, size_t len)
+{
+    if (header->magic != TAPE_IMAGE_MAGIC || header->word_count == 0)
+        return false;
+    size_t remaining = len - sizeof(*header);
+    if (header->word_count > remaining / sizeof(uint64_t))
+        return false;
+    remaining -= header->word_count * sizeof(uint64_t);
+    if (header->index_len > remaining / sizeof(uint32_t))
+        return false;
+    remaining -= header->index_len * sizeof(uint32_t);
+    return header->strings_len == remaining;
+}
+
+static bool tape_image_string_valid(const JsonTape_t* tape, uint64_t word)
+{
+    size_t offset = (size_t)tape_payload(word);
+    uint32_t len;
+    if (tape->strings_len < sizeof(len) || offset > tape->strings_len - sizeof(len))
+        return false;
+    memcpy(&len, &tape->strings[offset], sizeof(len));
+    size_t end = offset + sizeof(len) + (size_t)len;
+    return end < tape->strings_len && tape->strings[end] == '\0';
+}
+
+static inline bool key_bit(const uint8_t* keys, size_t index) { return keys[index / 8] & (1u << (index % 8)); }
+
+// A key table needs a power of two capacity with at least one empty slot, so probing ends, and its
+// slots have to point at keys of the object. keys marks the keys of the objects still open.
+static bool tape_image_table_valid(const JsonTape_t* tape, const uint8_t* keys, size_t open, uint64_t word)
+{
+    size_t offset = (size_t)tape_payload(word);
+    if (offset == 0)
+        return true;
+    if (offset > tape->index_len)
+        return false;
+    const uint32_t* table = &tape->index[offset - 1];
+    size_t capacity = table[0];
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity > tape->index_len - offset)
+        return false;
+    size_t used = 0;
+    for (size_t slot = 1; slot <= capacity; slot++) {
+        size_t rel = table[slot];
+        if (rel == 0)
+            continue;
+        if (rel >= tape->size - open || !key_bit(keys, open + rel))
+            return false;
+        used++;
+    }
+    return used < capacity;
+}
+
+typedef struct {
+    size_t open;
+    size_t close;
+    bool key_next;
+} TapeImageFrame_t;
+
+// The accessors trust the image, so every container, string and key table is checked once at open
+static bool tape_image_check(const JsonTape_t* tape)
+{
+    TapeImageFrame_t* stack = NULL;
+    size_t depth = 0;
+    size_t capacity = 0;
+    bool valid = false;
+    size_t i = 0;
+    uint8_t* keys = (uint8_t*)jc_mem_calloc(tape->size / 8 + 1);
+    if (!keys)
+        return false;
+    while (i < tape->size) {
+        uint64_t word = tape->words[i];
+        uint8_t tag = tape_tag(word);
+        TapeImageFrame_t* frame = depth ? &stack[depth - 1] : NULL;
+        size_t limit = frame ? frame->close : tape->size;
+        if (frame && i == frame->close) {
+            uint8_t open_tag = tape_tag(tape->words[frame->open]);
+            if (open_tag == '[' ? tag != ']' || tape_payload(word) != frame->open
+                                : tag != '}' || !frame->key_next || !tape_image_table_valid(tape, keys, frame->open, word))
+                goto EXIT;
+            // Only the keys of open objects stay marked, so tables can't point into nested objects
+            for (size_t key = frame->open + 1; open_tag == '{' && key < frame->close; key = tape_skip(tape, key + 1))
+                keys[key / 8] &= (uint8_t)~(1u << (key % 8));
+            depth--;
+            i++;
+            continue;
+        }
+        if (frame && frame->key_next) {
+            if (tag != '"')
+                goto EXIT;
+            keys[i / 8] |= (uint8_t)(1u << (i % 8));
+        }
+        if (frame && tape_tag(tape->words[frame->open]) == '{')
+            frame->key_next = !frame->key_next;
+
+        switch (tag) {
+        case '{':
+        case '[': {
+            size_t end = (size_t)(word & TAPE_END_MASK);
+            if (end < i + 2 || end > limit || depth == JC_TAPE_MAX_DEPTH)
+                goto EXIT;
+            if (depth == capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                TapeImageFrame_t* grown = (TapeImageFrame_t*)jc_mem_realloc(stack, capacity * sizeof(TapeImageFrame_t));
+                if (!grown)
+                    goto EXIT;
+                stack = grown;
+            }
+            stack[depth++] = (TapeImageFrame_t) { .open = i, .close = end - 1, .key_next = tag == '{' };
+            i++;
+            break;
+        }
+        case '"':
+            if (!tape_image_string_valid(tape, word))
+                goto EXIT;
+            i++;
+            break;
+        case 'l':
+        case 'd':
+            if (i + 2 > limit)
+                goto EXIT;
+            i += 2;
+            break;
+        case 't':
+        case 'f':
+        case 'n':
+            i++;
+            break;
+        default:
+            goto EXIT;
+        }
+    }
+    valid = depth == 0;
+
+EXIT:
+    jc_mem_free(keys);
+    jc_mem_free(stack);
+    return valid;
+}
+
+JsonTape_t* jc_tape_open_binary(const char* path)
+{
+    if (!path)
+        return NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TapeImageHeader_t)) {
+        close(fd);
+        return NULL;
+    }
+    size_t len = (size_t)st.st_size;
+    void* mapping = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    const TapeImageHeader_t* header = (const TapeImageHeader_t*)mapping;
+    JsonTape_t* tape = NULL;
+    if (tape_image_valid(header, len))
+        tape = (JsonTape_t*)jc_mem_calloc(sizeof(JsonTape_t));
+    if (!tape) {
+        munmap(mapping, len);
+        return NULL;
+    }
+
+    tape->words = (const uint64_t*)(header + 1);
+    tape->size = tape->capacity = (size_t)header->word_count;
+    tape->index = (const uint32_t*)(tape->words + tape->size);
+    tape->index_len = (size_t)header->index_len;
+    tape->strings = (const char*)(tape->index + tape->index_len);
+    tape->strings_len = (size_t)header->strings_len;
+    tape->mapping = mapping;
+    tape->mapping_len = len;
+
+    uint8_t root = tape_tag(tape->words[0]);
+    if ((root != '{' && root != '[') || tape_skip(tape, 0) != tape->size || !tape_image_check(tape)) {
+        jc_free_tape(tape);
+        return NULL;
+    }
+    return tape;
+}
+
+/*
+ *   Cursor access
+ */
+
+JsonTapeCursor_t jc_tape_root(const JsonTape_t* tape)
+{
+    assert(tape);
+    JsonTapeCursor_t cursor = { .tape = tape, .index = 0 };
+    return cursor;
+}
+
+JsonValueType_t jc_tape_type(JsonTapeCursor_t cursor)
+{
+    assert(cursor.tape && cursor.index < cursor.tape->size);
+    switch (tape_tag(cursor.tape->words[cursor.index])) {
+    case '"':
+        return JC_STRING;
+    case 'd':
+        return JC_DOUBLE;
+    case 'l':
+        return JC_INT64;
+    case '{':
+        return JC_OBJECT;
+    case '[':
+        return JC_ARRAY;
+    case 't':
+    case 'f':
+        return JC_BOOLEAN;
+    default:
+        return JC_NULL_LITERAL;
+    }
+}
+
+size_t jc_tape_size(JsonTapeCursor_t cursor)
+{
+    uint64_t word = cursor.tape->words[cursor.index];
+    uint8_t tag = tape_tag(word);
+    if (tag != '{' && tag != '[')
+        return 0;
+    uint64_t count = tape_payload(word) >> TAPE_COUNT_SHIFT;
+    if (count < TAPE_COUNT_MAX)
+        return (size_t)count;
+
+    size_t size = 0;
+    JsonTapeCursor_t child;
+    bool more = tag == '{' ? jc_tape_obj_first(cursor, &child) : jc_tape_arr_first(cursor, &child);
+    for (; more; more = tag == '{' ? jc_tape_obj_next(&child) : jc_tape_arr_next(&child))
+        size++;
+    return size;
+}
+
+static inline const char* tape_string_at(const JsonTape_t* tape, size_t index, uint32_t* len)
+{
+    size_t offset = (size_t)tape_payload(tape->words[index]);
+    memcpy(len, &tape->strings[offset], sizeof(*len));
+    return &tape->strings[offset + sizeof(*len)];
+}
+
+static bool tape_index_find(JsonTapeCursor_t obj, size_t offset, const char* key, size_t key_len, JsonTapeCursor_t* value)
+{
+    const uint32_t* table = &obj.tape->index[offset];
+    size_t capacity = table[0];
+    size_t slot = olh_map_hash(key, key_len) & (capacity - 1);
+    uint32_t rel;
+    for (size_t probe = 0; probe < capacity && (rel = table[1 + slot]) != 0; probe++, slot = (slot + 1) & (capacity - 1)) {
+        uint32_t len;
+        const char* candidate = tape_string_at(obj.tape, obj.index + rel, &len);
+        if (len == key_len && memcmp(candidate, key, key_len) == 0) {
+            value->tape = obj.tape;
+            value->index = obj.index + rel + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool jc_tape_obj_find(JsonTapeCursor_t obj, const char* key, JsonTapeCursor_t* value)
+{
+    if (!key || jc_tape_type(obj) != JC_OBJECT)
+        return false;
+    size_t key_len = strlen(key);
+    if (obj.tape->index) {
+        size_t close = (size_t)(obj.tape->words[obj.index] & TAPE_END_MASK) - 1;
+        size_t offset = (size_t)tape_payload(obj.tape->words[close]);
+        if (offset != 0)
+            return tape_index_find(obj, offset - 1, key, key_len, value);
+    }
+    JsonTapeCursor_t member;
+    for (bool more = jc_tape_obj_first(obj, &member); more; more = jc_tape_obj_next(&member)) {
+        uint32_t len;
+        const char* candidate = tape_string_at(member.tape, member.index, &len);
+        if (len == key_len && memcmp(candidate, key, key_len) == 0) {
+            *value = jc_tape_obj_value(member);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool jc_tape_obj_first(JsonTapeCursor_t obj, JsonTapeCursor_t* member)
+{
+    if (jc_tape_type(obj) != JC_OBJECT)
+        return false;
+    member->tape = obj.tape;
+    member->index = obj.index + 1;
+    return tape_tag(obj.tape->words[member->index]) != '}';
+}
+
+bool jc_tape_obj_next(JsonTapeCursor_t* member)
+{
+    size_t next = tape_skip(member->tape, member->index + 1);
+    if (tape_tag(member->tape->words[next]) == '}')
+        return false;
+    member->index = next;
+    return true;
+}
+
+const char* jc_tape_obj_key(JsonTapeCursor_t member)
+{
+    uint32_t len;
+    return tape_string_at(member.tape, member.index, &len);
+}
+
+JsonTapeCursor_t jc_tape_obj_value(JsonTapeCursor_t member)
+{
+    JsonTapeCursor_t value = { .tape = member.tape, .index = member.index + 1 };
+    return value;
+}
+
+bool jc_tape_arr_first(JsonTapeCursor_t arr, JsonTapeCursor_t* elem)
+{
+    if (jc_tape_type(arr) != JC_ARRAY)
+        return false;
+    elem->tape = arr.tape;
+    elem->index = arr.index + 1;
+    return tape_tag(arr.tape->words[elem->index]) != ']';
+}
+
+bool jc_tape_arr_next(JsonTapeCursor_t* elem)
+{
+    size_t next = tape_skip(elem->tape, elem->index);
+    if (tape_tag(elem->tape->words[next]) == ']')
+        return false;
+    elem->index = next;
+    return true;
+}
+
+bool jc_tape_arr_at(JsonTapeCursor_t arr, size_t index, JsonTapeCursor_t* elem)
+{
+    JsonTapeCursor_t current;
+    bool more = jc_tape_arr_first(arr, &current);
+    for (size_t i = 0; more; i++, more = jc_tape_arr_next(&current)) {
+        if (i == index) {
+            *elem = current;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* jc_tape_get_string(JsonTapeCursor_t cursor, size_t* len)
+{
+    if (jc_tape_type(cursor) != JC_STRING)
+        return NULL;
+    uint32_t len32;
+    const char* str = tape_string_at(cursor.tape, cursor.index, &len32);
+    if (len)
+        *len = len32;
+    return str;
+}
+
+bool jc_tape_get_double(JsonTapeCursor_t cursor, double* dbl)
+{
+    switch (jc_tape_type(cursor)) {
+    case JC_DOUBLE:
+        memcpy(dbl, &cursor.tape->words[cursor.index + 1], sizeof(*dbl));
+        return true;
+    case JC_INT64: {
+        int64_t i64;
+        memcpy(&i64, &cursor.tape->words[cursor.index + 1], sizeof(i64));
+        *dbl = (double)i64;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool jc_tape_get_int64(JsonTapeCursor_t cursor, int64_t* i64)
+{
+    switch (jc_tape_type(cursor)) {
+    case JC_DOUBLE: {
+        double dbl;
+        memcpy(&dbl, &cursor.tape->words[cursor.index + 1], sizeof(dbl));
+        *i64 = (int64_t)dbl;
+        return true;
+    }
+    case JC_INT64:
+        memcpy(i64, &cursor.tape->words[cursor.index + 1], sizeof(*i64));
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool jc_tape_get_bool(JsonTapeCursor_t cursor, bool* b)
+{
+    if (jc_tape_type(cursor) != JC_BOOLEAN)
+        return false;
+    *b = tape_tag(cursor.tape->words[cursor.index]) == 't';
+    return true;
+}
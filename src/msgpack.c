@@ -0,0 +1,420 @@
+#include <assert.h>
+#include <binary_reader.h>
+#include <jc_alloc.h>
+#include <msgpack.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * MessagePack subset: nil, booleans, integers, floats, str, array and map with str keys.
+ * bin and ext families are rejected.
+ */
+typedef BinaryReader_t MsgpackReader_t;
+
+static bool msgpack_write_tagged(StringBuilder_t* builder, uint8_t tag, uint64_t value, size_t bytes)
+{
+    char buf[9];
+    buf[0] = (char)tag;
+    for (size_t i = 0; i < bytes; i++)
+        buf[1 + i] = (char)(value >> (8 * (bytes - 1 - i)));
+    return builder_append_str(builder, buf, 1 + bytes);
+}
+
+bool msgpack_write_int64(StringBuilder_t* builder, int64_t i64)
+{
+    if (i64 >= 0) {
+        uint64_t u64 = (uint64_t)i64;
+        if (u64 <= 0x7f)
+            return builder_append_ch(builder, (char)u64);
+        if (u64 <= UINT8_MAX)
+            return msgpack_write_tagged(builder, 0xcc, u64, 1);
+        if (u64 <= UINT16_MAX)
+            return msgpack_write_tagged(builder, 0xcd, u64, 2);
+        if (u64 <= UINT32_MAX)
+            return msgpack_write_tagged(builder, 0xce, u64, 4);
+        return msgpack_write_tagged(builder, 0xcf, u64, 8);
+    }
+    if (i64 >= -32)
+        return builder_append_ch(builder, (char)i64);
+    if (i64 >= INT8_MIN)
+        return msgpack_write_tagged(builder, 0xd0, (uint64_t)i64, 1);
+    if (i64 >= INT16_MIN)
+        return msgpack_write_tagged(builder, 0xd1, (uint64_t)i64, 2);
+    if (i64 >= INT32_MIN)
+        return msgpack_write_tagged(builder, 0xd2, (uint64_t)i64, 4);
+    return msgpack_write_tagged(builder, 0xd3, (uint64_t)i64, 8);
+}
+
+bool msgpack_write_double(StringBuilder_t* builder, double dbl)
+{
+    float flt = (float)dbl;
+    if ((double)flt == dbl) {
+        uint32_t bits;
+        memcpy(&bits, &flt, sizeof(bits));
+        return msgpack_write_tagged(builder, 0xca, bits, 4);
+    }
+    uint64_t bits;
+    memcpy(&bits, &dbl, sizeof(bits));
+    return msgpack_write_tagged(builder, 0xcb, bits, 8);
+}
+
+bool msgpack_write_string(StringBuilder_t* builder, const char* str, size_t len)
+{
+    bool head;
+    if (len <= 31)
+        head = builder_append_ch(builder, (char)(0xa0 | len));
+    else if (len <= UINT8_MAX)
+        head = msgpack_write_tagged(builder, 0xd9, len, 1);
+    else if (len <= UINT16_MAX)
+        head = msgpack_write_tagged(builder, 0xda, len, 2);
+    else if (len <= UINT32_MAX)
+        head = msgpack_write_tagged(builder, 0xdb, len, 4);
+    else
+        return false;
+    return head && builder_append_str(builder, str, len);
+}
+
+bool msgpack_write_bool(StringBuilder_t* builder, bool b)
+{
+    return builder_append_ch(builder, (char)(b ? 0xc3 : 0xc2));
+}
+
+bool msgpack_write_null(StringBuilder_t* builder)
+{
+    return builder_append_ch(builder, (char)0xc0);
+}
+
+bool msgpack_write_array_head(StringBuilder_t* builder, size_t count)
+{
+    if (count <= 15)
+        return builder_append_ch(builder, (char)(0x90 | count));
+    if (count <= UINT16_MAX)
+        return msgpack_write_tagged(builder, 0xdc, count, 2);
+    if (count <= UINT32_MAX)
+        return msgpack_write_tagged(builder, 0xdd, count, 4);
+    return false;
+}
+
+bool msgpack_write_map_head(StringBuilder_t* builder, size_t count)
+{
+    if (count <= 15)
+        return builder_append_ch(builder, (char)(0x80 | count));
+    if (count <= UINT16_MAX)
+        return msgpack_write_tagged(builder, 0xde, count, 2);
+    if (count <= UINT32_MAX)
+        return msgpack_write_tagged(builder, 0xdf, count, 4);
+    return false;
+}
+
+static bool msgpack_write_obj(StringBuilder_t* builder, const JsonObject_t* obj)
+{
+    if (!msgpack_write_map_head(builder, jc_obj_size(obj)))
+        return false;
+    jc_obj_foreach(obj, key, value)
+    {
+        if (!msgpack_write_string(builder, key, strlen(key)) || !msgpack_write_value(builder, value))
+            return false;
+    }
+    return true;
+}
+
+static bool msgpack_write_arr(StringBuilder_t* builder, const JsonArray_t* arr)
+{
+    if (!msgpack_write_array_head(builder, jc_arr_size(arr)))
+        return false;
+    jc_arr_foreach(arr, value)
+    {
+        if (!msgpack_write_value(builder, value))
+            return false;
+    }
+    return true;
+}
+
+bool msgpack_write_value(StringBuilder_t* builder, const JsonValue_t* value)
+{
+    assert(builder && value);
+    switch (value->ty) {
+    case JC_STRING:
+        return msgpack_write_string(builder, value->string, strlen(value->string));
+    case JC_DOUBLE:
+        return msgpack_write_double(builder, value->num_double);
+    case JC_INT64:
+        return msgpack_write_int64(builder, value->num_int64);
+    case JC_OBJECT:
+        return msgpack_write_obj(builder, value->object);
+    case JC_ARRAY:
+        return msgpack_write_arr(builder, value->array);
+    case JC_BOOLEAN:
+        return msgpack_write_bool(builder, value->boolean);
+    case JC_NULL_LITERAL:
+        return msgpack_write_null(builder);
+    case JC_NUMBER_RAW: {
+        int64_t i64;
+        double dbl;
+        if (jc_value_number_type(value) == JC_INT64 && jc_value_get_int64(value, &i64))
+            return msgpack_write_int64(builder, i64);
+        return jc_value_get_double(value, &dbl) && msgpack_write_double(builder, dbl);
+    }
+    case JC_STRING_RAW: {
+        const char* str = jc_value_get_string(value);
+        return str && msgpack_write_string(builder, str, strlen(str));
+    }
+    }
+    return false;
+}
+
+uint8_t* jc_doc_to_msgpack(const JsonDocument_t* doc, size_t* len)
+{
+    if (!doc || !len || jc_doc_is_obj(doc) == jc_doc_is_arr(doc))
+        return NULL;
+    StringBuilder_t builder = { 0 };
+    if (!builder_resize(&builder, 64))
+        return NULL;
+    bool written = jc_doc_is_obj(doc) ? msgpack_write_obj(&builder, jc_doc_get_obj(doc))
+                                      : msgpack_write_arr(&builder, jc_doc_get_arr(doc));
+    if (!written) {
+        free(builder.buffer);
+        return NULL;
+    }
+    *len = builder.pos;
+    return (uint8_t*)builder.buffer;
+}
+
+/*
+ * Decoding
+ */
+
+static bool msgpack_read_be(MsgpackReader_t* reader, size_t bytes, uint64_t* value)
+{
+    if (reader->len - reader->pos < bytes)
+        return false;
+    *value = 0;
+    for (size_t i = 0; i < bytes; i++)
+        *value = (*value << 8) | reader->data[reader->pos++];
+    return true;
+}
+
+static bool msgpack_read_str_len(MsgpackReader_t* reader, uint8_t tag, uint64_t* len)
+{
+    if ((tag & 0xe0) == 0xa0) {
+        *len = tag & 0x1f;
+        return true;
+    }
+    switch (tag) {
+    case 0xd9:
+        return msgpack_read_be(reader, 1, len);
+    case 0xda:
+        return msgpack_read_be(reader, 2, len);
+    case 0xdb:
+        return msgpack_read_be(reader, 4, len);
+    }
+    return false;
+}
+
+static bool msgpack_read_container_len(MsgpackReader_t* reader, uint8_t tag, bool* is_map, uint64_t* count)
+{
+    if ((tag & 0xf0) == 0x80 || (tag & 0xf0) == 0x90) {
+        *is_map = (tag & 0xf0) == 0x80;
+        *count = tag & 0x0f;
+        return true;
+    }
+    *is_map = tag == 0xde || tag == 0xdf;
+    switch (tag) {
+    case 0xdc:
+    case 0xde:
+        return msgpack_read_be(reader, 2, count);
+    case 0xdd:
+    case 0xdf:
+        return msgpack_read_be(reader, 4, count);
+    }
+    return false;
+}
+
+static JsonValue_t* msgpack_read_value(MsgpackReader_t* reader);
+
+static JsonArray_t* msgpack_read_arr(MsgpackReader_t* reader, uint64_t count)
+{
+    JsonArray_t* arr = jc_new_arr_with_capacity(reader_presize_count(reader, count));
+    if (!arr)
+        return NULL;
+    for (uint64_t i = 0; i < count; i++) {
+        JsonValue_t* value = msgpack_read_value(reader);
+        if (!value || !jc_arr_insert_value(arr, value)) {
+            jc_free_value(value);
+            jc_free_arr(arr);
+            return NULL;
+        }
+    }
+    return arr;
+}
+
+static JsonObject_t* msgpack_read_obj(MsgpackReader_t* reader, uint64_t count)
+{
+    JsonObject_t* obj = jc_new_obj_with_capacity(reader_presize_count(reader, count));
+    if (!obj)
+        return NULL;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t key_len;
+        size_t key_offset;
+        if (reader->pos >= reader->len || !msgpack_read_str_len(reader, reader->data[reader->pos++], &key_len)
+            || !reader_read_text(reader, key_len, &key_offset))
+            goto EXIT_ERROR;
+
+        // The key stays in the input until the value is decoded, which may reuse the scratch buffer
+        JsonValue_t* value = msgpack_read_value(reader);
+        if (!value)
+            goto EXIT_ERROR;
+        const char* key = reader_terminate(reader, (const char*)&reader->data[key_offset], (size_t)key_len);
+        if (!key || !jc_obj_set(obj, key, value)) {
+            jc_free_value(value);
+            goto EXIT_ERROR;
+        }
+    }
+    return obj;
+
+EXIT_ERROR:
+    jc_free_obj(obj);
+    return NULL;
+}
+
+static JsonValue_t* msgpack_read_number(MsgpackReader_t* reader, uint8_t tag)
+{
+    uint64_t raw;
+    size_t bytes = (size_t)1 << (tag & 0x03);
+    if (!msgpack_read_be(reader, bytes, &raw))
+        return NULL;
+    if (tag >= 0xcc && tag <= 0xcf) {
+        if (raw > INT64_MAX)
+            return jc_new_double_value((double)raw);
+        return jc_new_int64_value((int64_t)raw);
+    }
+    switch (bytes) {
+    case 1:
+        return jc_new_int64_value((int8_t)raw);
+    case 2:
+        return jc_new_int64_value((int16_t)raw);
+    case 4:
+        return jc_new_int64_value((int32_t)raw);
+    default:
+        return jc_new_int64_value((int64_t)raw);
+    }
+}
+
+static JsonValue_t* msgpack_read_value(MsgpackReader_t* reader)
+{
+    if (reader->pos >= reader->len)
+        return NULL;
+    uint8_t tag = reader->data[reader->pos++];
+
+    if (tag <= 0x7f)
+        return jc_new_int64_value(tag);
+    if (tag >= 0xe0)
+        return jc_new_int64_value((int8_t)tag);
+
+    uint64_t len;
+    bool is_map;
+    if (msgpack_read_str_len(reader, tag, &len)) {
+        size_t offset;
+        const char* text = reader_read_text(reader, len, &offset);
+        if (!text)
+            return NULL;
+        const char* str = reader_terminate(reader, text, (size_t)len);
+        return str ? jc_new_value(JC_STRING, (void*)str) : NULL;
+    }
+    if (msgpack_read_container_len(reader, tag, &is_map, &len)) {
+        if (!reader_enter(reader))
+            return NULL;
+        if (is_map) {
+            JsonObject_t* obj = msgpack_read_obj(reader, len);
+            reader_leave(reader);
+            JsonValue_t* value = obj ? jc_new_value(JC_OBJECT, obj) : NULL;
+            if (obj && !value)
+                jc_free_obj(obj);
+            return value;
+        }
+        JsonArray_t* arr = msgpack_read_arr(reader, len);
+        reader_leave(reader);
+        JsonValue_t* value = arr ? jc_new_value(JC_ARRAY, arr) : NULL;
+        if (arr && !value)
+            jc_free_arr(arr);
+        return value;
+    }
+
+    switch (tag) {
+    case 0xc0:
+        return jc_new_value(JC_NULL_LITERAL, NULL);
+    case 0xc2:
+        return jc_new_bool_value(false);
+    case 0xc3:
+        return jc_new_bool_value(true);
+    case 0xca: {
+        uint64_t raw;
+        if (!msgpack_read_be(reader, 4, &raw))
+            return NULL;
+        float flt;
+        uint32_t bits = (uint32_t)raw;
+        memcpy(&flt, &bits, sizeof(flt));
+        return jc_new_double_value(flt);
+    }
+    case 0xcb: {
+        uint64_t raw;
+        if (!msgpack_read_be(reader, 8, &raw))
+            return NULL;
+        double dbl;
+        memcpy(&dbl, &raw, sizeof(dbl));
+        return jc_new_double_value(dbl);
+    }
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3:
+        return msgpack_read_number(reader, tag);
+    }
+    return NULL;
+}
+
+JsonDocument_t* jc_doc_from_msgpack(const uint8_t* data, size_t len)
+{
+    if (!data || len == 0)
+        return NULL;
+    MsgpackReader_t reader = { .data = data, .pos = 0, .len = len, .scratch = { .scoped = true } };
+    JsonDocument_t* doc = jc_new_doc();
+    if (!doc)
+        return NULL;
+    // The scratch buffer is allocated in the document's scope like the nodes
+    JsonAllocScope_t* previous_scope = jc_alloc_scope_enter(jc_alloc_scope_of(doc));
+    if (!builder_resize(&reader.scratch, 64))
+        goto EXIT_ERROR;
+
+    uint64_t count;
+    bool is_map;
+    if (!msgpack_read_container_len(&reader, reader.data[reader.pos++], &is_map, &count))
+        goto EXIT_ERROR;
+    if (is_map) {
+        JsonObject_t* obj = msgpack_read_obj(&reader, count);
+        if (!obj)
+            goto EXIT_ERROR;
+        jc_doc_set_obj(doc, obj);
+    } else {
+        JsonArray_t* arr = msgpack_read_arr(&reader, count);
+        if (!arr)
+            goto EXIT_ERROR;
+        jc_doc_set_arr(doc, arr);
+    }
+    // Check if all input was consumed
+    if (reader.pos != reader.len)
+        goto EXIT_ERROR;
+    builder_free(&reader.scratch);
+    jc_alloc_scope_enter(previous_scope);
+    return doc;
+
+EXIT_ERROR:
+    builder_free(&reader.scratch);
+    jc_alloc_scope_enter(previous_scope);
+    jc_free_doc(doc);
+    return NULL;
+}
@@ -0,0 +1,19 @@
+#ifndef JC_MSGPACK__
+#define JC_MSGPACK__
+
+#include <jc.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_builder.h>
+
+bool msgpack_write_int64(StringBuilder_t* builder, int64_t i64);
+bool msgpack_write_double(StringBuilder_t* builder, double dbl);
+bool msgpack_write_string(StringBuilder_t* builder, const char* str, size_t len);
+bool msgpack_write_bool(StringBuilder_t* builder, bool b);
+bool msgpack_write_null(StringBuilder_t* builder);
+bool msgpack_write_array_head(StringBuilder_t* builder, size_t count);
+bool msgpack_write_map_head(StringBuilder_t* builder, size_t count);
+bool msgpack_write_value(StringBuilder_t* builder, const JsonValue_t* value);
+
+#endif
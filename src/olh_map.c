@@ -1,22 +1,16 @@
 #include <assert.h>
+#include <jc.h>
+#include <jc_alloc.h>
+#include <jc_stats.h>
 #include <olh_map.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string_builder.h>
 
-static inline uint32_t jenkins_hash(const char* data)
+uint32_t olh_map_hash(const char* key, size_t len)
 {
-    size_t len = strlen(data); // TODO: maybe put into bucket entry
-    uint32_t hash = 0;
-    for (size_t i = 0; i < len; i++) {
-        hash += ((uint8_t*)data)[i];
-        hash += hash << 10;
-        hash ^= hash >> 6;
-    }
-    hash += hash << 3;
-    hash ^= hash >> 11;
-    hash += hash << 15;
-    return hash;
+    return jc_key_hash(key, len);
 }
 
 static inline uint32_t double_hash(uint32_t hash)
@@ -33,14 +27,37 @@ static inline uint32_t double_hash(uint32_t hash)
     return hash;
 }
 
+static inline BucketEntry_t* first_empty_bucket(const OrderedLinkedHashMap_t* map, uint32_t hash)
+{
+    BucketEntry_t* bucket = &map->buckets[hash % map->capacity];
+    while (bucket->state != EMPTY) {
+        hash = double_hash(hash);
+        bucket = &map->buckets[hash % map->capacity];
+    }
+    return bucket;
+}
+
+static inline void append_bucket(OrderedLinkedHashMap_t* map, BucketEntry_t* bucket)
+{
+    bucket->previous = map->tail;
+    bucket->next = NULL;
+    if (!map->head)
+        map->head = bucket;
+    else
+        map->tail->next = bucket;
+    map->tail = bucket;
+    map->size++;
+}
+
 bool olh_map_rehash(OrderedLinkedHashMap_t* map, size_t capacity)
 {
     capacity = (4 > capacity ? 4 : capacity);
+    assert(capacity > map->size);
 
     BucketEntry_t* old_buckets = map->buckets;
     BucketEntry_t* old_head = map->head;
 
-    map->buckets = calloc(1, sizeof(BucketEntry_t) * capacity);
+    map->buckets = jc_mem_calloc_in(map->alloc_scope, sizeof(BucketEntry_t) * capacity);
     if (!map->buckets) {
         map->buckets = old_buckets;
         return false;
@@ -54,15 +71,16 @@ bool olh_map_rehash(OrderedLinkedHashMap_t* map, size_t capacity)
     if (!old_buckets)
         return true;
 
+    // Entries move over with their keys, the new table has neither duplicates nor tombstones
+    JC_STATS_ADD(map_rehashes, 1);
     while (old_head) {
-        if (old_head->state == OCCUPIED) {
-            olh_map_set(map, old_head->key, old_head->value);
-        }
-        BucketEntry_t* next = old_head->next;
-        free(old_head->key);
-        old_head = next;
+        BucketEntry_t* bucket = first_empty_bucket(map, old_head->hash);
+        *bucket = *old_head;
+        append_bucket(map, bucket);
+        JC_STATS_ADD(map_rehash_bytes, sizeof(BucketEntry_t));
+        old_head = old_head->next;
     }
-    free(old_buckets);
+    jc_mem_free(old_buckets);
 
     return true;
 }
@@ -72,72 +90,117 @@ static inline bool should_grow(const OrderedLinkedHashMap_t* map)
     return (map->size + map->deleted_count + 1) >= map->capacity;
 }
 
-static BucketEntry_t* lookup_bucket_for_read(const OrderedLinkedHashMap_t* map, const char* key)
+// Full hash and length are compared before the key bytes
+static inline bool bucket_matches(const BucketEntry_t* bucket, const char* key, size_t key_len, uint32_t hash)
+{
+    if (bucket->state != OCCUPIED || bucket->hash != hash)
+        return false;
+    if (bucket->key_len == OLH_MAP_KEY_LEN_UNKNOWN)
+        return key_len >= OLH_MAP_KEY_LEN_UNKNOWN && strlen(bucket->key) == key_len && memcmp(bucket->key, key, key_len) == 0;
+    return bucket->key_len == key_len && memcmp(bucket->key, key, key_len) == 0;
+}
+
+static BucketEntry_t* lookup_bucket_for_read(const OrderedLinkedHashMap_t* map, const char* key, size_t key_len, uint32_t hash)
 {
     if (map->size == 0)
         return NULL;
 
-    uint32_t hash = jenkins_hash(key);
+    uint32_t probe = hash;
+    JC_STATS_ONLY(size_t probes = 0;)
     for (;;) {
-        BucketEntry_t* candidate = &map->buckets[hash % map->capacity];
-        if (candidate->state == OCCUPIED && strcmp(candidate->key, key) == 0)
+        BucketEntry_t* candidate = &map->buckets[probe % map->capacity];
+        JC_STATS_ONLY(probes++;)
+        if (bucket_matches(candidate, key, key_len, hash)) {
+            JC_STATS_PROBES(map_read_probes, probes);
             return candidate;
-        if (candidate->state != OCCUPIED && candidate->state != DELETED)
+        }
+        if (candidate->state != OCCUPIED && candidate->state != DELETED) {
+            JC_STATS_PROBES(map_read_probes, probes);
             return NULL;
+        }
 
-        hash = double_hash(hash);
+        probe = double_hash(probe);
     }
 }
 
-static BucketEntry_t* lookup_bucket_for_write(OrderedLinkedHashMap_t* map, const char* key)
+static BucketEntry_t* lookup_bucket_for_write(OrderedLinkedHashMap_t* map, const char* key, size_t key_len, uint32_t hash)
 {
-    if (should_grow(map))
-        olh_map_rehash(map, map->capacity * 2);
+    // A full table would never end probing, when it can't grow only existing keys can be set
+    if (should_grow(map) && !olh_map_rehash(map, map->capacity * 2))
+        return lookup_bucket_for_read(map, key, key_len, hash);
 
-    uint32_t hash = jenkins_hash(key);
     BucketEntry_t* first_empty_bucket = NULL;
+    uint32_t probe = hash;
+    JC_STATS_ONLY(size_t probes = 0;)
     for (;;) {
-        BucketEntry_t* candidate = &map->buckets[hash % map->capacity];
+        BucketEntry_t* candidate = &map->buckets[probe % map->capacity];
+        JC_STATS_ONLY(probes++;)
 
-        if (candidate->state == OCCUPIED && strcmp(candidate->key, key) == 0)
+        if (bucket_matches(candidate, key, key_len, hash)) {
+            JC_STATS_PROBES(map_write_probes, probes);
             return candidate;
+        }
 
         if (candidate->state != OCCUPIED) {
             if (!first_empty_bucket)
                 first_empty_bucket = candidate;
 
-            if (candidate->state != DELETED)
+            if (candidate->state != DELETED) {
+                JC_STATS_PROBES(map_write_probes, probes);
                 return first_empty_bucket;
+            }
         }
 
-        hash = double_hash(hash);
+        probe = double_hash(probe);
     }
 }
 
 bool olh_map_set(OrderedLinkedHashMap_t* map, const char* key, void* data)
+{
+    assert(key);
+    return olh_map_set_len(map, key, strlen(key), data);
+}
+
+bool olh_map_set_len(OrderedLinkedHashMap_t* map, const char* key, size_t key_len, void* data)
+{
+    return olh_map_set_hashed(map, key, key_len, jc_key_hash(key, key_len), data);
+}
+
+bool olh_map_set_hashed(OrderedLinkedHashMap_t* map, const char* key, size_t key_len, uint32_t hash, void* data)
 {
     assert(map && key && data && map->value_free_func);
-    BucketEntry_t* bucket = lookup_bucket_for_write(map, key);
+    BucketEntry_t* bucket = lookup_bucket_for_write(map, key, key_len, hash);
     if (!bucket)
         return false;
     if (bucket->state == OCCUPIED)
         goto SET_VALUE;
 
-    bucket->key = strdup(key);
+    bucket->key = jc_mem_alloc_in(map->alloc_scope, key_len + 1);
     if (!bucket->key)
         return false;
+    memcpy(bucket->key, key, key_len);
+    bucket->key[key_len] = '\0';
+    bucket->hash = hash;
+    if (key_len < OLH_MAP_KEY_LEN_UNKNOWN) {
+        bucket->key_len = (uint32_t)key_len & OLH_MAP_KEY_LEN_UNKNOWN;
+        bucket->key_clean = !builder_needs_escape(key, key_len);
+    } else {
+        bucket->key_len = OLH_MAP_KEY_LEN_UNKNOWN;
+        bucket->key_clean = false;
+    }
 
     map->size++;
 
     if (bucket->state == DELETED)
         map->deleted_count--;
 
-    if (!map->head) {
+    // A reused tombstone still carries the links it had before removal
+    bucket->previous = map->tail;
+    bucket->next = NULL;
+    if (!map->head)
         map->head = bucket;
-    } else {
-        bucket->previous = map->tail;
+    else
         map->tail->next = bucket;
-    }
     map->tail = bucket;
     bucket->state = OCCUPIED;
 
@@ -150,16 +213,60 @@ SET_VALUE:
 
 void* olh_map_get(const OrderedLinkedHashMap_t* map, const char* key)
 {
-    BucketEntry_t* bucket = lookup_bucket_for_read(map, key);
+    size_t key_len = strlen(key);
+    return olh_map_get_hashed(map, key, key_len, jc_key_hash(key, key_len));
+}
+
+void* olh_map_get_hashed(const OrderedLinkedHashMap_t* map, const char* key, size_t key_len, uint32_t hash)
+{
+    BucketEntry_t* bucket = lookup_bucket_for_read(map, key, key_len, hash);
     if (!bucket)
         return NULL;
     return bucket->value;
 }
 
+size_t olh_map_get_keyset(const OrderedLinkedHashMap_t* map, const JsonKeySet_t* set, void** values)
+{
+    size_t found = 0;
+    for (const BucketEntry_t* bucket = map->head; bucket && found < set->count; bucket = bucket->next) {
+        int index = jc_keyset_find_hashed(set, bucket->key, olh_map_key_len(bucket), bucket->hash);
+        if (index >= 0) {
+            values[index] = bucket->value;
+            found++;
+        }
+    }
+    return found;
+}
+
+bool olh_map_copy(OrderedLinkedHashMap_t* dst, const OrderedLinkedHashMap_t* src, olh_map_value_copy copy_func)
+{
+    assert(dst->size == 0 && dst->deleted_count == 0 && dst->capacity > src->size);
+    // Without duplicates or tombstones in dst no key has to be hashed or compared
+    for (const BucketEntry_t* entry = src->head; entry; entry = entry->next) {
+        size_t key_len = olh_map_key_len(entry);
+        char* key = jc_mem_alloc_in(dst->alloc_scope, key_len + 1);
+        if (!key)
+            return false;
+        memcpy(key, entry->key, key_len + 1);
+        void* value = copy_func(entry->value);
+        if (!value) {
+            jc_mem_free(key);
+            return false;
+        }
+        BucketEntry_t* bucket = first_empty_bucket(dst, entry->hash);
+        *bucket = *entry;
+        bucket->key = key;
+        bucket->value = value;
+        append_bucket(dst, bucket);
+    }
+    return true;
+}
+
 bool olh_map_remove(OrderedLinkedHashMap_t* map, const char* key)
 {
     assert(map && key && map->value_free_func);
-    BucketEntry_t* bucket = lookup_bucket_for_read(map, key);
+    size_t key_len = strlen(key);
+    BucketEntry_t* bucket = lookup_bucket_for_read(map, key, key_len, jc_key_hash(key, key_len));
     if (bucket && bucket->state == OCCUPIED) {
         if (bucket->previous)
             bucket->previous->next = bucket->next;
@@ -172,7 +279,7 @@ bool olh_map_remove(OrderedLinkedHashMap_t* map, const char* key)
             map->tail = bucket->previous;
 
         if (bucket->key) {
-            free(bucket->key);
+            jc_mem_free(bucket->key);
             bucket->key = NULL;
         }
         if (bucket->value) {
@@ -195,10 +302,10 @@ void olh_map_free(OrderedLinkedHashMap_t* map)
     while (current) {
         BucketEntry_t* next = current->next;
         if (current->key)
-            free(current->key);
+            jc_mem_free(current->key);
         map->value_free_func(current->value);
         current = next;
     }
     if (map->buckets)
-        free(map->buckets);
+        jc_mem_free(map->buckets);
 }
\ No newline at end of file
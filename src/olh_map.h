@@ -1,16 +1,28 @@
 #ifndef JC_OLH_MAP__
 #define JC_OLH_MAP__
 
+#include <jc.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 typedef enum {
     EMPTY,
     OCCUPIED,
     DELETED
 } BucketState;
 
+#define OLH_MAP_KEY_LEN_UNKNOWN 0x1fffffffu
+
 typedef struct BucketEntry_t {
-    BucketState state;
+    // Hash of the key, compared before the key itself and reused when rehashing
+    uint32_t hash;
+    uint32_t state : 2;
+    // Cached key length (OLH_MAP_KEY_LEN_UNKNOWN for very long keys) and whether the key
+    // can be serialized without escaping
+    uint32_t key_clean : 1;
+    uint32_t key_len : 29;
     char* key;
     void* value;
     struct BucketEntry_t* previous;
@@ -18,6 +30,7 @@ typedef struct BucketEntry_t {
 } BucketEntry_t;
 
 typedef void (*olh_map_value_free)(void*);
+typedef void* (*olh_map_value_copy)(const void*);
 
 typedef struct {
     size_t capacity;
@@ -27,11 +40,29 @@ typedef struct {
     BucketEntry_t* head;
     BucketEntry_t* tail;
     olh_map_value_free value_free_func;
+    // Scope keys and buckets are allocated in, NULL for the current one
+    struct JsonAllocScope_t* alloc_scope;
 } OrderedLinkedHashMap_t;
 
+static inline size_t olh_map_key_len(const BucketEntry_t* bucket)
+{
+    return bucket->key_len != OLH_MAP_KEY_LEN_UNKNOWN ? bucket->key_len : strlen(bucket->key);
+}
+
+uint32_t olh_map_hash(const char* key, size_t len);
 bool olh_map_rehash(OrderedLinkedHashMap_t* map, size_t capacity);
 bool olh_map_set(OrderedLinkedHashMap_t* map, const char* key, void* data);
+bool olh_map_set_len(OrderedLinkedHashMap_t* map, const char* key, size_t key_len, void* data);
+// hash has to be olh_map_hash(key, key_len)
+bool olh_map_set_hashed(OrderedLinkedHashMap_t* map, const char* key, size_t key_len, uint32_t hash, void* data);
 void* olh_map_get(const OrderedLinkedHashMap_t* map, const char* key);
+void* olh_map_get_hashed(const OrderedLinkedHashMap_t* map, const char* key, size_t key_len, uint32_t hash);
+// Resolves the stored hashes of all entries against the key set, values has room for every key of the set
+size_t olh_map_get_keyset(const OrderedLinkedHashMap_t* map, const JsonKeySet_t* set, void** values);
+// Copies the entries of src into the empty map dst, which has to be larger than src->size. Entries are placed
+// by their stored hash, keys are duplicated and values go through copy_func. On failure dst holds the
+// entries copied so far.
+bool olh_map_copy(OrderedLinkedHashMap_t* dst, const OrderedLinkedHashMap_t* src, olh_map_value_copy copy_func);
 bool olh_map_remove(OrderedLinkedHashMap_t* map, const char* key);
 void olh_map_free(OrderedLinkedHashMap_t* map);
 
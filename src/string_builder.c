@@ -1,114 +1,246 @@
 #include <string_builder.h>
 #include <assert.h>
+#include <jc_alloc.h>
+#include <jc_stats.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#    include <immintrin.h>
+#endif
+
+/*
+ * Escape sequence for every byte that cannot appear verbatim inside a JSON string,
+ * NULL for bytes that are copied as is. Sequences are either 2 or 6 characters long.
+ */
+static const char* const escape_table[256] = {
+    [0x00] = "\\u0000", [0x01] = "\\u0001", [0x02] = "\\u0002", [0x03] = "\\u0003",
+    [0x04] = "\\u0004", [0x05] = "\\u0005", [0x06] = "\\u0006", [0x07] = "\\u0007",
+    [0x08] = "\\b", [0x09] = "\\t", [0x0a] = "\\n", [0x0b] = "\\u000b",
+    [0x0c] = "\\f", [0x0d] = "\\r", [0x0e] = "\\u000e", [0x0f] = "\\u000f",
+    [0x10] = "\\u0010", [0x11] = "\\u0011", [0x12] = "\\u0012", [0x13] = "\\u0013",
+    [0x14] = "\\u0014", [0x15] = "\\u0015", [0x16] = "\\u0016", [0x17] = "\\u0017",
+    [0x18] = "\\u0018", [0x19] = "\\u0019", [0x1a] = "\\u001a", [0x1b] = "\\u001b",
+    [0x1c] = "\\u001c", [0x1d] = "\\u001d", [0x1e] = "\\u001e", [0x1f] = "\\u001f",
+    ['"'] = "\\\"", ['\\'] = "\\\\",
+};
+
+void builder_use_buffer(StringBuilder_t* builder, char* buffer, size_t capacity)
+{
+    assert(builder);
+    builder->buffer = buffer;
+    builder->capacity = buffer ? capacity : 0;
+    builder->pos = 0;
+    builder->external = true;
+    builder->overflow = false;
+    if (builder->capacity)
+        builder->buffer[0] = '\0';
+}
+
 void builder_reset(StringBuilder_t* builder)
 {
     assert(builder);
-    memset(builder->buffer, 0, builder->capacity);
-    builder->capacity = 0;
     builder->pos = 0;
+    builder->overflow = false;
+    if (builder->capacity)
+        builder->buffer[0] = '\0';
 }
 
 bool builder_resize(StringBuilder_t* builder, size_t capacity)
 {
-    assert(builder);
-    char* new_buffer = calloc(1, capacity);
-    if (!new_buffer)
+    assert(builder && capacity > builder->pos);
+    if (builder->external)
+        return false;
+    char* new_buffer = builder->scoped ? (char*)jc_mem_realloc(builder->buffer, capacity) : (char*)realloc(builder->buffer, capacity);
+    if (!new_buffer) {
+        builder->overflow = true;
         return false;
-    if (builder->buffer) {
-        memcpy(new_buffer, builder->buffer, builder->capacity);
-        free(builder->buffer);
     }
+    JC_STATS_ADD(builder_grows, 1);
+    JC_STATS_ADD(builder_grow_bytes, capacity - builder->capacity);
     builder->buffer = new_buffer;
     builder->capacity = capacity;
+    builder->buffer[builder->pos] = '\0';
     return true;
 }
 
+void builder_free(StringBuilder_t* builder)
+{
+    assert(builder);
+    if (builder->external)
+        return;
+    if (builder->scoped)
+        jc_mem_free(builder->buffer);
+    else
+        free(builder->buffer);
+    builder->buffer = NULL;
+    builder->capacity = 0;
+    builder->pos = 0;
+}
+
 static inline bool builder_ensure_capacity(StringBuilder_t* builder, size_t len)
 {
+    // One byte is always kept for the NUL terminator
     if (builder->pos + len < builder->capacity)
         return true;
-    size_t additional_capacity = builder->capacity;
-    if (builder->capacity < len) 
-        additional_capacity = len;
-    return builder_resize(builder, builder->capacity + additional_capacity);
+    if (builder->external) {
+        builder->overflow = true;
+        return false;
+    }
+    size_t capacity = builder->capacity < 16 ? 16 : builder->capacity * 2;
+    if (capacity <= builder->pos + len)
+        capacity = builder->pos + len + 1;
+    return builder_resize(builder, capacity);
+}
+
+static inline char* builder_claim(StringBuilder_t* builder, size_t len)
+{
+    if (!builder_ensure_capacity(builder, len)) {
+        // Keep counting so the caller learns the required size
+        if (builder->external)
+            builder->pos += len;
+        return NULL;
+    }
+    char* dst = &builder->buffer[builder->pos];
+    builder->pos += len;
+    builder->buffer[builder->pos] = '\0';
+    return dst;
 }
 
 bool builder_append_ch(StringBuilder_t* builder, char ch)
 {
     assert(builder);
-    if (!builder_ensure_capacity(builder, 1))
+    char* dst = builder_claim(builder, 1);
+    if (!dst)
         return false;
-    builder->buffer[builder->pos++] = ch;
+    *dst = ch;
     return true;
 }
 
 bool builder_append_chrs(StringBuilder_t* builder, char ch, size_t count)
 {
     assert(builder);
-    if (!builder_ensure_capacity(builder, count))
+    char* dst = builder_claim(builder, count);
+    if (!dst)
         return false;
-    memset(&builder->buffer[builder->pos], ch, count);
-    builder->pos += count;
+    memset(dst, ch, count);
     return true;
 }
 
-bool builder_append(StringBuilder_t* builder, const char* format, ...)
+bool builder_append_str(StringBuilder_t* builder, const char* str, size_t len)
 {
     assert(builder);
-    if (builder->pos >= builder->capacity)
+    char* dst = builder_claim(builder, len);
+    if (!dst)
         return false;
+    memcpy(dst, str, len);
+    return true;
+}
+
+bool builder_append(StringBuilder_t* builder, const char* format, ...)
+{
+    assert(builder);
+    size_t available = builder->pos < builder->capacity ? builder->capacity - builder->pos : 0;
+    char* dst = available ? &builder->buffer[builder->pos] : NULL;
     va_list args;
     va_start(args, format);
-    size_t len = (size_t)vsnprintf(NULL, 0, format, args);
+    int written = vsnprintf(dst, available, format, args);
     va_end(args);
-    va_start(args, format);
-    if (!builder_ensure_capacity(builder, len)) 
+    if (written < 0)
         return false;
-    vsnprintf(&builder->buffer[builder->pos], builder->capacity - builder->pos, format, args);
-    builder->pos += len;
+
+    size_t len = (size_t)written;
+    if (len < available) {
+        builder->pos += len;
+        return true;
+    }
+    // Output did not fit, grow and format again
+    dst = builder_claim(builder, len);
+    if (!dst)
+        return false;
+    va_start(args, format);
+    vsnprintf(dst, len + 1, format, args);
     va_end(args);
     return true;
 }
 
-void builder_append_escaped_str(StringBuilder_t* builder, const char* str)
+// Returns the number of leading bytes that need no escaping
+static inline size_t escape_scan(const char* str, size_t len)
 {
-    assert(builder);
-    size_t str_len = strlen(str);
-    if (!builder_ensure_capacity(builder, str_len))
-        return;
-    for (size_t i = 0; i < str_len; i++) {
-        char ch = str[i];
-        switch (ch) {
-        case '\b':
-            builder_append(builder, "\\b");
-            break;
-        case '\n':
-            builder_append(builder, "\\n");
-            break;
-        case '\t':
-            builder_append(builder, "\\t");
-            break;
-        case '\"':
-            builder_append(builder, "\\\"");
-            break;
-        case '\\':
-            builder_append(builder, "\\\\");
+    size_t pos = 0;
+#if defined(__AVX2__)
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+    const __m256i control32 = _mm256_set1_epi8(0x1f);
+    for (; pos + 32 <= len; pos += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)&str[pos]);
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, backslash32));
+        special = _mm256_or_si256(special, _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, control32), chunk));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(special);
+        if (mask)
+            return pos + (size_t)__builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)&str[pos]);
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(special);
+        if (mask)
+            return pos + (size_t)__builtin_ctz(mask);
+    }
+#else
+    // Eight bytes at a time, a lane is flagged if it is below 0x20, a quote or a backslash
+    const uint64_t ones = UINT64_C(0x0101010101010101);
+    const uint64_t highs = UINT64_C(0x8080808080808080);
+    for (; pos + 8 <= len; pos += 8) {
+        uint64_t word;
+        memcpy(&word, &str[pos], sizeof(word));
+        uint64_t quotes = word ^ (ones * '"');
+        uint64_t backslashes = word ^ (ones * '\\');
+        uint64_t special = ((word - ones * 0x20) & ~word) | ((quotes - ones) & ~quotes) | ((backslashes - ones) & ~backslashes);
+        if (special & highs)
             break;
-        default:
-            // Non printable characters
-            if (ch >= 0 && ch < 31)
-                builder_append(builder, "\\u%04x", ch);
-            else
-                builder_append_ch(builder, ch);
+    }
+#endif
+    while (pos < len && !escape_table[(uint8_t)str[pos]])
+        pos++;
+    return pos;
+}
+
+bool builder_needs_escape(const char* str, size_t len)
+{
+    return escape_scan(str, len) != len;
+}
+
+void builder_append_escaped(StringBuilder_t* builder, const char* str, size_t len)
+{
+    assert(builder);
+    size_t pos = 0;
+    while (pos < len) {
+        size_t clean = escape_scan(&str[pos], len - pos);
+        if (clean) {
+            builder_append_str(builder, &str[pos], clean);
+            pos += clean;
+            if (pos == len)
+                break;
         }
+        const char* sequence = escape_table[(uint8_t)str[pos++]];
+        builder_append_str(builder, sequence, sequence[1] == 'u' ? 6 : 2);
     }
 }
 
+void builder_append_escaped_str(StringBuilder_t* builder, const char* str)
+{
+    builder_append_escaped(builder, str, strlen(str));
+}
+
 bool builder_append_unicode(StringBuilder_t* builder, uint32_t code_point)
 {
      if (code_point <= 0x7f) {
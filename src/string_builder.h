@@ -5,17 +5,32 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/*
+ * The buffer is kept NUL terminated after every append. In external mode the builder writes
+ * into caller owned memory and never reallocates. Appends that do not fit set overflow and
+ * only advance pos, so pos + 1 is the size that would have been needed, a failed growth sets
+ * overflow as well. Scoped builders grow with jc_mem_* in the current allocation scope and count
+ * against its limit, buffers handed to callers are plain malloc memory.
+ */
 typedef struct {
     char* buffer;
     size_t capacity;
     size_t pos;
+    bool external;
+    bool scoped;
+    bool overflow;
 } StringBuilder_t;
 
+void builder_use_buffer(StringBuilder_t* builder, char* buffer, size_t capacity);
 void builder_reset(StringBuilder_t* builder);
 bool builder_resize(StringBuilder_t* builder, size_t capacity);
+void builder_free(StringBuilder_t* builder);
 bool builder_append_ch(StringBuilder_t* builder, char ch);
 bool builder_append_chrs(StringBuilder_t* builder, char ch, size_t count);
+bool builder_append_str(StringBuilder_t* builder, const char* str, size_t len);
 bool builder_append(StringBuilder_t* builder, const char* format, ...);
+bool builder_needs_escape(const char* str, size_t len);
+void builder_append_escaped(StringBuilder_t* builder, const char* str, size_t len);
 void builder_append_escaped_str(StringBuilder_t* builder, const char* str);
 bool builder_append_unicode(StringBuilder_t* builder, uint32_t code_point);
 
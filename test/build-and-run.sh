@@ -1,5 +1,11 @@
 #!/bin/bash
 set -euo pipefail
 
-gcc test.c ../src/jc.c ../src/string_builder.c ../src/olh_map.c -I. -I../src -Wextra -Wall -Werror -Wconversion -ggdb -o testsuite
+SOURCES="../src/jc.c ../src/jc_tape.c ../src/jc_alloc.c ../src/jc_stats.c ../src/jc_bind.c ../src/jc_query.c ../src/cbor.c ../src/msgpack.c ../src/string_builder.c ../src/olh_map.c"
+
+gcc test.c $SOURCES -I. -I../src -Wextra -Wall -Werror -Wconversion -ggdb -o testsuite
+./testsuite
+
+# Again with the hot path counters compiled in
+gcc test.c $SOURCES -I. -I../src -Wextra -Wall -Werror -Wconversion -ggdb -DJC_STATS -pthread -o testsuite
 ./testsuite
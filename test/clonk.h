@@ -5,9 +5,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(CLONK_USE_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+#    include <x86intrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -33,13 +37,40 @@ struct ClonkTestCaseEntry {
     ClonkTestCaseEntry* next;
 };
 
+typedef struct {
+    char* name;
+    double median;
+} ClonkBaselineEntry;
+
 typedef struct {
     ClonkTestCaseEntry* test_cases;
     int success_count;
     int fail_count;
     int skip_count;
+    FILE* benchmark_output;
+    ClonkBaselineEntry* baseline;
+    size_t baseline_count;
+    double regression_threshold;
 } TestSuite;
 
+typedef enum {
+    BENCHMARK_WARMUP,
+    BENCHMARK_MEASURE,
+    BENCHMARK_DONE
+} ClonkBenchmarkPhase;
+
+typedef struct {
+    const char* name;
+    size_t bytes;
+    size_t batch;
+    int calibrate;
+    ClonkBenchmarkPhase phase;
+    uint64_t last_ns;
+    uint64_t warmup_ns;
+    uint64_t measure_ns;
+    size_t sample_count;
+} ClonkBenchmark;
+
 /******** Global statics ********/
 static TestSuite s_test_suite = { 0 };
 
@@ -58,10 +89,40 @@ static TestSuite s_test_suite = { 0 };
 #    define ESCP_EXIT ""
 #endif
 
-#ifndef CLONK_BENCHMARK_CYCLES
-#    define CLONK_BENCHMARK_CYCLES 1000000
+// Time spent running a benchmark before samples are recorded, also used to calibrate the batch size
+#ifndef CLONK_BENCHMARK_WARMUP_NS
+#    define CLONK_BENCHMARK_WARMUP_NS 100000000ull
+#endif
+
+// Batches of iterations are grown until a single sample takes at least this long
+#ifndef CLONK_BENCHMARK_SAMPLE_NS
+#    define CLONK_BENCHMARK_SAMPLE_NS 10000ull
+#endif
+
+// Sampling stops once both minimums are reached, or either maximum
+#ifndef CLONK_BENCHMARK_MIN_TIME_NS
+#    define CLONK_BENCHMARK_MIN_TIME_NS 500000000ull
+#endif
+
+#ifndef CLONK_BENCHMARK_MAX_TIME_NS
+#    define CLONK_BENCHMARK_MAX_TIME_NS 3000000000ull
+#endif
+
+#ifndef CLONK_BENCHMARK_MIN_SAMPLES
+#    define CLONK_BENCHMARK_MIN_SAMPLES 10
+#endif
+
+#ifndef CLONK_BENCHMARK_MAX_SAMPLES
+#    define CLONK_BENCHMARK_MAX_SAMPLES 10000
 #endif
 
+// Allowed slowdown of the median against the baseline in percent, can be overridden with -r
+#ifndef CLONK_BENCHMARK_REGRESSION_THRESHOLD
+#    define CLONK_BENCHMARK_REGRESSION_THRESHOLD 10.0
+#endif
+
+static double s_benchmark_samples[CLONK_BENCHMARK_MAX_SAMPLES];
+
 /******** Internal Settings & Helpers ********/
 #define TEST_CASE_NAME(BASE_NAME) test_##BASE_NAME
 #define BENCHMARK_NAME(BASE_NAME) benchmark_##BASE_NAME
@@ -85,6 +146,143 @@ void clonk_add_test(const char* name, TestCaseFunction func, ClonkTestType test_
     last_entry->next = calloc(1, sizeof(ClonkTestCaseEntry));
 }
 
+/******** Benchmark clock ********/
+uint64_t clonk_monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#if defined(CLONK_USE_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+#    define CLONK_TICK_UNIT "cycles"
+static inline uint64_t clonk_ticks(void) { return __rdtsc(); }
+#else
+#    define CLONK_TICK_UNIT "ns"
+static inline uint64_t clonk_ticks(void) { return clonk_monotonic_ns(); }
+#endif
+
+/******** Benchmark baseline ********/
+int clonk_load_baseline(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return 0;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        // name,samples,batch,bytes,min,median,p99,unit
+        char* name_end = strchr(line, ',');
+        if (!name_end || strncmp(line, "name,", 5) == 0)
+            continue;
+        const char* field = name_end;
+        for (int i = 0; field && i < 4; i++)
+            field = strchr(field + 1, ',');
+        if (!field)
+            continue;
+
+        ClonkBaselineEntry* baseline = realloc(s_test_suite.baseline, (s_test_suite.baseline_count + 1) * sizeof(ClonkBaselineEntry));
+        if (!baseline)
+            break;
+        s_test_suite.baseline = baseline;
+        *name_end = '\0';
+        baseline[s_test_suite.baseline_count].name = strdup(line);
+        baseline[s_test_suite.baseline_count].median = strtod(field + 1, NULL);
+        s_test_suite.baseline_count++;
+    }
+    fclose(file);
+    return 1;
+}
+
+const ClonkBaselineEntry* clonk_find_baseline(const char* name)
+{
+    for (size_t i = 0; i < s_test_suite.baseline_count; i++) {
+        if (strcmp(s_test_suite.baseline[i].name, name) == 0)
+            return &s_test_suite.baseline[i];
+    }
+    return NULL;
+}
+
+/******** Benchmark sampling ********/
+void clonk_benchmark_begin(ClonkBenchmark* bm, const char* name, size_t bytes, int calibrate)
+{
+    memset(bm, 0, sizeof(*bm));
+    bm->name = name;
+    bm->bytes = bytes;
+    bm->batch = 1;
+    bm->calibrate = calibrate;
+    bm->phase = BENCHMARK_WARMUP;
+    bm->last_ns = clonk_monotonic_ns();
+}
+
+int clonk_benchmark_next(const ClonkBenchmark* bm) { return bm->phase != BENCHMARK_DONE; }
+
+void clonk_benchmark_sample(ClonkBenchmark* bm, uint64_t ticks)
+{
+    uint64_t now = clonk_monotonic_ns();
+    uint64_t wall = now - bm->last_ns;
+    bm->last_ns = now;
+
+    if (bm->phase == BENCHMARK_WARMUP) {
+        bm->warmup_ns += wall;
+        if (bm->calibrate && wall < CLONK_BENCHMARK_SAMPLE_NS && bm->batch < ((size_t)1 << 30)) {
+            bm->batch *= 2;
+            return;
+        }
+        if (bm->warmup_ns >= CLONK_BENCHMARK_WARMUP_NS)
+            bm->phase = BENCHMARK_MEASURE;
+        return;
+    }
+
+    s_benchmark_samples[bm->sample_count++] = (double)ticks / (double)bm->batch;
+    bm->measure_ns += wall;
+    if ((bm->sample_count >= CLONK_BENCHMARK_MIN_SAMPLES && bm->measure_ns >= CLONK_BENCHMARK_MIN_TIME_NS)
+        || bm->sample_count >= CLONK_BENCHMARK_MAX_SAMPLES || bm->measure_ns >= CLONK_BENCHMARK_MAX_TIME_NS)
+        bm->phase = BENCHMARK_DONE;
+}
+
+int clonk_compare_samples(const void* lhs, const void* rhs)
+{
+    double a = *(const double*)lhs;
+    double b = *(const double*)rhs;
+    return (a > b) - (a < b);
+}
+
+void clonk_benchmark_end(ClonkBenchmark* bm)
+{
+    size_t count = bm->sample_count;
+    qsort(s_benchmark_samples, count, sizeof(double), clonk_compare_samples);
+    double min = s_benchmark_samples[0];
+    double median = count % 2 ? s_benchmark_samples[count / 2]
+                              : (s_benchmark_samples[count / 2 - 1] + s_benchmark_samples[count / 2]) / 2;
+    double p99 = s_benchmark_samples[(count * 99 + 99) / 100 - 1];
+
+    printf(ESCP_INFO "BENCHMARK" ESCP_EXIT "[%s]: min %.1f, median %.1f, p99 %.1f " CLONK_TICK_UNIT "/iter (%zu samples x %zu)",
+        bm->name, min, median, p99, count, bm->batch);
+    if (bm->bytes) {
+        printf(", %.3f " CLONK_TICK_UNIT "/byte", median / (double)bm->bytes);
+        if (strcmp(CLONK_TICK_UNIT, "ns") == 0)
+            printf(", %.2f MB/s", (double)bm->bytes / median * 1e3);
+    }
+    printf("\n");
+
+    if (s_test_suite.benchmark_output)
+        fprintf(s_test_suite.benchmark_output, "%s,%zu,%zu,%zu,%.1f,%.1f,%.1f,%s\n",
+            bm->name, count, bm->batch, bm->bytes, min, median, p99, CLONK_TICK_UNIT);
+
+    const ClonkBaselineEntry* baseline = clonk_find_baseline(bm->name);
+    if (baseline && baseline->median > 0) {
+        double change = (median / baseline->median - 1.0) * 100.0;
+        if (change > s_test_suite.regression_threshold) {
+            printf(ESCP_FAILED "REGRESSION" ESCP_EXIT "[%s]: median %+.1f%% against baseline (threshold %.1f%%)\n",
+                bm->name, change, s_test_suite.regression_threshold);
+            s_test_suite.fail_count++;
+        } else {
+            printf("    %+.1f%% against baseline\n", change);
+        }
+    }
+}
+
 void clonk_free_suite()
 {
     ClonkTestCaseEntry* current = s_test_suite.test_cases;
@@ -93,6 +291,11 @@ void clonk_free_suite()
         free(current);
         current = next;
     }
+    for (size_t i = 0; i < s_test_suite.baseline_count; i++)
+        free(s_test_suite.baseline[i].name);
+    free(s_test_suite.baseline);
+    if (s_test_suite.benchmark_output)
+        fclose(s_test_suite.benchmark_output);
 }
 
 #define FOR_EACH_MATCHING_TEST(CONDITION, BODY)                       \
@@ -108,34 +311,56 @@ void clonk_free_suite()
 
 void clonk_show_usage(char** argv)
 {
-    fprintf(stderr, "Usage: %s [-tblh] [TEST_NAME]...\n", argv[0]);
+    fprintf(stderr, "Usage: %s [-tblh] [-o FILE] [-c FILE] [-r PERCENT] [TEST_NAME]...\n", argv[0]);
     fprintf(stderr, "clonk based test/benchmark executable.\n");
     fprintf(stderr, "Options: \n");
     fprintf(stderr, "  -b    Run benchmarks\n");
     fprintf(stderr, "  -t    Run tests\n");
     fprintf(stderr, "  -l    List available tests\n");
+    fprintf(stderr, "  -o    Write benchmark results as CSV to FILE\n");
+    fprintf(stderr, "  -c    Compare benchmark medians against the results in FILE\n");
+    fprintf(stderr, "  -r    Fail benchmarks whose median regressed more than PERCENT (default %.1f)\n", CLONK_BENCHMARK_REGRESSION_THRESHOLD);
     fprintf(stderr, "  -h    Show this help message\n");
 }
 
 int clonk_run_test_suite(int argc, char** argv)
 {
     int opt;
-    int run_all_tests = 1;
-    while ((opt = getopt(argc, argv, "tblh")) != -1) {
-        run_all_tests = 0;
+    int run_tests = 0;
+    int run_benchmarks = 0;
+    s_test_suite.regression_threshold = CLONK_BENCHMARK_REGRESSION_THRESHOLD;
+    while ((opt = getopt(argc, argv, "tblho:c:r:")) != -1) {
         switch (opt) {
         case 't':
-            RUN_MATCHING_TESTS(test_case->type == TYPE_TEST);
+            run_tests = 1;
             break;
         case 'b':
-            RUN_MATCHING_TESTS(test_case->type == TYPE_BENCHMARK);
+            run_benchmarks = 1;
             break;
         case 'l':
             fprintf(stderr, "Tests: \n");
             FOR_EACH_MATCHING_TEST(test_case->type == TYPE_TEST, fprintf(stderr, "  %s\n", test_case->test_name));
             fprintf(stderr, "Benchmarks: \n");
             FOR_EACH_MATCHING_TEST(test_case->type == TYPE_BENCHMARK, fprintf(stderr, "  %s\n", test_case->test_name));
+            clonk_free_suite();
             return 0;
+        case 'o':
+            s_test_suite.benchmark_output = fopen(optarg, "w");
+            if (!s_test_suite.benchmark_output) {
+                fprintf(stderr, "Could not open '%s' for writing\n", optarg);
+                return 1;
+            }
+            fprintf(s_test_suite.benchmark_output, "name,samples,batch,bytes,min,median,p99,unit\n");
+            break;
+        case 'c':
+            if (!clonk_load_baseline(optarg)) {
+                fprintf(stderr, "Could not read baseline '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'r':
+            s_test_suite.regression_threshold = strtod(optarg, NULL);
+            break;
         case 'h':
             clonk_show_usage(argv);
             return 0;
@@ -145,14 +370,21 @@ int clonk_run_test_suite(int argc, char** argv)
         }
     }
 
+    if (!run_tests && !run_benchmarks)
+        run_tests = run_benchmarks = 1;
+
+#define CLONK_TYPE_SELECTED(TEST_CASE) \
+    ((TEST_CASE)->type == TYPE_TEST ? run_tests : run_benchmarks)
+
     char** positionals = &argv[optind];
-    if (run_all_tests && !*positionals) {
-        RUN_MATCHING_TESTS(1);
+    if (!*positionals) {
+        RUN_MATCHING_TESTS(CLONK_TYPE_SELECTED(test_case));
     } else {
         for (; *positionals; positionals++) {
-            RUN_MATCHING_TESTS(strcmp(test_case->test_name, *positionals) == 0);
+            RUN_MATCHING_TESTS(CLONK_TYPE_SELECTED(test_case) && strcmp(test_case->test_name, *positionals) == 0);
         }
     }
+#undef CLONK_TYPE_SELECTED
 
     printf("Result: " ESCP_SUCCESS "%d Success" ESCP_EXIT ", " ESCP_FAILED
            "%d Failed" ESCP_EXIT ", " ESCP_SKIPPED "%d Skipped" ESCP_EXIT "\n",
@@ -172,20 +404,58 @@ int clonk_run_test_suite(int argc, char** argv)
         return RESULT_SUCCESS;                                   \
     }
 
-#define BENCHMARK(BASE_NAME, BODY)                                                                                               \
-    ClonkTestCaseResult BENCHMARK_NAME(BASE_NAME)(                                                                               \
-        const char* clonk_test_case_base_name)                                                                                   \
-    {                                                                                                                            \
-        struct timeval tval_before, tval_after, tval_result;                                                                     \
-        gettimeofday(&tval_before, NULL);                                                                                        \
-        for (volatile int cbi = 0; cbi < CLONK_BENCHMARK_CYCLES; cbi++) {                                                        \
-            BODY                                                                                                                 \
-        }                                                                                                                        \
-        gettimeofday(&tval_after, NULL);                                                                                         \
-        timersub(&tval_after, &tval_before, &tval_result);                                                                       \
-        uint64_t elapsed_ms = (tval_result.tv_sec * (uint64_t)1000) + (tval_result.tv_usec / 1000);                              \
-        PRINT_TEST_RESULT(ESCP_INFO "BENCHMARK" ESCP_EXIT, ": took %lu ms (%d iterations)", elapsed_ms, CLONK_BENCHMARK_CYCLES); \
-        return RESULT_SUCCESS;                                                                                                   \
+/*
+ * Runs BODY repeatedly and reports min/median/p99 per iteration, BYTES is the amount of data
+ * processed by one iteration (0 if not applicable). Can be used multiple times within a BENCHMARK_GROUP.
+ */
+#define MEASURE(NAME, BYTES, BODY)                                              \
+    do {                                                                        \
+        ClonkBenchmark clonk_benchmark;                                         \
+        clonk_benchmark_begin(&clonk_benchmark, NAME, (size_t)(BYTES), 1);      \
+        while (clonk_benchmark_next(&clonk_benchmark)) {                        \
+            uint64_t clonk_start = clonk_ticks();                               \
+            for (size_t cbi = 0; cbi < clonk_benchmark.batch; cbi++) {          \
+                BODY                                                            \
+            }                                                                   \
+            clonk_benchmark_sample(&clonk_benchmark, clonk_ticks() - clonk_start); \
+        }                                                                       \
+        clonk_benchmark_end(&clonk_benchmark);                                  \
+    } while (0)
+
+/*
+ * Like MEASURE, but runs the untimed SETUP before every iteration. Iterations are not batched and
+ * the time limits include the time spent in SETUP.
+ */
+#define MEASURE_WITH_SETUP(NAME, BYTES, SETUP, BODY)                            \
+    do {                                                                        \
+        ClonkBenchmark clonk_benchmark;                                         \
+        clonk_benchmark_begin(&clonk_benchmark, NAME, (size_t)(BYTES), 0);      \
+        while (clonk_benchmark_next(&clonk_benchmark)) {                        \
+            SETUP                                                               \
+            uint64_t clonk_start = clonk_ticks();                               \
+            BODY                                                                \
+            clonk_benchmark_sample(&clonk_benchmark, clonk_ticks() - clonk_start); \
+        }                                                                       \
+        clonk_benchmark_end(&clonk_benchmark);                                  \
+    } while (0)
+
+#define BENCHMARK(BASE_NAME, BODY)                             \
+    ClonkTestCaseResult BENCHMARK_NAME(BASE_NAME)(             \
+        const char* clonk_test_case_base_name)                 \
+    {                                                          \
+        MEASURE(clonk_test_case_base_name, 0, BODY);           \
+        return RESULT_SUCCESS;                                 \
+    }
+
+/*
+ * Benchmark whose BODY runs once, e.g. to prepare data, and reports through MEASURE.
+ */
+#define BENCHMARK_GROUP(BASE_NAME, BODY)           \
+    ClonkTestCaseResult BENCHMARK_NAME(BASE_NAME)( \
+        const char* clonk_test_case_base_name)     \
+    {                                              \
+        (void)clonk_test_case_base_name;           \
+        BODY return RESULT_SUCCESS;                \
     }
 
 #define VERIFY(EXPRESSION)                                  \
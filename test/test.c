@@ -85,6 +85,57 @@ TEST_CASE(serialize_complex, {
     jc_free_doc(doc);
 })
 
+TEST_CASE(serialize_to_buffer, {
+    JsonDocument_t* doc = jc_doc_from_string("{\"key\":\"value\",\"array\":[1,2.5,\"tab\\t\"]}");
+    char buffer[64];
+    size_t needed = 0;
+    VERIFY(jc_doc_to_buffer(doc, 0, buffer, sizeof(buffer), &needed));
+    VERIFY(strcmp(buffer, "{\"key\":\"value\",\"array\":[1,2.5,\"tab\\t\"]}") == 0);
+    VERIFY(needed == strlen(buffer) + 1);
+
+    char small[8];
+    VERIFY(!jc_doc_to_buffer(doc, 4, small, sizeof(small), &needed));
+    char* expected = jc_doc_to_string(doc, 4);
+    VERIFY(needed == strlen(expected) + 1);
+    VERIFY(!jc_doc_to_buffer(doc, 4, NULL, 0, &needed) && needed == strlen(expected) + 1);
+    free(expected);
+    jc_free_doc(doc);
+})
+
+TEST_CASE(serialize_escapes, {
+    JsonArray_t* arr = jc_new_arr();
+    jc_arr_insert(arr, JC_STRING, "\"\\\b\f\n\r\t\x01\x1f\x7f");
+    jc_arr_insert(arr, JC_STRING, "a long clean run of plain ascii text with a \"quote\" in the middle of it\n");
+    JsonDocument_t* doc = jc_new_doc();
+    jc_doc_set_arr(doc, arr);
+
+    char* serialized = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(serialized, "[\"\\\"\\\\\\b\\f\\n\\r\\t\\u0001\\u001f\x7f\","
+                              "\"a long clean run of plain ascii text with a \\\"quote\\\" in the middle of it\\n\"]")
+        == 0);
+    JsonDocument_t* parsed = jc_doc_from_string(serialized);
+    VERIFY(parsed && strcmp(jc_arr_at(jc_doc_get_arr(parsed), 0)->string, jc_arr_at(arr, 0)->string) == 0);
+    free(serialized);
+    jc_free_doc(parsed);
+    jc_free_doc(doc);
+})
+
+TEST_CASE(string_metadata, {
+    JsonDocument_t* doc = jc_doc_from_string("{\"clean\":\"plain text\",\"dirty\\\"key\":\"line\\nbreak\"}");
+    JsonObject_t* obj = jc_doc_get_obj(doc);
+    JsonValue_t* clean = jc_obj_get(obj, "clean");
+    VERIFY(clean->string_clean && clean->string_len == 10);
+    JsonValue_t* dirty = jc_obj_get(obj, "dirty\"key");
+    VERIFY(dirty && !dirty->string_clean && dirty->string_len == 10);
+
+    VERIFY(jc_value_set_string(clean, "now \"quoted\""));
+    VERIFY(!clean->string_clean && clean->string_len == 12);
+    char* serialized = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(serialized, "{\"clean\":\"now \\\"quoted\\\"\",\"dirty\\\"key\":\"line\\nbreak\"}") == 0);
+    free(serialized);
+    jc_free_doc(doc);
+})
+
 static const char* valid_docs[] = {
     "[]",
     "{}",
@@ -106,6 +157,17 @@ TEST_CASE(serde_valid, {
     }
 })
 
+TEST_CASE(serialized_size, {
+    for (size_t i = 0; valid_docs[i]; i++) {
+        JsonDocument_t* doc = jc_doc_from_string(valid_docs[i]);
+        VERIFY(jc_doc_serialized_size(doc, 0) == strlen(valid_docs[i]));
+        char* pretty = jc_doc_to_string(doc, 2);
+        VERIFY(jc_doc_serialized_size(doc, 2) == strlen(pretty));
+        free(pretty);
+        jc_free_doc(doc);
+    }
+})
+
 static const char* invalid_docs[] = {
     "[NULL]",
     "[01]",
@@ -130,6 +192,18 @@ TEST_CASE(remove_obj, {
     jc_free_doc(doc);
 });
 
+TEST_CASE(remove_reinsert_obj, {
+    JsonDocument_t* doc = jc_doc_from_string("{\"a\":1,\"b\":2,\"c\":3}");
+    JsonObject_t* root_obj = jc_doc_get_obj(doc);
+    VERIFY(jc_obj_remove(root_obj, "a") && jc_obj_remove(root_obj, "c"));
+    VERIFY(jc_obj_set(root_obj, "c", jc_new_int64_value(3)));
+    VERIFY(jc_obj_set(root_obj, "a", jc_new_int64_value(1)));
+    char* serialized = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(serialized, "{\"b\":2,\"c\":3,\"a\":1}") == 0);
+    free(serialized);
+    jc_free_doc(doc);
+});
+
 TEST_CASE(remove_arr, {
     JsonArray_t* arr = jc_new_arr();
     for(double i = 0; i < 5; i++)
@@ -141,6 +215,1015 @@ TEST_CASE(remove_arr, {
     VERIFY(jc_arr_size(arr) == 3);
 })
 
+// depth nested arrays around nothing, closed only when closed is set
+static char* nested_text(size_t depth, bool closed)
+{
+    char* text = malloc(2 * depth + 1);
+    if (text) {
+        memset(text, '[', depth);
+        memset(&text[depth], closed ? ']' : '\0', depth);
+        text[2 * depth] = '\0';
+    }
+    return text;
+}
+
+TEST_CASE(tape_cursor, {
+    JsonTape_t* tape = jc_tape_from_string("{\"name\":\"jc\",\"list\":[1,2.5,true,null],\"nested\":{\"key\":\"v\\n\"}}");
+    VERIFY(tape);
+    JsonTapeCursor_t root = jc_tape_root(tape);
+    VERIFY(jc_tape_type(root) == JC_OBJECT && jc_tape_size(root) == 3);
+
+    JsonTapeCursor_t list;
+    VERIFY(jc_tape_obj_find(root, "list", &list) && jc_tape_size(list) == 4);
+    JsonTapeCursor_t elem;
+    int64_t i64 = 0;
+    VERIFY(jc_tape_arr_first(list, &elem) && jc_tape_get_int64(elem, &i64) && i64 == 1);
+    double dbl = 0;
+    VERIFY(jc_tape_arr_next(&elem) && jc_tape_get_double(elem, &dbl) && dbl == 2.5);
+    VERIFY(jc_tape_arr_at(list, 3, &elem) && jc_tape_type(elem) == JC_NULL_LITERAL);
+    VERIFY(!jc_tape_arr_next(&elem));
+
+    JsonTapeCursor_t nested;
+    JsonTapeCursor_t value;
+    VERIFY(jc_tape_obj_find(root, "nested", &nested) && jc_tape_obj_find(nested, "key", &value));
+    size_t len = 0;
+    VERIFY(strcmp(jc_tape_get_string(value, &len), "v\n") == 0 && len == 2);
+    VERIFY(!jc_tape_obj_find(root, "missing", &value));
+    jc_free_tape(tape);
+
+    VERIFY(!jc_tape_from_string("[1,]"));
+
+    // Nesting is bounded like in the binary readers instead of overflowing the stack
+    char* text = nested_text(256, true);
+    tape = jc_tape_from_string(text);
+    VERIFY(tape);
+    jc_free_tape(tape);
+    JsonDocument_t* doc = jc_doc_from_string(text);
+    free(text);
+    text = nested_text(257, true);
+    VERIFY(!jc_tape_from_string(text));
+    JsonDocument_t* deep = jc_doc_from_string(text);
+    VERIFY(doc && deep);
+    VERIFY(!jc_tape_from_doc(deep));
+    tape = jc_tape_from_doc(doc);
+    VERIFY(tape);
+    jc_free_tape(tape);
+    jc_free_doc(deep);
+    jc_free_doc(doc);
+    free(text);
+    text = nested_text(2000000, false);
+    VERIFY(text && !jc_tape_from_string(text));
+    free(text);
+})
+
+TEST_CASE(tape_doc_roundtrip, {
+    for (size_t i = 0; valid_docs[i]; i++) {
+        JsonDocument_t* doc = jc_doc_from_string(valid_docs[i]);
+        JsonTape_t* tape = jc_tape_from_doc(doc);
+        VERIFY(tape);
+        JsonDocument_t* converted = jc_tape_to_doc(tape);
+        VERIFY(converted);
+        char* serialized = jc_doc_to_string(converted, 0);
+        VERIFY(strcmp(valid_docs[i], serialized) == 0);
+        free(serialized);
+        jc_free_doc(converted);
+        jc_free_tape(tape);
+        jc_free_doc(doc);
+    }
+})
+
+// Writes a copy of an image with a few bytes replaced and tries to open it
+static bool open_patched_image(const char* image, size_t len, size_t at, const void* bytes, size_t n)
+{
+    char* copy = malloc(len);
+    memcpy(copy, image, len);
+    memcpy(&copy[at], bytes, n);
+    FILE* file = fopen("patched_image_test.bin", "wb");
+    bool written = file && fwrite(copy, 1, len, file) == len;
+    if (file)
+        fclose(file);
+    free(copy);
+    JsonTape_t* tape = written ? jc_tape_open_binary("patched_image_test.bin") : NULL;
+    remove("patched_image_test.bin");
+    jc_free_tape(tape);
+    return tape != NULL;
+}
+
+TEST_CASE(binary_image, {
+    JsonObject_t* obj = jc_new_obj();
+    char key[32];
+    for (int64_t i = 0; i < 20; i++) {
+        snprintf(key, sizeof(key), "key%ld", i);
+        jc_obj_insert(obj, key, JC_INT64, &i);
+    }
+    JsonObject_t* nested = jc_new_obj();
+    int64_t inner = 1;
+    jc_obj_insert(nested, "inner", JC_INT64, &inner);
+    jc_obj_insert(obj, "nested", JC_OBJECT, nested);
+    jc_obj_insert(obj, "text", JC_STRING, "value");
+    JsonDocument_t* doc = jc_new_doc();
+    jc_doc_set_obj(doc, obj);
+    VERIFY(jc_doc_save_binary(doc, "binary_image_test.bin"));
+
+    char image[4096];
+    FILE* file = fopen("binary_image_test.bin", "rb");
+    size_t image_len = file ? fread(image, 1, sizeof(image), file) : 0;
+    if (file)
+        fclose(file);
+    JsonTape_t* tape = jc_tape_open_binary("binary_image_test.bin");
+    remove("binary_image_test.bin");
+    VERIFY(tape && image_len > 32 && image_len < sizeof(image));
+    JsonTapeCursor_t root = jc_tape_root(tape);
+    JsonTapeCursor_t value;
+    for (int64_t i = 0; i < 20; i++) {
+        snprintf(key, sizeof(key), "key%ld", i);
+        int64_t i64 = -1;
+        VERIFY(jc_tape_obj_find(root, key, &value) && jc_tape_get_int64(value, &i64) && i64 == i);
+    }
+    VERIFY(jc_tape_obj_find(root, "nested", &value) && jc_tape_type(value) == JC_OBJECT);
+    // Slots relative to the root, pointing at a key of the nested object and at a string value
+    uint32_t nested_key = (uint32_t)value.index + 1;
+    VERIFY(jc_tape_obj_find(root, "text", &value) && jc_tape_type(value) == JC_STRING);
+    uint32_t string_value = (uint32_t)value.index;
+    VERIFY(!jc_tape_obj_find(root, "key20", &value));
+
+    JsonDocument_t* loaded = jc_tape_to_doc(tape);
+    char* expected = jc_doc_to_string(doc, 0);
+    char* serialized = jc_doc_to_string(loaded, 0);
+    VERIFY(strcmp(expected, serialized) == 0);
+    free(expected);
+    free(serialized);
+    jc_free_doc(loaded);
+    jc_free_tape(tape);
+    jc_free_doc(doc);
+
+    VERIFY(!jc_tape_open_binary("does_not_exist.bin"));
+
+    // Corrupt string references and key tables are rejected at open
+    uint64_t word_count;
+    uint64_t index_len;
+    memcpy(&word_count, &image[8], sizeof(word_count));
+    memcpy(&index_len, &image[16], sizeof(index_len));
+    size_t index_at = 32 + word_count * 8;
+    size_t strings_at = index_at + index_len * 4;
+    uint64_t key_word;
+    memcpy(&key_word, &image[40], sizeof(key_word));
+    VERIFY(open_patched_image(image, image_len, 40, &key_word, sizeof(key_word)));
+    uint64_t far_key = (key_word & ~UINT64_C(0xffffffff)) | 0xfffffff;
+    VERIFY(!open_patched_image(image, image_len, 40, &far_key, sizeof(far_key)));
+    uint64_t stray_close = (uint64_t)'}' << 56;
+    VERIFY(!open_patched_image(image, image_len, 40, &stray_close, sizeof(stray_close)));
+    uint32_t long_len = 0x7fffffff;
+    VERIFY(!open_patched_image(image, image_len, strings_at, &long_len, sizeof(long_len)));
+    uint32_t odd_capacity = 3;
+    VERIFY(index_len > 0 && !open_patched_image(image, image_len, index_at, &odd_capacity, sizeof(odd_capacity)));
+    uint32_t far_slot = 0xffff;
+    size_t slot_at = index_at + 4;
+    uint32_t slot = 0;
+    while (memcpy(&slot, &image[slot_at], sizeof(slot)), slot == 0)
+        slot_at += 4;
+    VERIFY(!open_patched_image(image, image_len, slot_at, &far_slot, sizeof(far_slot)));
+    VERIFY(!open_patched_image(image, image_len, slot_at, &nested_key, sizeof(nested_key)));
+    VERIFY(!open_patched_image(image, image_len, slot_at, &string_value, sizeof(string_value)));
+
+    // Without an empty slot a lookup of a missing key would probe forever
+    uint32_t capacity;
+    memcpy(&capacity, &image[index_at], sizeof(capacity));
+    uint32_t full_table[64];
+    VERIFY(capacity <= 64);
+    memcpy(full_table, &image[slot_at], sizeof(uint32_t));
+    for (uint32_t i = 1; i < capacity; i++)
+        full_table[i] = full_table[0];
+    VERIFY(!open_patched_image(image, image_len, index_at + 4, full_table, capacity * sizeof(uint32_t)));
+})
+
+static const char* binary_docs[] = {
+    "[]",
+    "{}",
+    "[0,23,24,255,256,65536,4294967296,-1,-24,-25,-129,-40000,-9223372036854775807,0.5,1e+300,true,false,null,\"\"]",
+    "{\"key\":\"value\",\"array\":[\"Item1\",2,{\"k\":[]}],\"long string value over thirty-one bytes\":null}",
+    NULL
+};
+
+// {"a": 1.0} with a half precision float as value
+static const uint8_t cbor_half_float[] = { 0xa1, 0x61, 'a', 0xf9, 0x3c, 0x00 };
+
+// depth single member array heads around one leaf byte
+static uint8_t* nested_binary(uint8_t head, uint8_t leaf, size_t depth)
+{
+    uint8_t* data = malloc(depth + 1);
+    if (data) {
+        memset(data, head, depth);
+        data[depth] = leaf;
+    }
+    return data;
+}
+
+TEST_CASE(cbor_roundtrip, {
+    for (size_t i = 0; binary_docs[i]; i++) {
+        JsonDocument_t* doc = jc_doc_from_string(binary_docs[i]);
+        size_t len = 0;
+        uint8_t* encoded = jc_doc_to_cbor(doc, &len);
+        VERIFY(encoded);
+        JsonDocument_t* decoded = jc_doc_from_cbor(encoded, len);
+        VERIFY(decoded);
+        char* serialized = jc_doc_to_string(decoded, 0);
+        VERIFY(strcmp(binary_docs[i], serialized) == 0);
+        VERIFY(!jc_doc_from_cbor(encoded, len - 1));
+        free(serialized);
+        free(encoded);
+        jc_free_doc(decoded);
+        jc_free_doc(doc);
+    }
+    JsonDocument_t* doc = jc_doc_from_cbor(cbor_half_float, sizeof(cbor_half_float));
+    double dbl = 0;
+    VERIFY(doc && jc_obj_get_double(jc_doc_get_obj(doc), "a", &dbl) && dbl == 1.0);
+    jc_free_doc(doc);
+
+    // Nesting is bounded instead of exhausting the stack
+    uint8_t* nested = nested_binary(0x81, 0x01, 100);
+    VERIFY(nested && (doc = jc_doc_from_cbor(nested, 101)) != NULL);
+    jc_free_doc(doc);
+    free(nested);
+    nested = nested_binary(0x81, 0x01, 2000000);
+    VERIFY(nested && !jc_doc_from_cbor(nested, 2000001));
+    free(nested);
+})
+
+TEST_CASE(msgpack_roundtrip, {
+    for (size_t i = 0; binary_docs[i]; i++) {
+        JsonDocument_t* doc = jc_doc_from_string(binary_docs[i]);
+        size_t len = 0;
+        uint8_t* encoded = jc_doc_to_msgpack(doc, &len);
+        VERIFY(encoded);
+        JsonDocument_t* decoded = jc_doc_from_msgpack(encoded, len);
+        VERIFY(decoded);
+        char* serialized = jc_doc_to_string(decoded, 0);
+        VERIFY(strcmp(binary_docs[i], serialized) == 0);
+        VERIFY(!jc_doc_from_msgpack(encoded, len - 1));
+        free(serialized);
+        free(encoded);
+        jc_free_doc(decoded);
+        jc_free_doc(doc);
+    }
+
+    uint8_t* nested = nested_binary(0x91, 0x01, 100);
+    JsonDocument_t* doc = nested ? jc_doc_from_msgpack(nested, 101) : NULL;
+    VERIFY(doc);
+    jc_free_doc(doc);
+    free(nested);
+    nested = nested_binary(0x91, 0x01, 2000000);
+    VERIFY(nested && !jc_doc_from_msgpack(nested, 2000001));
+    free(nested);
+})
+
+typedef struct {
+    size_t allocs;
+    size_t frees;
+} AllocCounter_t;
+
+static void* counting_alloc(void* ctx, size_t size)
+{
+    ((AllocCounter_t*)ctx)->allocs++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* ctx, void* ptr, size_t size)
+{
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* ctx, void* ptr)
+{
+    ((AllocCounter_t*)ctx)->frees++;
+    free(ptr);
+}
+
+static AllocCounter_t alloc_counter;
+static const JsonAllocator_t counting_allocator = { counting_alloc, counting_realloc, counting_free, &alloc_counter };
+
+TEST_CASE(doc_allocator, {
+    alloc_counter = (AllocCounter_t) { 0 };
+    JsonDocument_t* doc = jc_doc_from_string_with_allocator("{\"a\":[1,2,\"x\"],\"b\":{\"c\":null}}", &counting_allocator);
+    // Unescaping buffers come from the allocator as well and are released during the parse
+    VERIFY(doc && alloc_counter.allocs > alloc_counter.frees && alloc_counter.frees > 0);
+    JsonAllocStats_t stats;
+    VERIFY(jc_doc_alloc_stats(doc, &stats) && stats.live_allocations == alloc_counter.allocs - alloc_counter.frees - 1);
+    size_t live_bytes = stats.live_bytes;
+
+    jc_use_doc_allocator(doc);
+    VERIFY(jc_obj_set(jc_doc_get_obj(doc), "d", jc_new_int64_value(1)));
+    jc_use_doc_allocator(NULL);
+    VERIFY(jc_doc_alloc_stats(doc, &stats) && stats.live_bytes > live_bytes && stats.peak_bytes >= stats.live_bytes);
+
+    jc_obj_remove(jc_doc_get_obj(doc), "a");
+    VERIFY(jc_doc_alloc_stats(doc, &stats) && stats.live_bytes < stats.peak_bytes);
+    jc_free_doc(doc);
+    VERIFY(alloc_counter.allocs == alloc_counter.frees);
+})
+
+TEST_CASE(global_allocator, {
+    alloc_counter = (AllocCounter_t) { 0 };
+    VERIFY(jc_set_allocator(&counting_allocator));
+    JsonObject_t* obj = jc_new_obj();
+    VERIFY(obj && jc_obj_insert(obj, "key", JC_STRING, "value"));
+    VERIFY(jc_set_allocator(NULL));
+    size_t allocs = alloc_counter.allocs;
+    VERIFY(allocs >= 4);
+    // Memory is released through the allocator it came from
+    jc_free_obj(obj);
+    VERIFY(alloc_counter.frees == allocs - 1);
+
+    // Internal buffers of queries and tapes come from the allocator as well
+    VERIFY(jc_set_allocator(&counting_allocator));
+    allocs = alloc_counter.allocs;
+    size_t frees = alloc_counter.frees;
+    JsonQuery_t* query = jc_query_compile("$.a[?(@.b==\"x\")]");
+    JsonTape_t* tape = jc_tape_from_string("{\"a\":\"x\\n\"}");
+    VERIFY(query && tape && alloc_counter.allocs >= allocs + 5);
+    jc_query_free(query);
+    jc_free_tape(tape);
+    VERIFY(jc_set_allocator(NULL));
+    VERIFY(alloc_counter.allocs - allocs == alloc_counter.frees - frees);
+})
+
+TEST_CASE(parse_limits, {
+    JsonParseError_t error;
+    JsonParseOptions_t options = { 0 };
+    options.max_depth = 2;
+    VERIFY(!jc_doc_from_string_with_options("{\"a\":[[1]]}", &options, &error));
+    VERIFY(error.code == JC_PARSE_TOO_DEEP && error.offset == 6);
+
+    options = (JsonParseOptions_t) { .max_string_len = 3 };
+    VERIFY(!jc_doc_from_string_with_options("[\"abc\",\"abcd\"]", &options, &error));
+    VERIFY(error.code == JC_PARSE_STRING_TOO_LONG && error.offset == 12);
+
+    options = (JsonParseOptions_t) { .max_nodes = 3 };
+    VERIFY(!jc_doc_from_string_with_options("[1,2,3]", &options, &error));
+    VERIFY(error.code == JC_PARSE_TOO_MANY_NODES && error.offset == 5);
+
+    options = (JsonParseOptions_t) { .max_object_keys = 1 };
+    VERIFY(!jc_doc_from_string_with_options("{\"a\":{\"b\":1},\"c\":2}", &options, &error));
+    VERIFY(error.code == JC_PARSE_TOO_MANY_KEYS && error.offset == 13);
+
+    options = (JsonParseOptions_t) { .max_input_bytes = 4 };
+    VERIFY(!jc_doc_from_string_with_options("[1,2]", &options, &error));
+    VERIFY(error.code == JC_PARSE_INPUT_TOO_LARGE && error.offset == 4);
+
+    options = (JsonParseOptions_t) { .max_alloc_bytes = 128 };
+    VERIFY(!jc_doc_from_string_with_options("[]", &options, &error));
+    VERIFY(error.code == JC_PARSE_ALLOC_LIMIT);
+
+    VERIFY(!jc_doc_from_string_with_options("[1,]", NULL, &error));
+    VERIFY(error.code == JC_PARSE_SYNTAX_ERROR && error.offset == 3);
+
+    // Objects which can't grow their bucket table under the limit fail instead of filling it up
+    char keys[512];
+    size_t pos = 0;
+    for (int i = 0; i < 40; i++)
+        pos += (size_t)snprintf(&keys[pos], sizeof(keys) - pos, "%s\"k%d\":1", i ? "," : "{", i);
+    snprintf(&keys[pos], sizeof(keys) - pos, "}");
+    for (size_t limit = 100; limit <= 4000; limit += 20) {
+        options = (JsonParseOptions_t) { .max_alloc_bytes = limit };
+        JsonDocument_t* doc = jc_doc_from_string_with_options(keys, &options, &error);
+        VERIFY(doc ? error.code == JC_PARSE_OK && jc_obj_size(jc_doc_get_obj(doc)) == 40 : error.code == JC_PARSE_ALLOC_LIMIT);
+        jc_free_doc(doc);
+    }
+
+    // Unescaping buffers count against the limit while they grow, not only the finished string
+    size_t escaped_len = 200000;
+    char* escaped = malloc(escaped_len + 8);
+    VERIFY(escaped);
+    for (size_t i = 0; i < escaped_len; i += 2)
+        memcpy(&escaped[2 + i], "\\n", 2);
+    memcpy(escaped, "[\"", 2);
+    memcpy(&escaped[2 + escaped_len], "\"]", 3);
+    options = (JsonParseOptions_t) { .max_alloc_bytes = 4096 };
+    VERIFY(!jc_doc_from_string_with_options(escaped, &options, &error));
+    VERIFY(error.code == JC_PARSE_ALLOC_LIMIT && error.offset < 20000);
+    escaped[0] = '{';
+    memcpy(&escaped[2 + escaped_len], "\":1}", 5);
+    VERIFY(!jc_doc_from_string_with_options(escaped, &options, &error));
+    VERIFY(error.code == JC_PARSE_ALLOC_LIMIT && error.offset < 20000);
+    free(escaped);
+
+    options = (JsonParseOptions_t) { .max_depth = 2 };
+    options.max_nodes = 4;
+    options.max_string_len = 3;
+    options.max_alloc_bytes = 4096;
+    JsonDocument_t* doc = jc_doc_from_string_with_options("{\"abc\":[true]}", &options, &error);
+    VERIFY(doc && error.code == JC_PARSE_OK);
+    jc_free_doc(doc);
+})
+
+TEST_CASE(stats_snapshot, {
+    JsonStats_t before;
+    if (!jc_stats_snapshot(&before)) {
+        VERIFY(before.bytes_scanned == 0 && before.objects_created == 0);
+        SKIP();
+    }
+    const char* text = "{\"a\":[1,2.5,\"x\\n\"],\"b\":{}}";
+    JsonDocument_t* doc = jc_doc_from_string(text);
+    VERIFY(doc && jc_obj_get(jc_doc_get_obj(doc), "a"));
+    JsonStats_t after;
+    VERIFY(jc_stats_snapshot(&after));
+    jc_free_doc(doc);
+
+    VERIFY(after.bytes_scanned - before.bytes_scanned == strlen(text));
+    VERIFY(after.objects_created - before.objects_created == 2);
+    VERIFY(after.arrays_created - before.arrays_created == 1);
+    VERIFY(after.numbers_int64 - before.numbers_int64 == 1);
+    VERIFY(after.numbers_double - before.numbers_double == 1);
+    VERIFY(after.strings_unescaped - before.strings_unescaped == 3);
+    VERIFY(after.bytes_unescaped - before.bytes_unescaped == 4);
+    uint64_t read_probes = 0;
+    uint64_t write_probes = 0;
+    for (size_t i = 0; i < JC_STATS_PROBE_BUCKETS; i++) {
+        read_probes += after.map_read_probes[i] - before.map_read_probes[i];
+        write_probes += after.map_write_probes[i] - before.map_write_probes[i];
+    }
+    VERIFY(read_probes == 1 && write_probes == 2);
+})
+
+TEST_CASE(memory_usage, {
+    JsonDocument_t* doc = jc_doc_from_string("{\"a\":[1,\"abc\",{\"b\":null}],\"c\":true}");
+    VERIFY(doc && jc_obj_remove(jc_doc_get_obj(doc), "c"));
+    JsonMemoryUsage_t usage;
+    VERIFY(jc_doc_memory_usage(doc, &usage));
+    VERIFY(usage.string_bytes == 4 && usage.key_bytes == 4);
+    VERIFY(usage.value_bytes == 5 * sizeof(JsonValue_t));
+    VERIFY(usage.bucket_tombstone_bytes > 0 && usage.array_slack_bytes > 0);
+
+    // Everything the document allocated is accounted for
+    JsonAllocStats_t stats;
+    VERIFY(jc_doc_alloc_stats(doc, &stats));
+    VERIFY(usage.allocations == stats.live_allocations);
+    VERIFY(usage.total_bytes - usage.allocator_overhead == stats.live_bytes);
+
+    JsonMemoryUsage_t arr_usage;
+    VERIFY(jc_arr_memory_usage(jc_obj_get_arr(jc_doc_get_obj(doc), "a"), &arr_usage));
+    VERIFY(arr_usage.total_bytes < usage.total_bytes && arr_usage.key_bytes == 2);
+    jc_free_doc(doc);
+})
+
+TEST_CASE(compact_doc, {
+    const char* text = "{\"a\":[1,2,3],\"b\":{\"c\":\"x\",\"d\":[]},\"e\":null}";
+    JsonDocument_t* doc = jc_doc_from_string(text);
+    VERIFY(doc && jc_obj_remove(jc_doc_get_obj(doc), "e"));
+    char* expected = jc_doc_to_string(doc, 0);
+    JsonMemoryUsage_t before;
+    JsonMemoryUsage_t after;
+    VERIFY(jc_doc_memory_usage(doc, &before));
+    VERIFY(jc_doc_compact(doc, false));
+    VERIFY(jc_doc_memory_usage(doc, &after));
+    VERIFY(after.bucket_tombstone_bytes == 0 && after.array_slack_bytes < before.array_slack_bytes);
+    VERIFY(after.total_bytes < before.total_bytes);
+
+    JsonAllocStats_t stats;
+    VERIFY(jc_doc_alloc_stats(doc, &stats));
+    size_t allocations = stats.live_allocations;
+    VERIFY(jc_doc_compact(doc, true) && jc_doc_compact(doc, true));
+    VERIFY(jc_doc_alloc_stats(doc, &stats) && stats.live_allocations == allocations);
+    char* str = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(str, expected) == 0);
+    free(str);
+    free(expected);
+
+    // Compacted documents stay mutable
+    JsonObject_t* obj = jc_doc_get_obj(doc);
+    VERIFY(jc_obj_insert(obj, "f", JC_STRING, "new") && jc_obj_remove(obj, "a"));
+    VERIFY(jc_arr_insert(jc_obj_get_arr(jc_obj_get_obj(obj, "b"), "d"), JC_STRING, "y"));
+    VERIFY(strcmp(jc_obj_get_string(obj, "f"), "new") == 0);
+    jc_free_doc(doc);
+
+    // Removing from an array without slack only moves the elements after the range
+    doc = jc_doc_from_string("[1,2,3,4,5]");
+    VERIFY(doc && jc_doc_compact(doc, false));
+    JsonArray_t* arr = jc_doc_get_arr(doc);
+    VERIFY(jc_arr_remove(arr, 1, 2) && jc_arr_size(arr) == 3);
+    VERIFY(!jc_arr_remove(arr, 1, SIZE_MAX));
+    str = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(str, "[1,4,5]") == 0);
+    free(str);
+    jc_free_doc(doc);
+})
+
+TEST_CASE(reserve_capacity, {
+    JsonObject_t* obj = jc_new_obj_with_capacity(100);
+    JsonArray_t* arr = jc_new_arr();
+    VERIFY(obj && arr && jc_arr_reserve(arr, 100));
+    JsonMemoryUsage_t obj_before;
+    JsonMemoryUsage_t arr_before;
+    VERIFY(jc_obj_memory_usage(obj, &obj_before) && jc_arr_memory_usage(arr, &arr_before));
+    char key[16];
+    for (int64_t i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", (int)i);
+        VERIFY(jc_obj_insert(obj, key, JC_INT64, &i) && jc_arr_insert(arr, JC_INT64, &i));
+    }
+    // Neither was resized while filling it
+    JsonMemoryUsage_t usage;
+    VERIFY(jc_obj_memory_usage(obj, &usage));
+    VERIFY(usage.bucket_bytes + usage.bucket_empty_bytes == obj_before.bucket_empty_bytes);
+    VERIFY(jc_arr_memory_usage(arr, &usage));
+    VERIFY(usage.array_bytes + usage.array_slack_bytes == arr_before.array_slack_bytes);
+    VERIFY(jc_obj_reserve(obj, 10) && jc_obj_size(obj) == 100);
+    jc_free_obj(obj);
+    jc_free_arr(arr);
+})
+
+TEST_CASE(presized_parse, {
+    const char* text = "{\"a\":[1,2,3],\"b\":{\"c\":[],\"d\":\"x,y[{\\\"\"},\"e\":[{}]}";
+    JsonParseOptions_t options = { 0 };
+    options.presize_containers = true;
+    JsonDocument_t* doc = jc_doc_from_string_with_options(text, &options, NULL);
+    JsonDocument_t* expected = jc_doc_from_string(text);
+    VERIFY(doc && expected);
+    char* str = jc_doc_to_string(doc, 0);
+    char* expected_str = jc_doc_to_string(expected, 0);
+    VERIFY(strcmp(str, expected_str) == 0);
+    free(str);
+    free(expected_str);
+
+    JsonMemoryUsage_t usage;
+    VERIFY(jc_arr_memory_usage(jc_obj_get_arr(jc_doc_get_obj(doc), "a"), &usage));
+    VERIFY(usage.array_slack_bytes == sizeof(JsonValue_t*));
+    JsonMemoryUsage_t expected_usage;
+    VERIFY(jc_doc_memory_usage(doc, &usage) && jc_doc_memory_usage(expected, &expected_usage));
+    VERIFY(usage.total_bytes < expected_usage.total_bytes);
+    jc_free_doc(doc);
+    jc_free_doc(expected);
+
+    // The hints are collected before parsing and count against the limit
+    char many[1 + 500 * 3 + 1];
+    many[0] = '[';
+    for (int i = 0; i < 500; i++)
+        memcpy(&many[1 + i * 3], i < 499 ? "[]," : "[]]", 3);
+    many[sizeof(many) - 1] = '\0';
+    JsonParseError_t error;
+    options.max_alloc_bytes = 1024;
+    VERIFY(!jc_doc_from_string_with_options(many, &options, &error));
+    VERIFY(error.code == JC_PARSE_ALLOC_LIMIT && error.offset == 0);
+    options.max_alloc_bytes = 0;
+    doc = jc_doc_from_string_with_options(many, &options, NULL);
+    VERIFY(doc && jc_arr_size(jc_doc_get_arr(doc)) == 500);
+    jc_free_doc(doc);
+})
+
+TEST_CASE(prehashed_keys, {
+    JsonKey_t user_id = JC_KEY("user_id");
+    JsonKey_t runtime = jc_key("user_id");
+    VERIFY(user_id.len == 7 && user_id.hash == runtime.hash);
+
+    JsonObject_t* obj = jc_new_obj();
+    int64_t id = 42;
+    VERIFY(obj && jc_obj_insert(obj, "user_id", JC_INT64, &id));
+    JsonValue_t* value = jc_obj_get_k(obj, user_id);
+    VERIFY(value && value->num_int64 == 42);
+    VERIFY(!jc_obj_get_k(obj, JC_KEY("user_i")) && !jc_obj_get_k(obj, jc_key("user_idx")));
+
+    VERIFY(jc_obj_set_k(obj, JC_KEY("name"), jc_new_value(JC_STRING, "jc")));
+    VERIFY(jc_obj_set_k(obj, user_id, jc_new_int64_value(7)));
+    VERIFY(jc_obj_size(obj) == 2 && strcmp(jc_obj_get_string(obj, "name"), "jc") == 0);
+    VERIFY(jc_obj_get_int64(obj, "user_id", &id) && id == 7);
+    jc_free_obj(obj);
+})
+
+typedef struct {
+    int64_t id;
+    char* name;
+} BindUser_t;
+
+typedef struct {
+    int64_t id;
+    double score;
+    bool active;
+    char code[4];
+    char* text;
+    BindUser_t owner;
+    int64_t* tags;
+    size_t tag_count;
+    BindUser_t* users;
+    size_t user_count;
+} BindMessage_t;
+
+static const JsonField_t bind_user_fields[] = {
+    JC_FIELD(BindUser_t, id, JC_FIELD_INT64),
+    JC_FIELD(BindUser_t, name, JC_FIELD_STRING),
+};
+static const JsonSchema_t bind_user_schema = JC_SCHEMA(BindUser_t, bind_user_fields);
+
+static const JsonField_t bind_message_fields[] = {
+    JC_FIELD(BindMessage_t, id, JC_FIELD_INT64),
+    JC_FIELD(BindMessage_t, score, JC_FIELD_DOUBLE),
+    JC_FIELD(BindMessage_t, active, JC_FIELD_BOOL),
+    JC_FIELD(BindMessage_t, code, JC_FIELD_STRING_BUF),
+    JC_FIELD(BindMessage_t, text, JC_FIELD_STRING),
+    JC_FIELD_OBJ(BindMessage_t, owner, &bind_user_schema),
+    JC_FIELD_ARR(BindMessage_t, tags, tag_count, JC_FIELD_INT64, NULL),
+    JC_FIELD_ARR(BindMessage_t, users, user_count, JC_FIELD_OBJECT, &bind_user_schema),
+};
+static const JsonSchema_t bind_message_schema = JC_SCHEMA(BindMessage_t, bind_message_fields);
+
+// One value of the wrong type per field type, the error points at the value
+static const char* const bind_mismatches[] = {
+    "{\"id\":\"7\"}", "{\"id\":99999999999999999999}", "{\"score\":\"x\"}", "{\"active\":1}",
+    "{\"code\":[]}", "{\"text\":5}", "{\"owner\":true}", "{\"tags\":{}}", "{\"tags\":[false]}",
+};
+static const size_t bind_mismatch_offsets[] = { 6, 6, 9, 10, 8, 8, 9, 8, 9 };
+
+TEST_CASE(struct_binding, {
+    const char* text = "{\"unknown\":{\"a\":[1,\"]}\",{}]},\"score\":2,\"id\":7,\"active\":true,\"code\":\"abc\","
+                       "\"te\\u0078t\":\"line\\n\",\"owner\":{\"name\":\"jc\",\"id\":1},\"tags\":[3,4,5],"
+                       "\"users\":[{\"id\":2},null],\"extra\":null}";
+    BindMessage_t msg;
+    JsonParseError_t error;
+    VERIFY(jc_bind_from_string(&bind_message_schema, text, &msg, &error) && error.code == JC_PARSE_OK);
+    VERIFY(msg.id == 7 && msg.score == 2.0 && msg.active && strcmp(msg.code, "abc") == 0);
+    VERIFY(strcmp(msg.text, "line\n") == 0 && msg.owner.id == 1 && strcmp(msg.owner.name, "jc") == 0);
+    VERIFY(msg.tag_count == 3 && msg.tags[2] == 5);
+    VERIFY(msg.user_count == 2 && msg.users[0].id == 2 && !msg.users[0].name && msg.users[1].id == 0);
+
+    char* str = jc_bind_to_string(&bind_message_schema, &msg);
+    VERIFY(str && strcmp(str, "{\"id\":7,\"score\":2,\"active\":true,\"code\":\"abc\",\"text\":\"line\\n\","
+                             "\"owner\":{\"id\":1,\"name\":\"jc\"},\"tags\":[3,4,5],"
+                             "\"users\":[{\"id\":2,\"name\":null},{\"id\":0,\"name\":null}]}") == 0);
+    free(str);
+    jc_bind_free(&bind_message_schema, &msg);
+    VERIFY(!msg.text && !msg.tags && msg.user_count == 0);
+
+    VERIFY(!jc_bind_from_string(&bind_message_schema, "{\"id\":1.5}", &msg, &error));
+    VERIFY(error.code == JC_PARSE_TYPE_MISMATCH && error.offset == 6);
+    VERIFY(!jc_bind_from_string(&bind_message_schema, "{\"code\":\"abcd\"}", &msg, &error));
+    VERIFY(error.code == JC_PARSE_STRING_TOO_LONG);
+    VERIFY(!jc_bind_from_string(&bind_message_schema, "{\"text\":\"a\",\"tags\":[1,}", &msg, &error));
+    VERIFY(error.code == JC_PARSE_SYNTAX_ERROR && !msg.text && !msg.tags);
+
+    for (size_t i = 0; i < sizeof(bind_mismatches) / sizeof(bind_mismatches[0]); i++) {
+        VERIFY(!jc_bind_from_string(&bind_message_schema, bind_mismatches[i], &msg, &error));
+        VERIFY(error.code == JC_PARSE_TYPE_MISMATCH && error.offset == bind_mismatch_offsets[i]);
+    }
+    VERIFY(jc_bind_from_string(&bind_message_schema, "{\"score\":99999999999999999999}", &msg, &error));
+    VERIFY(msg.score == 1e20);
+    VERIFY(!jc_bind_from_string(&bind_message_schema, "{\"active\":tru}", &msg, &error));
+    VERIFY(error.code == JC_PARSE_SYNTAX_ERROR);
+})
+
+static JsonKeySet_t bind_user_keys;
+static const JsonSchema_t bind_user_indexed_schema = JC_SCHEMA_INDEXED(BindUser_t, bind_user_fields, &bind_user_keys);
+
+static const char* const keyset_keys[] = { "id", "name", "text", "user", "lang", "retweet_count", "favorited", "source" };
+static const char* const keyset_duplicates[] = { "id", "name", "id" };
+
+TEST_CASE(keyset_dispatch, {
+    const char* const* keys = keyset_keys;
+    JsonKeySet_t set;
+    VERIFY(jc_keyset_init(&set, keys, 8));
+    for (int i = 0; i < 8; i++)
+        VERIFY(jc_keyset_find(&set, keys[i], strlen(keys[i])) == i);
+    VERIFY(jc_keyset_find(&set, "nam", 3) == -1);
+    VERIFY(jc_keyset_find(&set, "missing", 7) == -1);
+
+    VERIFY(!jc_keyset_init(&set, keyset_duplicates, 3));
+    VERIFY(jc_keyset_init(&set, keys, 8));
+
+    JsonDocument_t* doc = jc_doc_from_string("{\"other\":1,\"lang\":\"en\",\"id\":7,\"text\":null}");
+    JsonValue_t* values[8];
+    VERIFY(jc_obj_get_keyset(jc_doc_get_obj(doc), &set, values) == 3);
+    VERIFY(values[0]->num_int64 == 7 && strcmp(values[4]->string, "en") == 0 && values[2]->ty == JC_NULL_LITERAL);
+    VERIFY(!values[1] && !values[7]);
+    jc_free_doc(doc);
+
+    BindUser_t user;
+    VERIFY(jc_bind_prepare(&bind_user_indexed_schema) && bind_user_keys.ready);
+    VERIFY(jc_bind_from_string(&bind_user_indexed_schema, "{\"skip\":[],\"name\":\"jc\",\"id\":3}", &user, NULL));
+    VERIFY(user.id == 3 && strcmp(user.name, "jc") == 0);
+    jc_bind_free(&bind_user_indexed_schema, &user);
+})
+
+static const char* const project_paths[] = { "/headers/tenant", "/items/*/sku", "/a~1b/1" };
+// Not NUL terminated, only the first 11 bytes are passed
+static const char project_buffer[] = { '[', '1', ',', '{', '"', 'k', '"', ':', '2', '}', ']', 'x' };
+
+TEST_CASE(path_projection, {
+    const char* text = "{\"body\":{\"blob\":\"x\\\"]}\",\"n\":[1,2,{\"sku\":0}]},\"headers\":{\"tenant\":{\"id\":\"t1\"},"
+                       "\"trace\":\"abc\"},\"items\":[{\"sku\":\"s1\",\"qty\":2},{\"qty\":1},{\"sku\":\"s3\"}],\"a/b\":[5,6,7]}";
+    JsonDocument_t* doc = jc_doc_from_buffer_project(text, strlen(text), project_paths, 3);
+    VERIFY(doc);
+    char* str = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(str, "{\"headers\":{\"tenant\":{\"id\":\"t1\"}},\"items\":[{\"sku\":\"s1\"},{\"sku\":\"s3\"}],\"a/b\":[6]}") == 0);
+    free(str);
+    jc_free_doc(doc);
+
+    const char* whole = "";
+    doc = jc_doc_from_buffer_project(project_buffer, sizeof(project_buffer) - 1, &whole, 1);
+    VERIFY(doc && jc_arr_size(jc_doc_get_arr(doc)) == 2);
+    jc_free_doc(doc);
+
+    const char* bad = "headers";
+    VERIFY(!jc_doc_from_buffer_project(text, strlen(text), &bad, 1));
+    VERIFY(!jc_doc_from_buffer_project(text, strlen(text) - 1, project_paths, 3));
+    VERIFY(!jc_doc_from_buffer_project("{\"body\":[1,}", 13, project_paths, 3));
+})
+
+typedef struct {
+    char out[64];
+    size_t limit;
+} QueryCollect_t;
+
+// Appends strings and integers to out, stops after limit matches
+static bool query_collect(JsonValue_t* value, void* ctx)
+{
+    QueryCollect_t* collect = ctx;
+    size_t len = strlen(collect->out);
+    if (value->ty == JC_STRING)
+        snprintf(collect->out + len, sizeof(collect->out) - len, "%s,", value->string);
+    else if (value->ty == JC_INT64)
+        snprintf(collect->out + len, sizeof(collect->out) - len, "%ld,", value->num_int64);
+    return --collect->limit > 0;
+}
+
+static size_t run_query(const JsonDocument_t* doc, const char* expr, QueryCollect_t* collect)
+{
+    memset(collect, 0, sizeof(QueryCollect_t));
+    collect->limit = SIZE_MAX;
+    JsonQuery_t* query = jc_query_compile(expr);
+    size_t matches = jc_query_run(query, doc, query_collect, collect);
+    jc_query_free(query);
+    return matches;
+}
+
+TEST_CASE(compiled_queries, {
+    JsonDocument_t* doc = jc_doc_from_string("{\"orders\":[{\"id\":1,\"lines\":[{\"qty\":2,\"sku\":\"a\"},{\"qty\":0,\"sku\":\"b\"},"
+                                             "{\"qty\":1.5,\"sku\":\"c\"}]},{\"id\":2,\"lines\":[{\"qty\":3,\"sku\":\"d\"}]}],"
+                                             "\"meta\":{\"a/b\":{\"~\":7}}}");
+    QueryCollect_t collect;
+    VERIFY(run_query(doc, "$.orders[*].lines[?(@.qty > 0)].sku", &collect) == 3 && strcmp(collect.out, "a,c,d,") == 0);
+    VERIFY(run_query(doc, "$.orders[-1].id", &collect) == 1 && strcmp(collect.out, "2,") == 0);
+    VERIFY(run_query(doc, "$.orders[0].lines[::-1].sku", &collect) == 3 && strcmp(collect.out, "c,b,a,") == 0);
+    VERIFY(run_query(doc, "$.orders[0].lines[1:].sku", &collect) == 2 && strcmp(collect.out, "b,c,") == 0);
+    VERIFY(run_query(doc, "$.orders[0].lines[?(@.sku == 'b')].qty", &collect) == 1 && strcmp(collect.out, "0,") == 0);
+    VERIFY(run_query(doc, "$['meta'].*[?(@)]", &collect) == 1 && strcmp(collect.out, "7,") == 0);
+    VERIFY(run_query(doc, "/meta/a~1b/~0", &collect) == 1 && strcmp(collect.out, "7,") == 0);
+    VERIFY(run_query(doc, "/orders/*/id", &collect) == 2 && strcmp(collect.out, "1,2,") == 0);
+    VERIFY(run_query(doc, "/orders/01/id", &collect) == 0);
+
+    // The same compiled query runs any number of times, the callback can stop it early
+    JsonQuery_t* query = jc_query_compile("$.orders[*].lines[*].sku");
+    VERIFY(query && jc_query_run(query, doc, NULL, NULL) == 4);
+    memset(&collect, 0, sizeof(collect));
+    collect.limit = 2;
+    VERIFY(jc_query_run(query, doc, query_collect, &collect) == 2 && strcmp(collect.out, "a,b,") == 0);
+    jc_query_free(query);
+
+    VERIFY(!jc_query_compile("$.orders["));
+    VERIFY(!jc_query_compile("$.orders[1:2:0]"));
+    VERIFY(!jc_query_compile("$.orders[?(@.qty >)]"));
+    VERIFY(!jc_query_compile("$.a[?(@.q==0x10)]") && !jc_query_compile("$.a[?(@.q==infinity)]"));
+    VERIFY(!jc_query_compile("$.a[?(@.q==nan)]") && !jc_query_compile("$.a[?(@.q==+1)]"));
+    VERIFY(!jc_query_compile("$.a[?(@.q==.5)]") && !jc_query_compile("$.a[?(@.q==99999999999999999999)]"));
+    VERIFY(run_query(doc, "$.orders[*].lines[?(@.qty == 1.5e0)].sku", &collect) == 1 && strcmp(collect.out, "c,") == 0);
+    VERIFY(run_query(doc, "$.orders[*].lines[?(@.qty == -0)].sku", &collect) == 1 && strcmp(collect.out, "b,") == 0);
+    VERIFY(!jc_query_compile("/a~2"));
+    VERIFY(run_query(doc, "$.orders[0].lines[1::9223372036854775807].sku", &collect) == 1 && strcmp(collect.out, "b,") == 0);
+    VERIFY(run_query(doc, "$.orders[0].lines[1::-9223372036854775807].sku", &collect) == 1 && strcmp(collect.out, "b,") == 0);
+    jc_free_doc(doc);
+
+    // Strings with NUL bytes are compared by length as well
+    doc = jc_doc_from_string("[{\"a\":\"x\\u0000y\"},{\"a\":\"x\"}]");
+    VERIFY(run_query(doc, "$[?(@.a == \"x\")].a", &collect) == 1);
+    VERIFY(run_query(doc, "$[?(@.a > \"x\")].a", &collect) == 1);
+    jc_free_doc(doc);
+    JsonParseOptions_t options = { 0 };
+    options.raw_strings = true;
+    doc = jc_doc_from_string_with_options("[{\"a\":\"x\\u0000y\"},{\"a\":\"x\"}]", &options, NULL);
+    VERIFY(run_query(doc, "$[?(@.a == \"x\")].a", &collect) == 1);
+    jc_free_doc(doc);
+})
+
+// Appends every streamed span followed by '|'
+static bool stream_collect(const char* value, size_t len, void* ctx)
+{
+    QueryCollect_t* collect = ctx;
+    size_t used = strlen(collect->out);
+    snprintf(collect->out + used, sizeof(collect->out) - used, "%.*s|", (int)len, value);
+    return --collect->limit > 0;
+}
+
+static size_t stream_query(const char* expr, const char* text, QueryCollect_t* collect, JsonParseError_t* error)
+{
+    memset(collect, 0, sizeof(QueryCollect_t));
+    collect->limit = SIZE_MAX;
+    JsonQuery_t* query = jc_query_compile(expr);
+    size_t matches = jc_query_stream(query, text, strlen(text), stream_collect, collect, error);
+    jc_query_free(query);
+    return matches;
+}
+
+TEST_CASE(streaming_queries, {
+    const char* lines = "{\"level\":\"info\",\"items\":[{\"sku\":\"a\",\"qty\":1},{\"qty\":0,\"sku\":[1, \"]\"]}]}\n"
+                        "{\"skip\":{\"items\":[]},\"items\":[{\"sku\":{\"id\":\"b\"},\"qty\":2.5}],\"le\\u0076el\":\"warn\"}\n";
+    QueryCollect_t collect;
+    JsonParseError_t error;
+    VERIFY(stream_query("$.items[*].sku", lines, &collect, &error) == 3 && error.code == JC_PARSE_OK);
+    VERIFY(strcmp(collect.out, "\"a\"|[1, \"]\"]|{\"id\":\"b\"}|") == 0);
+    VERIFY(stream_query("$.items[?(@.qty > 0)].sku", lines, &collect, &error) == 2 && strcmp(collect.out, "\"a\"|{\"id\":\"b\"}|") == 0);
+    VERIFY(stream_query("$.items[1:].qty", lines, &collect, &error) == 1 && strcmp(collect.out, "0|") == 0);
+    VERIFY(stream_query("/level", lines, &collect, &error) == 2 && strcmp(collect.out, "\"info\"|\"warn\"|") == 0);
+
+    JsonQuery_t* query = jc_query_compile("$.items[*]");
+    memset(&collect, 0, sizeof(collect));
+    collect.limit = 1;
+    VERIFY(jc_query_stream(query, lines, strlen(lines), stream_collect, &collect, NULL) == 1);
+    jc_query_free(query);
+
+    VERIFY(stream_query("$.items[-1]", lines, &collect, &error) == 0 && error.code == JC_PARSE_UNSUPPORTED_QUERY);
+    VERIFY(stream_query("$.items[0]", "{\"items\":[1,2] \"x\"}", &collect, &error) == 1);
+    VERIFY(error.code == JC_PARSE_SYNTAX_ERROR && error.offset == 15);
+    VERIFY(stream_query("$[?(@.a == \"x\")].a", "[{\"a\":\"x\\u0000y\"},{\"a\":\"x\"}]", &collect, &error) == 1);
+    VERIFY(strcmp(collect.out, "\"x\"|") == 0);
+    // Matched scalars are checked before they reach the callback
+    VERIFY(stream_query("$.a", "{\"a\":tru}", &collect, &error) == 0 && error.code == JC_PARSE_SYNTAX_ERROR);
+    VERIFY(stream_query("$.a", "{\"a\":1x}", &collect, &error) == 0 && error.code != JC_PARSE_OK);
+    VERIFY(stream_query("$.a", "{\"a\":\"\\q\"}", &collect, &error) == 0 && error.code != JC_PARSE_OK);
+    VERIFY(stream_query("$.a", "{\"a\":-0.5e3}", &collect, &error) == 1 && strcmp(collect.out, "-0.5e3|") == 0);
+})
+
+TEST_CASE(raw_numbers, {
+    JsonParseOptions_t options = { .raw_numbers = true };
+    const char* text = "{\"id\":18446744073709551617,\"price\":19.990,\"n\":-42,\"e\":1E+2,\"list\":[0.1,7]}";
+    JsonDocument_t* doc = jc_doc_from_string_with_options(text, &options, NULL);
+    VERIFY(doc);
+    JsonObject_t* obj = jc_doc_get_obj(doc);
+
+    // Serialized byte for byte
+    char* str = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(str, text) == 0);
+    free(str);
+
+    size_t len;
+    JsonValue_t* id = jc_obj_get(obj, "id");
+    VERIFY(id->ty == JC_NUMBER_RAW && strcmp(jc_value_number_text(id, &len), "18446744073709551617") == 0 && len == 20);
+    int64_t i64;
+    double dbl;
+    VERIFY(!jc_obj_get_int64(obj, "id", &i64) && jc_obj_get_double(obj, "id", &dbl) && dbl > 1.8e19);
+    VERIFY(jc_value_number_type(id) == JC_DOUBLE && jc_value_number_type(jc_obj_get(obj, "n")) == JC_INT64);
+    VERIFY(jc_obj_get_int64(obj, "n", &i64) && i64 == -42 && jc_obj_get_int64(obj, "n", &i64) && i64 == -42);
+    VERIFY(jc_obj_get_double(obj, "price", &dbl) && dbl == 19.99 && jc_obj_get_double(obj, "e", &dbl) && dbl == 100.0);
+
+    // Modified numbers are serialized from their new value
+    VERIFY(jc_value_set_int64(jc_obj_get(obj, "price"), 20) && !jc_value_set_int64(jc_obj_get(obj, "list"), 1));
+    JsonValue_t* exact = jc_new_value(JC_NUMBER_RAW, "0.30000000000000000001");
+    VERIFY(exact && !jc_new_value(JC_NUMBER_RAW, "1.") && !jc_new_value(JC_NUMBER_RAW, "12a"));
+    jc_obj_set(obj, "exact", exact);
+    str = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(str, "{\"id\":18446744073709551617,\"price\":20,\"n\":-42,\"e\":1E+2,\"list\":[0.1,7],"
+                       "\"exact\":0.30000000000000000001}") == 0);
+    free(str);
+
+    JsonMemoryUsage_t usage;
+    VERIFY(jc_doc_compact(doc, true) && jc_doc_memory_usage(doc, &usage) && usage.string_bytes > 0);
+    str = jc_doc_to_string(doc, 0);
+    VERIFY(strstr(str, "18446744073709551617") != NULL);
+    free(str);
+    jc_free_doc(doc);
+
+    VERIFY(!jc_doc_from_string_with_options("[01]", &options, NULL));
+    VERIFY(!jc_doc_from_string_with_options("[1.e5]", &options, NULL));
+})
+
+TEST_CASE(raw_strings, {
+    JsonParseOptions_t options = { .raw_strings = true };
+    const char* text = "{\"plain\":\"abc\",\"esc\":\"a\\u00e9\\n\\\"q\\\"\",\"list\":[\"\\t\",\"x\\/y\"]}";
+    JsonDocument_t* doc = jc_doc_from_string_with_options(text, &options, NULL);
+    VERIFY(doc);
+    JsonObject_t* obj = jc_doc_get_obj(doc);
+
+    // Escapes are kept as written
+    char* str = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(str, text) == 0);
+    free(str);
+
+    JsonValue_t* esc = jc_obj_get(obj, "esc");
+    VERIFY(jc_obj_get(obj, "plain")->ty == JC_STRING && esc->ty == JC_STRING_RAW);
+    VERIFY(strcmp(jc_obj_get_string(obj, "esc"), "a\xc3\xa9\n\"q\"") == 0);
+    VERIFY(jc_value_get_string(esc) == jc_value_get_string(esc));
+    JsonArray_t* list = jc_obj_get_arr(obj, "list");
+    VERIFY(strcmp(jc_value_get_string(jc_arr_at(list, 0)), "\t") == 0);
+    VERIFY(strcmp(jc_value_get_string(jc_arr_at(list, 1)), "x/y") == 0);
+
+    // Copies and compaction keep the source text
+    JsonMemoryUsage_t usage;
+    VERIFY(jc_doc_compact(doc, true) && jc_doc_memory_usage(doc, &usage) && usage.string_bytes > 0);
+    str = jc_doc_to_string(doc, 0);
+    VERIFY(strcmp(str, text) == 0);
+    free(str);
+    VERIFY(strcmp(jc_obj_get_string(jc_doc_get_obj(doc), "esc"), "a\xc3\xa9\n\"q\"") == 0);
+
+    // Setting a raw string turns it into a regular one
+    esc = jc_obj_get(jc_doc_get_obj(doc), "esc");
+    VERIFY(jc_value_set_string(esc, "b\"") && esc->ty == JC_STRING && !jc_new_value(JC_STRING_RAW, "\"x\""));
+    str = jc_doc_to_string(doc, 0);
+    VERIFY(strstr(str, "\"esc\":\"b\\\"\"") != NULL);
+    free(str);
+    jc_free_doc(doc);
+
+    VERIFY(!jc_doc_from_string_with_options("[\"\\x\"]", &options, NULL));
+    VERIFY(!jc_doc_from_string_with_options("[\"\\u12g4\"]", &options, NULL));
+    VERIFY(!jc_doc_from_string_with_options("[\"a\tb\"]", &options, NULL));
+    VERIFY(!jc_doc_from_string_with_options("[\"abc]", &options, NULL));
+})
+
+TEST_CASE(clone_doc, {
+    JsonParseOptions_t options = { .raw_strings = true };
+    const char* text = "{\"id\":1,\"user\":{\"name\":\"a\\tb\",\"tags\":[\"x\",2.5,null]},\"gone\":true,\"list\":[[],{}]}";
+    JsonDocument_t* doc = jc_doc_from_string_with_options(text, &options, NULL);
+    VERIFY(doc && jc_obj_remove(jc_doc_get_obj(doc), "gone"));
+    char* expected = jc_doc_to_string(doc, 0);
+
+    for (int contiguous = 0; contiguous < 2; contiguous++) {
+        JsonDocument_t* clone = jc_doc_clone(doc, contiguous);
+        VERIFY(clone);
+        char* str = jc_doc_to_string(clone, 0);
+        VERIFY(strcmp(str, expected) == 0);
+        free(str);
+        JsonMemoryUsage_t usage;
+        VERIFY(jc_doc_memory_usage(clone, &usage) && usage.bucket_tombstone_bytes == 0);
+
+        // Clones are independent of their source
+        JsonObject_t* user = jc_obj_get_obj(jc_doc_get_obj(clone), "user");
+        VERIFY(strcmp(jc_obj_get_string(user, "name"), "a\tb") == 0 && jc_obj_get_arr(user, "tags"));
+        VERIFY(jc_obj_insert(user, "age", JC_INT64, &(int64_t) { 30 }) && jc_obj_remove(user, "tags"));
+        VERIFY(!jc_obj_get(jc_obj_get_obj(jc_doc_get_obj(doc), "user"), "age"));
+        jc_free_doc(clone);
+    }
+    free(expected);
+
+    // Subtrees move into another document
+    JsonDocument_t* target = jc_new_doc();
+    JsonObject_t* user = jc_obj_clone(jc_obj_get_obj(jc_doc_get_obj(doc), "user"), target);
+    JsonArray_t* list = jc_arr_clone(jc_obj_get_arr(jc_doc_get_obj(doc), "list"), target);
+    VERIFY(user && list && jc_arr_size(list) == 2);
+    VERIFY(jc_doc_set_obj(target, user) && jc_obj_insert(user, "list", JC_ARRAY, list));
+    JsonAllocStats_t stats;
+    VERIFY(jc_doc_alloc_stats(target, &stats) && stats.live_allocations > 10);
+    jc_free_doc(doc);
+    char* str = jc_doc_to_string(target, 0);
+    VERIFY(strcmp(str, "{\"name\":\"a\\tb\",\"tags\":[\"x\",2.5,null],\"list\":[[],{}]}") == 0);
+    free(str);
+    jc_free_doc(target);
+    VERIFY(!jc_doc_clone(NULL, false) && !jc_obj_clone(NULL, NULL) && !jc_arr_clone(NULL, NULL));
+})
+
+TEST_CASE(shared_subtrees, {
+    JsonParseOptions_t options = { .raw_strings = true };
+    const char* text = "{\"db\":{\"host\":\"h\",\"ports\":[1,2]},\"name\":\"c\\u00e9\",\"limits\":[{\"n\":1}]}";
+    JsonDocument_t* doc = jc_doc_from_string_with_options(text, &options, NULL);
+    JsonObject_t* config = jc_obj_share(jc_doc_get_obj(doc));
+    VERIFY(config && jc_obj_is_shared(config) && !jc_obj_is_shared(jc_doc_get_obj(doc)));
+    VERIFY(!jc_obj_retain(jc_doc_get_obj(doc)));
+    jc_free_doc(doc);
+
+    // Shared containers and their values are read only
+    JsonObject_t* db = jc_obj_get_obj(config, "db");
+    VERIFY(jc_obj_is_shared(db) && jc_arr_is_shared(jc_obj_get_arr(db, "ports")));
+    VERIFY(!jc_obj_insert(config, "x", JC_NULL_LITERAL, NULL) && !jc_obj_remove(db, "host"));
+    VERIFY(!jc_arr_insert(jc_obj_get_arr(db, "ports"), JC_NULL_LITERAL, NULL));
+    VERIFY(!jc_value_set_int64(jc_arr_at(jc_obj_get_arr(db, "ports"), 0), 5));
+    VERIFY(!jc_obj_get_obj_mut(config, "db"));
+    VERIFY(strcmp(jc_obj_get_string(config, "name"), "c\xc3\xa9") == 0);
+
+    JsonDocument_t* first = jc_new_doc();
+    JsonDocument_t* second = jc_new_doc();
+    JsonObject_t* wrapper = jc_new_obj();
+    VERIFY(jc_doc_set_obj(first, jc_obj_retain(config)));
+    VERIFY(jc_obj_insert(wrapper, "config", JC_OBJECT, jc_obj_retain(config)) && jc_doc_set_obj(second, wrapper));
+    jc_free_obj(config);
+
+    // Copy on write copies the path down to the modified object only
+    JsonObject_t* root = jc_doc_get_obj_mut(first);
+    VERIFY(root && !jc_obj_is_shared(root) && jc_obj_is_shared(jc_obj_get_obj(root, "db")));
+    db = jc_obj_get_obj_mut(root, "db");
+    VERIFY(db && jc_obj_insert(db, "user", JC_STRING, "u") && jc_obj_remove(db, "host"));
+    VERIFY(jc_arr_is_shared(jc_obj_get_arr(db, "ports")) && jc_arr_is_shared(jc_obj_get_arr(root, "limits")));
+    JsonObject_t* limit = jc_arr_get_obj_mut(jc_obj_get_arr_mut(root, "limits"), 0);
+    VERIFY(limit && jc_obj_insert(limit, "m", JC_INT64, &(int64_t) { 2 }));
+    char* str = jc_doc_to_string(first, 0);
+    VERIFY(strcmp(str, "{\"db\":{\"ports\":[1,2],\"user\":\"u\"},\"name\":\"c\\u00e9\",\"limits\":[{\"n\":1,\"m\":2}]}") == 0);
+    free(str);
+    jc_free_doc(first);
+
+    // Clones reference the shared subtree, the last owner frees it
+    JsonDocument_t* clone = jc_doc_clone(second, false);
+    jc_free_doc(second);
+    VERIFY(clone && jc_obj_is_shared(jc_obj_get_obj(jc_doc_get_obj(clone), "config")));
+    str = jc_doc_to_string(clone, 0);
+    VERIFY(strncmp(str, "{\"config\":", 10) == 0 && strncmp(str + 10, text, strlen(text)) == 0);
+    free(str);
+    VERIFY(jc_doc_compact(clone, true) && jc_obj_is_shared(jc_obj_get_obj(jc_doc_get_obj(clone), "config")));
+    jc_free_doc(clone);
+})
+
 int main(int argc, char** argv)
 {
     REGISTER_TEST_CASE(set_and_get);
@@ -148,9 +1231,37 @@ int main(int argc, char** argv)
     REGISTER_TEST_CASE(serialize_obj);
     REGISTER_TEST_CASE(serialize_arr);
     REGISTER_TEST_CASE(serialize_complex);
+    REGISTER_TEST_CASE(serialize_to_buffer);
+    REGISTER_TEST_CASE(serialize_escapes);
+    REGISTER_TEST_CASE(string_metadata);
     REGISTER_TEST_CASE(serde_valid);
+    REGISTER_TEST_CASE(serialized_size);
     REGISTER_TEST_CASE(serde_invalid);
     REGISTER_TEST_CASE(remove_obj);
+    REGISTER_TEST_CASE(remove_reinsert_obj);
     REGISTER_TEST_CASE(remove_arr);
+    REGISTER_TEST_CASE(tape_cursor);
+    REGISTER_TEST_CASE(tape_doc_roundtrip);
+    REGISTER_TEST_CASE(binary_image);
+    REGISTER_TEST_CASE(cbor_roundtrip);
+    REGISTER_TEST_CASE(msgpack_roundtrip);
+    REGISTER_TEST_CASE(doc_allocator);
+    REGISTER_TEST_CASE(global_allocator);
+    REGISTER_TEST_CASE(parse_limits);
+    REGISTER_TEST_CASE(stats_snapshot);
+    REGISTER_TEST_CASE(memory_usage);
+    REGISTER_TEST_CASE(compact_doc);
+    REGISTER_TEST_CASE(reserve_capacity);
+    REGISTER_TEST_CASE(presized_parse);
+    REGISTER_TEST_CASE(prehashed_keys);
+    REGISTER_TEST_CASE(struct_binding);
+    REGISTER_TEST_CASE(keyset_dispatch);
+    REGISTER_TEST_CASE(path_projection);
+    REGISTER_TEST_CASE(compiled_queries);
+    REGISTER_TEST_CASE(streaming_queries);
+    REGISTER_TEST_CASE(raw_numbers);
+    REGISTER_TEST_CASE(raw_strings);
+    REGISTER_TEST_CASE(clone_doc);
+    REGISTER_TEST_CASE(shared_subtrees);
     RUN_TEST_SUITE(argc, argv);
 }
\ No newline at end of file